@@ -0,0 +1,3 @@
+ALTER TABLE %allsongstables ADD COLUMN content_id TEXT;
+
+UPDATE schema_version SET version=48;
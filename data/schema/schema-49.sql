@@ -0,0 +1,7 @@
+ALTER TABLE playlist_items ADD COLUMN sort_order REAL;
+
+UPDATE playlist_items SET sort_order = ROWID * 1024.0;
+
+CREATE INDEX playlist_items_idx_order ON playlist_items (playlist, sort_order);
+
+UPDATE schema_version SET version=49;
@@ -17,6 +17,7 @@
 
 #include "tagreaderworker.h"
 #include "core/logging.h"
+#include "core/sharedmemoryblob.h"
 
 #include <QCoreApplication>
 #include <QLocalSocket>
@@ -47,6 +48,9 @@ int main(int argc, char** argv) {
   logging::Init();
   qLog(Info) << "TagReader worker connecting to" << args[1];
 
+  // Earlier workers that crashed couldn't clean up after themselves.
+  SharedMemoryBlob::RemoveStale();
+
   // Connect to the parent process.
   QLocalSocket socket;
   socket.connectToServer(args[1]);
@@ -17,6 +17,8 @@
 
 #include "tagreaderworker.h"
 
+#include <algorithm>
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QFileInfo>
@@ -24,6 +26,11 @@
 #include <QTextCodec>
 #include <QUrl>
 
+#include "core/contentid.h"
+#include "core/sharedmemoryblob.h"
+
+const int TagReaderWorker::kMaxPendingBlobs = 64;
+
 TagReaderWorker::TagReaderWorker(QIODevice* socket, QObject* parent)
     : AbstractMessageHandler<pb::tagreader::Message>(socket, parent) {}
 
@@ -42,6 +49,39 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
     tag_reader_.ReadFile(
         QStringFromStdString(message.read_file_request().filename()),
         reply.mutable_read_file_response()->mutable_metadata());
+  } else if (message.has_read_files_request()) {
+    pb::tagreader::ReadFilesResponse* response =
+        reply.mutable_read_files_response();
+    const bool read_audio_properties =
+        !message.read_files_request().tags_only();
+    const bool content_ids = message.read_files_request().content_ids();
+    for (const std::string& filename :
+         message.read_files_request().filenames()) {
+      const QString path = QStringFromStdString(filename);
+      pb::tagreader::SongMetadata* metadata = response->add_metadata();
+      tag_reader_.ReadFile(path, metadata, read_audio_properties);
+      if (content_ids) {
+        const QString content_id = ContentId::ForFile(path);
+        metadata->set_content_id(DataCommaSizeFromQString(content_id));
+      }
+    }
+  } else if (message.has_read_content_ids_request()) {
+    pb::tagreader::ReadContentIdsResponse* response =
+        reply.mutable_read_content_ids_response();
+    for (const std::string& filename :
+         message.read_content_ids_request().filenames()) {
+      const QString content_id =
+          ContentId::ForFile(QStringFromStdString(filename));
+      response->add_content_ids(DataCommaSizeFromQString(content_id));
+    }
+  } else if (message.has_read_audio_properties_request()) {
+    pb::tagreader::ReadAudioPropertiesResponse* response =
+        reply.mutable_read_audio_properties_response();
+    for (const std::string& filename :
+         message.read_audio_properties_request().filenames()) {
+      tag_reader_.ReadAudioProperties(QStringFromStdString(filename),
+                                      response->add_metadata());
+    }
   } else if (message.has_save_file_request()) {
     reply.mutable_save_file_response()->set_success(tag_reader_.SaveFile(
         QStringFromStdString(message.save_file_request().filename()),
@@ -62,10 +102,27 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
     reply.mutable_is_media_file_response()->set_success(tag_reader_.IsMediaFile(
         QStringFromStdString(message.is_media_file_request().filename())));
   } else if (message.has_load_embedded_art_request()) {
-    QByteArray data = tag_reader_.LoadEmbeddedArt(
-        QStringFromStdString(message.load_embedded_art_request().filename()));
-    reply.mutable_load_embedded_art_response()->set_data(data.constData(),
-                                                         data.size());
+    const pb::tagreader::LoadEmbeddedArtRequest& req =
+        message.load_embedded_art_request();
+    pb::tagreader::LoadEmbeddedArtResponse* response =
+        reply.mutable_load_embedded_art_response();
+    QByteArray data =
+        tag_reader_.LoadEmbeddedArt(QStringFromStdString(req.filename()));
+
+    std::string blob_name;
+    if (req.allow_shared_memory() &&
+        data.size() >= SharedMemoryBlob::kMinimumSize) {
+      blob_name = SharedMemoryBlob::Create(data.constData(), data.size());
+    }
+
+    if (blob_name.empty()) {
+      response->set_data(data.constData(), data.size());
+    } else {
+      response->mutable_shared_memory()->set_name(blob_name);
+      response->mutable_shared_memory()->set_size(data.size());
+      PrunePendingBlobs();
+      shared_memory_blobs_.push_back(blob_name);
+    }
   } else if (message.has_read_cloud_file_request()) {
 #ifdef HAVE_GOOGLE_DRIVE
     const pb::tagreader::ReadCloudFileRequest& req =
@@ -85,8 +142,29 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
   SendReply(message, &reply);
 }
 
+void TagReaderWorker::PrunePendingBlobs() {
+  shared_memory_blobs_.erase(
+      std::remove_if(shared_memory_blobs_.begin(), shared_memory_blobs_.end(),
+                     [](const std::string& name) {
+                       return !SharedMemoryBlob::Exists(name);
+                     }),
+      shared_memory_blobs_.end());
+
+  // Requests that timed out or were abandoned never open their segments.
+  while (int(shared_memory_blobs_.size()) >= kMaxPendingBlobs) {
+    SharedMemoryBlob::Remove(shared_memory_blobs_.front());
+    shared_memory_blobs_.erase(shared_memory_blobs_.begin());
+  }
+}
+
 void TagReaderWorker::DeviceClosed() {
   AbstractMessageHandler<pb::tagreader::Message>::DeviceClosed();
 
+  // Clementine unlinks each blob when it opens it, so these are only the ones
+  // it never got to.
+  for (const std::string& name : shared_memory_blobs_) {
+    SharedMemoryBlob::Remove(name);
+  }
+
   qApp->exit();
 }
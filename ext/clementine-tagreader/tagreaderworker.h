@@ -18,6 +18,9 @@
 #ifndef TAGREADERWORKER_H
 #define TAGREADERWORKER_H
 
+#include <string>
+#include <vector>
+
 #include "config.h"
 #include "tagreader.h"
 #include "tagreadermessages.pb.h"
@@ -27,12 +30,24 @@ class TagReaderWorker : public AbstractMessageHandler<pb::tagreader::Message> {
  public:
   TagReaderWorker(QIODevice* socket, QObject* parent = NULL);
 
+  // How many segments can be waiting for Clementine before the oldest are
+  // assumed to be abandoned and removed.
+  static const int kMaxPendingBlobs;
+
  protected:
   void MessageArrived(const pb::tagreader::Message& message);
   void DeviceClosed();
 
  private:
+  // Forgets segments Clementine has opened, and removes the oldest ones if
+  // too many are left.
+  void PrunePendingBlobs();
+
   TagReader tag_reader_;
+
+  // Names of the shared memory segments sent to Clementine that it might not
+  // have opened yet, oldest first.
+  std::vector<std::string> shared_memory_blobs_;
 };
 
 #endif  // TAGREADERWORKER_H
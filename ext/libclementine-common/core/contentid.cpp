@@ -0,0 +1,39 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "contentid.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+const int ContentId::kBlockSize = 16 * 1024;
+
+QString ContentId::ForFile(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) return QString();
+  const qint64 size = file.size();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QByteArray::number(size));
+  hash.addData(file.read(kBlockSize));
+  if (size > kBlockSize) {
+    file.seek(qMax(qint64(kBlockSize), size - kBlockSize));
+    hash.addData(file.read(kBlockSize));
+  }
+  return hash.result().toHex();
+}
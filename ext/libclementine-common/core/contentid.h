@@ -0,0 +1,38 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTENTID_H
+#define CONTENTID_H
+
+#include <QString>
+
+// A string that identifies the contents of a file: a hash of its size and of
+// the first and last kBlockSize bytes.  The same file has the same ID
+// wherever it's moved to, so the library can recognise a moved file without
+// reading its tags again.  Working it out means reading the file, so it's
+// done by the tagreader workers alongside the tags where possible.
+class ContentId {
+ public:
+  // How much of the start and the end of a file goes into its ID.
+  static const int kBlockSize;
+
+  // Returns an empty string if the file can't be read.
+  static QString ForFile(const QString& filename);
+};
+
+#endif  // CONTENTID_H
@@ -108,6 +108,9 @@ class AbstractMessageHandler : public _MessageHandlerBase {
   // reply on the socket.  Used on the worker side.
   void SendReply(const MessageType& request, MessageType* reply);
 
+  // The number of requests sent that haven't been replied to yet.
+  int pending_request_count() const { return pending_replies_.count(); }
+
  protected:
   // Called when a message is received from the socket.
   virtual void MessageArrived(const MessageType& message) {}
@@ -0,0 +1,149 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sharedmemoryblob.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QStringList>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "core/logging.h"
+
+const int SharedMemoryBlob::kMinimumSize = 64 * 1024;
+
+namespace {
+QAtomicInt sNextBlobId;
+}  // namespace
+
+std::string SharedMemoryBlob::Create(const char* data, size_t size) {
+#ifdef Q_OS_UNIX
+  if (size == 0) return std::string();
+
+  // Mac OS X only allows 31 characters.
+  char name[32];
+  snprintf(name, sizeof(name), "/clementine-%d-%d", int(getpid()),
+           sNextBlobId.fetchAndAddRelaxed(1));
+
+  const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1) {
+    qLog(Warning) << "Couldn't create shared memory" << name << strerror(errno);
+    return std::string();
+  }
+
+  void* mapping = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) {
+    mapping = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    qLog(Warning) << "Couldn't map shared memory" << name << strerror(errno);
+    shm_unlink(name);
+    return std::string();
+  }
+
+  memcpy(mapping, data, size);
+  munmap(mapping, size);
+  return name;
+#else
+  Q_UNUSED(data);
+  Q_UNUSED(size);
+  return std::string();
+#endif
+}
+
+void SharedMemoryBlob::Remove(const std::string& name) {
+#ifdef Q_OS_UNIX
+  shm_unlink(name.c_str());
+#else
+  Q_UNUSED(name);
+#endif
+}
+
+bool SharedMemoryBlob::Exists(const std::string& name) {
+#ifdef Q_OS_UNIX
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) return false;
+  close(fd);
+  return true;
+#else
+  Q_UNUSED(name);
+  return false;
+#endif
+}
+
+void SharedMemoryBlob::RemoveStale() {
+#ifdef Q_OS_LINUX
+  // Segments are named /clementine-<pid>-<id> and show up in /dev/shm.
+  const QStringList names =
+      QDir("/dev/shm").entryList(QStringList() << "clementine-*", QDir::Files);
+  for (const QString& name : names) {
+    bool ok = false;
+    const pid_t pid = name.section('-', 1, 1).toInt(&ok);
+    if (!ok || pid <= 0) continue;
+    if (kill(pid, 0) == 0 || errno != ESRCH) continue;
+
+    qLog(Debug) << "Removing stale shared memory" << name;
+    Remove(("/" + name).toStdString());
+  }
+#endif
+}
+
+SharedMemoryBlob::SharedMemoryBlob(const std::string& name, qint64 size)
+    : data_(nullptr), size_(0) {
+#ifdef Q_OS_UNIX
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    qLog(Warning) << "Couldn't open shared memory" << name.c_str()
+                  << strerror(errno);
+    return;
+  }
+  shm_unlink(name.c_str());
+
+  struct stat st;
+  if (size > 0 && fstat(fd, &st) == 0 && st.st_size >= size) {
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED) {
+      data_ = mapping;
+      size_ = size;
+    }
+  }
+  close(fd);
+#else
+  Q_UNUSED(name);
+  Q_UNUSED(size);
+#endif
+}
+
+SharedMemoryBlob::~SharedMemoryBlob() {
+#ifdef Q_OS_UNIX
+  if (data_) munmap(data_, size_);
+#endif
+}
@@ -0,0 +1,70 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHAREDMEMORYBLOB_H
+#define SHAREDMEMORYBLOB_H
+
+#include <string>
+
+#include <QtGlobal>
+
+// A side channel for large payloads, like cover art, that would otherwise be
+// serialised into a message and copied through the worker's socket.
+//
+// The sender copies the payload into a new POSIX shared memory segment and
+// sends just its name and size.  The receiver maps the segment read-only,
+// unlinks it straight away so nothing is left behind, and uses the data in
+// place.  Shared memory isn't available on Windows, so there Create() always
+// fails and the payload should be sent inline as before.
+class SharedMemoryBlob {
+ public:
+  // Payloads smaller than this are cheaper to send inline.
+  static const int kMinimumSize;
+
+  // Creates a segment containing a copy of the data and returns its name, or
+  // an empty string if it couldn't be created.
+  static std::string Create(const char* data, size_t size);
+
+  // Removes a segment that was created but might never have been opened.
+  // Does nothing if the receiver has opened it already.
+  static void Remove(const std::string& name);
+
+  // Whether the segment still exists, i.e. the receiver hasn't opened it yet.
+  static bool Exists(const std::string& name);
+
+  // Removes segments left behind by senders that have since died.  Only
+  // possible where segments can be listed, which is Linux.
+  static void RemoveStale();
+
+  // Maps the segment and unlinks it.  The data stays valid until this object
+  // is destroyed.
+  SharedMemoryBlob(const std::string& name, qint64 size);
+  ~SharedMemoryBlob();
+
+  bool is_valid() const { return data_ != nullptr; }
+  const uchar* data() const { return static_cast<const uchar*>(data_); }
+  qint64 size() const { return size_; }
+
+ private:
+  Q_DISABLE_COPY(SharedMemoryBlob)
+
+  void* data_;
+  qint64 size_;
+};
+
+#endif  // SHAREDMEMORYBLOB_H
@@ -17,4 +17,6 @@
 
 #include "workerpool.h"
 
+const int _WorkerPoolBase::kMaxBulkRequestsPerWorker = 2;
+
 _WorkerPoolBase::_WorkerPoolBase(QObject* parent) : QObject(parent) {}
@@ -40,6 +40,20 @@ class _WorkerPoolBase : public QObject {
  public:
   _WorkerPoolBase(QObject* parent = nullptr);
 
+  // Messages are sent in priority order.  Bulk messages are never sent to the
+  // reserved worker, and are held in the pool's queue rather than the
+  // workers' sockets, so an interactive message never waits behind more than
+  // a couple of them.
+  enum Priority {
+    Priority_Interactive = 0,
+    Priority_Bulk,
+
+    PriorityCount
+  };
+
+  // The most bulk messages a worker is given before it has replied to them.
+  static const int kMaxBulkRequestsPerWorker;
+
 signals:
   // Emitted when a worker failed to start.  This usually happens when the
   // worker wasn't found, or couldn't be executed.
@@ -72,7 +86,8 @@ class WorkerPool : public _WorkerPoolBase {
   void SetExecutableName(const QString& executable_name);
 
   // Sets the number of worker process to use.  Defaults to
-  // 1 <= (processors / 2) <= 2.
+  // 1 <= (processors / 2) <= 2.  If there is more than one, the first is
+  // reserved for interactive messages.
   void SetWorkerCount(int count);
 
   // Sets the prefix to use for the local server (on unix this is a named pipe
@@ -84,9 +99,10 @@ class WorkerPool : public _WorkerPoolBase {
   void Start();
 
   // Fills in the message's "id" field and creates a reply future.  The message
-  // is queued and the WorkerPool's thread will send it to the next available
-  // worker.  Can be called from any thread.
-  ReplyType* SendMessageWithReply(MessageType* message);
+  // is queued and the WorkerPool's thread will send it to the available worker
+  // with the fewest outstanding requests.  Can be called from any thread.
+  ReplyType* SendMessageWithReply(MessageType* message,
+                                  Priority priority = Priority_Interactive);
 
  protected:
   // These are all reimplemented slots, they are called on the WorkerPool's
@@ -137,9 +153,13 @@ class WorkerPool : public _WorkerPoolBase {
   // thread
   ReplyType* NewReply(MessageType* message);
 
-  // Returns the next handler, or NULL if there isn't one.  Must be called from
-  // my thread.
-  HandlerType* NextHandler() const;
+  // Returns the handler that should be sent the next message with this
+  // priority, or NULL if there isn't one.  Must be called from my thread.
+  HandlerType* NextHandler(Priority priority) const;
+
+  bool IsReserved(int worker_index) const {
+    return worker_index == 0 && workers_.count() > 1;
+  }
 
  private:
   QString local_server_name_;
@@ -147,18 +167,17 @@ class WorkerPool : public _WorkerPoolBase {
   QString executable_path_;
 
   int worker_count_;
-  mutable int next_worker_;
   QList<Worker> workers_;
 
   QAtomicInt next_id_;
 
   QMutex message_queue_mutex_;
-  QQueue<ReplyType*> message_queue_;
+  QQueue<ReplyType*> message_queues_[PriorityCount];
 };
 
 template <typename HandlerType>
 WorkerPool<HandlerType>::WorkerPool(QObject* parent)
-    : _WorkerPoolBase(parent), next_worker_(0), next_id_(0) {
+    : _WorkerPoolBase(parent), next_id_(0) {
   worker_count_ = qBound(1, QThread::idealThreadCount() / 2, 2);
   local_server_name_ = qApp->applicationName().toLower();
 
@@ -188,8 +207,10 @@ WorkerPool<HandlerType>::~WorkerPool() {
     }
   }
 
-  for (ReplyType* reply : message_queue_) {
-    reply->Abort();
+  for (const QQueue<ReplyType*>& queue : message_queues_) {
+    for (ReplyType* reply : queue) {
+      reply->Abort();
+    }
   }
 }
 
@@ -354,13 +375,14 @@ typename WorkerPool<HandlerType>::ReplyType* WorkerPool<HandlerType>::NewReply(
 
 template <typename HandlerType>
 typename WorkerPool<HandlerType>::ReplyType*
-WorkerPool<HandlerType>::SendMessageWithReply(MessageType* message) {
+WorkerPool<HandlerType>::SendMessageWithReply(MessageType* message,
+                                              Priority priority) {
   ReplyType* reply = NewReply(message);
 
   // Add the pending reply to the queue
   {
     QMutexLocker l(&message_queue_mutex_);
-    message_queue_.enqueue(reply);
+    message_queues_[priority].enqueue(reply);
   }
 
   // Wake up the main thread
@@ -373,35 +395,55 @@ template <typename HandlerType>
 void WorkerPool<HandlerType>::SendQueuedMessages() {
   QMutexLocker l(&message_queue_mutex_);
 
-  while (!message_queue_.isEmpty()) {
-    ReplyType* reply = message_queue_.dequeue();
+  for (int i = 0; i < PriorityCount; ++i) {
+    const Priority priority = Priority(i);
+    QQueue<ReplyType*>& queue = message_queues_[priority];
+
+    while (!queue.isEmpty()) {
+      // Find a worker for this message
+      HandlerType* handler = NextHandler(priority);
+      if (!handler) {
+        // Bulk messages wait here until a worker has replied to one.
+        if (priority == Priority_Interactive) {
+          qLog(Debug) << "No available handlers to process request";
+        }
+        break;
+      }
 
-    // Find a worker for this message
-    HandlerType* handler = NextHandler();
-    if (!handler) {
-      // No available handlers - put the message on the front of the queue.
-      message_queue_.prepend(reply);
-      qLog(Debug) << "No available handlers to process request";
-      break;
+      // Look at the queue again when the worker replies, since it might be
+      // able to take a bulk message now.
+      ReplyType* reply = queue.dequeue();
+      connect(reply, SIGNAL(Finished(bool)), SLOT(SendQueuedMessages()),
+              Qt::QueuedConnection);
+      handler->SendRequest(reply);
     }
-
-    handler->SendRequest(reply);
   }
 }
 
 template <typename HandlerType>
-HandlerType* WorkerPool<HandlerType>::NextHandler() const {
+HandlerType* WorkerPool<HandlerType>::NextHandler(Priority priority) const {
+  HandlerType* ret = NULL;
+  int ret_pending = 0;
+
   for (int i = 0; i < workers_.count(); ++i) {
-    const int worker_index = (next_worker_ + i) % workers_.count();
+    HandlerType* handler = workers_[i].handler_;
+    if (!handler || handler->is_device_closed()) continue;
+
+    const int pending = handler->pending_request_count();
+    if (priority == Priority_Bulk &&
+        (IsReserved(i) || pending >= kMaxBulkRequestsPerWorker)) {
+      continue;
+    }
 
-    if (workers_[worker_index].handler_ &&
-        !workers_[worker_index].handler_->is_device_closed()) {
-      next_worker_ = (worker_index + 1) % workers_.count();
-      return workers_[worker_index].handler_;
+    // Ties go to the first worker, which is the reserved one for interactive
+    // messages.
+    if (!ret || pending < ret_pending) {
+      ret = handler;
+      ret_pending = pending;
     }
   }
 
-  return NULL;
+  return ret;
 }
 
 #endif  // WORKERPOOL_H
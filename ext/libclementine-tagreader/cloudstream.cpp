@@ -18,9 +18,12 @@
 #include "cloudstream.h"
 
 #include <QEventLoop>
+#include <QFileInfo>
+#include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QPair>
 
 #include <taglib/id3v2framefactory.h>
 #include <taglib/mpegfile.h>
@@ -28,8 +31,49 @@
 #include "core/logging.h"
 
 namespace {
-static const int kTaglibPrefixCacheBytes = 64 * 1024;  // Should be enough.
-static const int kTaglibSuffixCacheBytes = 8 * 1024;
+static const int kBlockSize = 16 * 1024;
+
+// TagLib mostly reads forwards, so a miss fetches a few blocks after it too.
+static const int kReadAheadBlocks = 4;
+
+static const ulong kTaglibPrefixCacheBytes = 64 * 1024;  // Should be enough.
+static const ulong kTaglibSuffixCacheBytes = 8 * 1024;
+
+// Limits how far one file with a huge embedded cover can grow the prefix that
+// is fetched for every later file of the same format.
+static const ulong kMaxPrefixCacheBytes = 2 * 1024 * 1024;
+
+// Ranges closer together than this are fetched in one request.
+static const ulong kMaxRangeGapBytes = 64 * 1024;
+
+// How many bytes at the start of a file TagLib has needed so far, by file
+// extension.  Files in a folder usually come from the same encoder, so this
+// lets the first request fetch the whole ID3v2 tag or FLAC metadata.
+QMutex sPrefixBytesMutex;
+QHash<QString, ulong> sPrefixBytes;
+
+ulong PrefixBytes(const QString& format) {
+  QMutexLocker l(&sPrefixBytesMutex);
+  return sPrefixBytes.value(format, kTaglibPrefixCacheBytes);
+}
+
+void RememberPrefixBytes(const QString& format, ulong bytes) {
+  bytes = qMin((bytes + kBlockSize - 1) / kBlockSize * kBlockSize,
+               kMaxPrefixCacheBytes);
+
+  QMutexLocker l(&sPrefixBytesMutex);
+  if (bytes > sPrefixBytes.value(format, kTaglibPrefixCacheBytes)) {
+    sPrefixBytes[format] = bytes;
+  }
+}
+
+quint64 ReadBigEndian(const char* data, int bytes) {
+  quint64 ret = 0;
+  for (int i = 0; i < bytes; ++i) {
+    ret = (ret << 8) | quint8(data[i]);
+  }
+  return ret;
+}
 }
 
 CloudStream::CloudStream(const QUrl& url, const QString& filename,
@@ -40,72 +84,59 @@ CloudStream::CloudStream(const QUrl& url, const QString& filename,
       encoded_filename_(filename_.toUtf8()),
       length_(length),
       auth_(auth),
+      format_(QFileInfo(filename).suffix().toLower()),
       cursor_(0),
       network_(network),
-      cache_(length),
+      cached_bytes_(0),
+      prefix_bytes_(0),
       num_requests_(0) {}
 
+void CloudStream::ResetPrefixBytes() {
+  QMutexLocker l(&sPrefixBytesMutex);
+  sPrefixBytes.clear();
+}
+
 TagLib::FileName CloudStream::name() const { return encoded_filename_.data(); }
 
-bool CloudStream::CheckCache(int start, int end) {
-  for (int i = start; i <= end; ++i) {
-    if (!cache_.test(i)) {
+bool CloudStream::IsCached(ulong start, ulong end) const {
+  for (ulong i = start / kBlockSize; i <= end / kBlockSize; ++i) {
+    if (!blocks_.contains(i)) {
       return false;
     }
   }
   return true;
 }
 
-void CloudStream::FillCache(int start, TagLib::ByteVector data) {
-  for (int i = 0; i < data.size(); ++i) {
-    cache_.set(start + i, data[i]);
+bool CloudStream::EnsureCached(ulong start, ulong end, int read_ahead_blocks) {
+  const int last_block = (length_ - 1) / kBlockSize;
+  int first_missing = -1;
+  int last_missing = -1;
+  for (int i = start / kBlockSize; i <= int(end / kBlockSize); ++i) {
+    if (!blocks_.contains(i)) {
+      if (first_missing == -1) first_missing = i;
+      last_missing = i;
+    }
   }
-}
 
-TagLib::ByteVector CloudStream::GetCached(int start, int end) {
-  const uint size = end - start + 1;
-  TagLib::ByteVector ret(size);
-  for (int i = 0; i < size; ++i) {
-    ret[i] = cache_.get(start + i);
+  if (first_missing == -1) {
+    return true;
   }
-  return ret;
-}
-
-void CloudStream::Precache() {
-  // For reading the tags of an MP3, TagLib tends to request:
-  // 1. The first 1024 bytes
-  // 2. Somewhere between the first 2KB and first 60KB
-  // 3. The last KB or two.
-  // 4. Somewhere in the first 64KB again
-  //
-  // OGG Vorbis may read the last 4KB.
-  //
-  // So, if we precache the first 64KB and the last 8KB we should be sorted :-)
-  // Ideally, we would use bytes=0-655364,-8096 but Google Drive does not seem
-  // to support multipart byte ranges yet so we have to make do with two
-  // requests.
-
-  seek(0, TagLib::IOStream::Beginning);
-  readBlock(kTaglibPrefixCacheBytes);
-  seek(kTaglibSuffixCacheBytes, TagLib::IOStream::End);
-  readBlock(kTaglibSuffixCacheBytes);
-  clear();
-}
-
-TagLib::ByteVector CloudStream::readBlock(ulong length) {
-  const uint start = cursor_;
-  const uint end = qMin(cursor_ + length - 1, length_ - 1);
 
-  if (end < start) {
-    return TagLib::ByteVector();
+  // Anything already cached between the missing blocks is fetched again, which
+  // is still cheaper than another round trip.
+  for (int i = 0; i < read_ahead_blocks && last_missing < last_block &&
+                  !blocks_.contains(last_missing + 1);
+       ++i) {
+    ++last_missing;
   }
 
-  if (CheckCache(start, end)) {
-    TagLib::ByteVector cached = GetCached(start, end);
-    cursor_ += cached.size();
-    return cached;
-  }
+  const ulong fetch_start = ulong(first_missing) * kBlockSize;
+  const ulong fetch_end =
+      qMin(ulong(last_missing + 1) * kBlockSize, length_) - 1;
+  return Fetch(fetch_start, fetch_end) && IsCached(start, end);
+}
 
+bool CloudStream::Fetch(ulong start, ulong end) {
   QNetworkRequest request = QNetworkRequest(url_);
   if (!auth_.isEmpty()) {
     request.setRawHeader("Authorization", auth_.toUtf8());
@@ -126,17 +157,190 @@ TagLib::ByteVector CloudStream::readBlock(ulong length) {
   reply->deleteLater();
 
   int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-  if (code >= 400) {
+  if (code >= 400 || reply->error() != QNetworkReply::NoError) {
     qLog(Debug) << "Error retrieving url to tag:" << url_;
+    return false;
+  }
+
+  // A server that ignores the Range header sends the whole file.
+  FillCache(code == 206 ? start : 0, reply->readAll());
+  return true;
+}
+
+void CloudStream::FillCache(ulong start, const QByteArray& data) {
+  for (int offset = 0; offset < data.size(); offset += kBlockSize) {
+    const QByteArray block = data.mid(offset, kBlockSize);
+    const ulong block_start = start + offset;
+
+    // Don't keep a partial block unless it's the end of the file.
+    if (block.size() < kBlockSize && block_start + block.size() < length_) {
+      break;
+    }
+
+    const int index = block_start / kBlockSize;
+    if (!blocks_.contains(index)) {
+      blocks_.insert(index, block);
+      cached_bytes_ += block.size();
+    }
+  }
+}
+
+QByteArray CloudStream::GetCached(ulong start, ulong end) const {
+  QByteArray ret;
+  ret.reserve(end - start + 1);
+
+  for (ulong pos = start; pos <= end;) {
+    const QByteArray block = blocks_.value(pos / kBlockSize);
+    const int offset = pos % kBlockSize;
+    const int count = qMin(ulong(block.size() - offset), end - pos + 1);
+    if (count <= 0) {
+      break;
+    }
+    ret.append(block.constData() + offset, count);
+    pos += count;
+  }
+  return ret;
+}
+
+ulong CloudStream::Id3v2TagEnd() const {
+  if (!IsCached(0, 9)) {
+    return 0;
+  }
+
+  const QByteArray header = GetCached(0, 9);
+  if (!header.startsWith("ID3")) {
+    return 0;
+  }
+
+  // The size is stored as four 7 bit bytes and doesn't include the header or
+  // the optional footer.
+  ulong size = 0;
+  for (int i = 6; i < 10; ++i) {
+    size = (size << 7) | (quint8(header[i]) & 0x7f);
+  }
+  const bool has_footer = quint8(header[5]) & 0x10;
+  return 10 + size + (has_footer ? 10 : 0);
+}
+
+bool CloudStream::FindMp4Moov(ulong* start, ulong* end) const {
+  if (!IsCached(0, 7) || GetCached(4, 7) != "ftyp") {
+    return false;
+  }
+
+  ulong offset = 0;
+  while (offset + 8 <= length_) {
+    if (!IsCached(offset, qMin(offset + 16, length_) - 1)) {
+      // When moov comes after mdat it is almost always the last atom, so
+      // assume it runs to the end of the file.
+      *start = offset;
+      *end = length_ - 1;
+      return true;
+    }
+
+    const QByteArray header = GetCached(offset, qMin(offset + 16, length_) - 1);
+    quint64 size = ReadBigEndian(header.constData(), 4);
+    if (size == 0) {
+      size = length_ - offset;
+    } else if (size == 1 && header.size() >= 16) {
+      size = ReadBigEndian(header.constData() + 8, 8);
+    }
+    if (size < 8) {
+      break;
+    }
+
+    if (header.mid(4, 4) == "moov") {
+      *start = offset;
+      *end = qMin(offset + size, quint64(length_)) - 1;
+      return true;
+    }
+    offset += size;
+  }
+
+  return false;
+}
+
+void CloudStream::Precache() {
+  // For reading the tags of an MP3, TagLib tends to request:
+  // 1. The first 1024 bytes
+  // 2. Somewhere between the first 2KB and first 60KB
+  // 3. The last KB or two.
+  // 4. Somewhere in the first 64KB again
+  //
+  // OGG Vorbis may read the last 4KB.
+  //
+  // So we precache the start and the last 8KB.  The start is 64KB unless an
+  // earlier file of this format needed more.  Ideally, we would use
+  // bytes=0-65535,-8192 but Google Drive does not seem to support multipart
+  // byte ranges yet so we have to make do with two requests.
+  //
+  // Once we have the start of the file we know where the tags really are: an
+  // ID3v2 tag says how long it is, and an MP4 file keeps everything in its
+  // moov atom, which is either near the start or at the very end.
+  if (length_ == 0) {
+    return;
+  }
+
+  prefix_bytes_ = qMin(PrefixBytes(format_), length_);
+  if (length_ <= prefix_bytes_ + kTaglibSuffixCacheBytes) {
+    // Cheaper to fetch the whole file than to make two requests.
+    prefix_bytes_ = length_;
+    EnsureCached(0, length_ - 1, 0);
+    return;
+  }
+
+  if (!EnsureCached(0, prefix_bytes_ - 1, 0)) {
+    return;
+  }
+
+  QList<QPair<ulong, ulong>> ranges;
+  ulong moov_start = 0;
+  ulong moov_end = 0;
+  if (FindMp4Moov(&moov_start, &moov_end)) {
+    ranges << qMakePair(moov_start, moov_end);
+  } else {
+    // TagLib also reads the first MPEG frame after the ID3v2 tag.
+    const ulong id3v2_end = Id3v2TagEnd();
+    if (id3v2_end != 0 && id3v2_end + kBlockSize > prefix_bytes_) {
+      RememberPrefixBytes(format_, id3v2_end + kBlockSize);
+      ranges << qMakePair(prefix_bytes_,
+                          qMin(id3v2_end + kBlockSize, length_) - 1);
+    }
+    ranges << qMakePair(length_ - kTaglibSuffixCacheBytes, length_ - 1);
+  }
+
+  // Fetch each range, joining any that are close together.
+  for (int i = 0; i < ranges.count(); ++i) {
+    const ulong start = ranges[i].first;
+    ulong end = ranges[i].second;
+    while (i + 1 < ranges.count() &&
+           ranges[i + 1].first <= end + kMaxRangeGapBytes) {
+      ++i;
+      end = qMax(end, ranges[i].second);
+    }
+    EnsureCached(start, end, 0);
+  }
+}
+
+TagLib::ByteVector CloudStream::readBlock(ulong length) {
+  const ulong start = cursor_;
+  if (length == 0 || start >= length_) {
     return TagLib::ByteVector();
   }
+  const ulong end = qMin(start + length - 1, length_ - 1);
 
-  QByteArray data = reply->readAll();
-  TagLib::ByteVector bytes(data.data(), data.size());
-  cursor_ += data.size();
+  if (!EnsureCached(start, end, kReadAheadBlocks)) {
+    return TagLib::ByteVector();
+  }
 
-  FillCache(start, bytes);
-  return bytes;
+  // Reading on from the prefix means files of this format have more at the
+  // start than we thought, so fetch more of it next time.
+  if (start < prefix_bytes_ && end >= prefix_bytes_ && end < length_ / 2) {
+    RememberPrefixBytes(format_, end + 1);
+  }
+
+  const QByteArray data = GetCached(start, end);
+  cursor_ += data.size();
+  return TagLib::ByteVector(data.constData(), data.size());
 }
 
 void CloudStream::writeBlock(const TagLib::ByteVector&) {
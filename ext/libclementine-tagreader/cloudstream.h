@@ -18,16 +18,23 @@
 #ifndef GOOGLEDRIVESTREAM_H
 #define GOOGLEDRIVESTREAM_H
 
+#include <QByteArray>
+#include <QHash>
 #include <QObject>
 #include <QList>
 #include <QSslError>
 #include <QUrl>
 
-#include <google/sparsetable>
 #include <taglib/tiostream.h>
 
 class QNetworkAccessManager;
 
+// A read-only TagLib stream over a file on a cloud service, fetched with HTTP
+// range requests.  Data is cached in fixed size blocks.  Missing blocks are
+// fetched together in one request along with a few blocks of read-ahead, and
+// Precache() uses what it knows about the layout of the common tag formats to
+// get everything TagLib will need up front, so most files only need one or two
+// requests.
 class CloudStream : public QObject, public TagLib::IOStream {
   Q_OBJECT
  public:
@@ -48,19 +55,34 @@ class CloudStream : public QObject, public TagLib::IOStream {
   virtual long length();
   virtual void truncate(long);
 
-  google::sparsetable<char>::size_type cached_bytes() const {
-    return cache_.num_nonempty();
-  }
-
+  qint64 cached_bytes() const { return cached_bytes_; }
   int num_requests() const { return num_requests_; }
 
   // Use educated guess to request the bytes that TagLib will probably want.
   void Precache();
 
+  // Forgets how much of each format's files earlier streams needed to fetch.
+  // Only used by tests.
+  static void ResetPrefixBytes();
+
  private:
-  bool CheckCache(int start, int end);
-  void FillCache(int start, TagLib::ByteVector data);
-  TagLib::ByteVector GetCached(int start, int end);
+  bool IsCached(ulong start, ulong end) const;
+
+  // Makes sure the bytes from start to end (inclusive) are cached, fetching
+  // any missing blocks in a single request.  Up to read_ahead_blocks uncached
+  // blocks after the range are fetched as well.
+  bool EnsureCached(ulong start, ulong end, int read_ahead_blocks);
+  bool Fetch(ulong start, ulong end);
+  void FillCache(ulong start, const QByteArray& data);
+  QByteArray GetCached(ulong start, ulong end) const;
+
+  // Returns the end of the ID3v2 tag at the start of the file, or 0 if there
+  // isn't one.
+  ulong Id3v2TagEnd() const;
+
+  // Walks the top level atoms of an MP4 file to find the moov atom, which
+  // holds all the metadata.  Returns false if this isn't an MP4 file.
+  bool FindMp4Moov(ulong* start, ulong* end) const;
 
  private slots:
   void SSLErrors(const QList<QSslError>& errors);
@@ -71,11 +93,15 @@ class CloudStream : public QObject, public TagLib::IOStream {
   const QByteArray encoded_filename_;
   const ulong length_;
   const QString auth_;
+  const QString format_;
 
   int cursor_;
   QNetworkAccessManager* network_;
 
-  google::sparsetable<char> cache_;
+  // Block index to its data.  Only the last block of the file can be short.
+  QHash<int, QByteArray> blocks_;
+  qint64 cached_bytes_;
+  ulong prefix_bytes_;
   int num_requests_;
 };
 
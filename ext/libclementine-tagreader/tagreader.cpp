@@ -74,16 +74,20 @@
 class FileRefFactory {
  public:
   virtual ~FileRefFactory() {}
-  virtual TagLib::FileRef* GetFileRef(const QString& filename) = 0;
+  virtual TagLib::FileRef* GetFileRef(const QString& filename,
+                                      bool read_audio_properties = true) = 0;
 };
 
 class TagLibFileRefFactory : public FileRefFactory {
  public:
-  virtual TagLib::FileRef* GetFileRef(const QString& filename) {
+  virtual TagLib::FileRef* GetFileRef(const QString& filename,
+                                      bool read_audio_properties = true) {
 #ifdef Q_OS_WIN32
-    return new TagLib::FileRef(filename.toStdWString().c_str());
+    return new TagLib::FileRef(filename.toStdWString().c_str(),
+                               read_audio_properties);
 #else
-    return new TagLib::FileRef(QFile::encodeName(filename).constData());
+    return new TagLib::FileRef(QFile::encodeName(filename).constData(),
+                               read_audio_properties);
 #endif
   }
 };
@@ -112,7 +116,8 @@ TagReader::TagReader()
       kEmbeddedCover("(embedded)") {}
 
 void TagReader::ReadFile(const QString& filename,
-                         pb::tagreader::SongMetadata* song) const {
+                         pb::tagreader::SongMetadata* song,
+                         bool read_audio_properties) const {
   const QByteArray url(QUrl::fromLocalFile(filename).toEncoded());
   const QFileInfo info(filename);
 
@@ -124,7 +129,8 @@ void TagReader::ReadFile(const QString& filename,
   song->set_mtime(info.lastModified().toTime_t());
   song->set_ctime(info.created().toTime_t());
 
-  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+  std::unique_ptr<TagLib::FileRef> fileref(
+      factory_->GetFileRef(filename, read_audio_properties));
   if (fileref->isNull()) {
     qLog(Info) << "TagLib hasn't been able to read " << filename << " file";
     return;
@@ -388,6 +394,26 @@ void TagReader::ReadFile(const QString& filename,
   SetDefault(samplerate);
   SetDefault(lastplayed);
 #undef SetDefault
+
+  // A sample rate of 0 tells the library the audio properties still have to
+  // be read.
+  if (!read_audio_properties) song->set_samplerate(0);
+}
+
+void TagReader::ReadAudioProperties(const QString& filename,
+                                    pb::tagreader::SongMetadata* song) const {
+  qLog(Debug) << "Reading audio properties from" << filename;
+
+  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+  if (fileref->isNull() || !fileref->audioProperties()) {
+    qLog(Info) << "TagLib hasn't been able to read " << filename << " file";
+    return;
+  }
+
+  song->set_bitrate(fileref->audioProperties()->bitrate());
+  song->set_samplerate(fileref->audioProperties()->sampleRate());
+  song->set_length_nanosec(fileref->audioProperties()->length() * kNsecPerSec);
+  song->set_valid(true);
 }
 
 void TagReader::Decode(const TagLib::String& tag, const QTextCodec* codec,
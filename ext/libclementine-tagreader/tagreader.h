@@ -51,8 +51,13 @@ class TagReader {
  public:
   TagReader();
 
-  void ReadFile(const QString& filename,
-                pb::tagreader::SongMetadata* song) const;
+  // If read_audio_properties is false the length, bitrate and sample rate
+  // aren't read, which can be much faster.
+  void ReadFile(const QString& filename, pb::tagreader::SongMetadata* song,
+                bool read_audio_properties = true) const;
+  // Reads only the length, bitrate and sample rate.
+  void ReadAudioProperties(const QString& filename,
+                           pb::tagreader::SongMetadata* song) const;
   bool SaveFile(const QString& filename,
                 const pb::tagreader::SongMetadata& song) const;
   // Returns false if something went wrong; returns true otherwise (might
@@ -25,10 +25,12 @@
 
 #include "config.h"
 #include "database.h"
+#include "foldingtokenizer.h"
 #include "scopedtransaction.h"
 #include "utilities.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/song.h"
 #include "core/taskmanager.h"
 
 #include <boost/scope_exit.hpp>
@@ -39,15 +41,17 @@
 #include <QDir>
 #include <QLibrary>
 #include <QLibraryInfo>
+#include <QSettings>
 #include <QSqlDriver>
 #include <QSqlQuery>
 #include <QtDebug>
 #include <QThread>
+#include <QTime>
 #include <QUrl>
 #include <QVariant>
 
 const char* Database::kDatabaseFilename = "clementine.db";
-const int Database::kSchemaVersion = 47;
+const int Database::kSchemaVersion = 49;
 const char* Database::kMagicAllSongsTables = "%allsongstables";
 
 int Database::sNextConnectionId = 1;
@@ -212,6 +216,7 @@ Database::Database(Application* app, QObject* parent,
     : QObject(parent),
       app_(app),
       mutex_(QMutex::Recursive),
+      wal_enabled_(false),
       injected_database_name_(database_name),
       query_hash_(0),
       startup_schema_version_(-1) {
@@ -226,10 +231,74 @@ Database::Database(Application* app, QObject* parent,
   attached_databases_["jamendo"] = AttachedDatabase(
       directory_ + "/jamendo.db", ":/schema/jamendo.sql", false);
 
+  if (injected_database_name_.isNull()) {
+    QSettings s;
+    s.beginGroup("Database");
+    wal_enabled_ = s.value("wal", true).toBool();
+  }
+
   QMutexLocker l(&mutex_);
   Connect();
 }
 
+Database::~Database() {
+  const LockStats write = write_lock_stats();
+  const LockStats read = read_lock_stats();
+  qLog(Debug) << "Database write lock:" << write.acquisitions_
+              << "acquisitions," << write.contended_ << "contended,"
+              << write.wait_msec_ << "ms waiting";
+  qLog(Debug) << "Database read lock:" << read.acquisitions_
+              << "acquisitions," << read.contended_ << "contended,"
+              << read.wait_msec_ << "ms waiting";
+}
+
+Database::WriteLocker::WriteLocker(Database* db) : db_(db) {
+  db_->LockMutex(&db_->write_lock_stats_);
+}
+
+Database::WriteLocker::~WriteLocker() { db_->mutex_.unlock(); }
+
+Database::ReadLocker::ReadLocker(Database* db)
+    : db_(db), locked_(!db->wal_enabled_) {
+  if (locked_) {
+    db_->LockMutex(&db_->read_lock_stats_);
+  } else {
+    db_->read_lock_stats_.acquisitions_.fetchAndAddRelaxed(1);
+  }
+}
+
+Database::ReadLocker::~ReadLocker() {
+  if (locked_) db_->mutex_.unlock();
+}
+
+void Database::LockMutex(AtomicLockStats* stats) {
+  stats->acquisitions_.fetchAndAddRelaxed(1);
+  if (mutex_.tryLock()) return;
+
+  QTime timer;
+  timer.start();
+  mutex_.lock();
+
+  stats->contended_.fetchAndAddRelaxed(1);
+  stats->wait_msec_.fetchAndAddRelaxed(timer.elapsed());
+}
+
+Database::LockStats Database::ToLockStats(const AtomicLockStats& stats) {
+  LockStats ret;
+  ret.acquisitions_ = stats.acquisitions_;
+  ret.contended_ = stats.contended_;
+  ret.wait_msec_ = stats.wait_msec_;
+  return ret;
+}
+
+Database::LockStats Database::write_lock_stats() const {
+  return ToLockStats(write_lock_stats_);
+}
+
+Database::LockStats Database::read_lock_stats() const {
+  return ToLockStats(read_lock_stats_);
+}
+
 QSqlDatabase Database::Connect() {
   QMutexLocker l(&connect_mutex_);
 
@@ -264,6 +333,15 @@ QSqlDatabase Database::Connect() {
   // Find Sqlite3 functions in the Qt plugin.
   StaticInit();
 
+  if (wal_enabled_) {
+    // Readers and the writer don't block each other in WAL mode.  The mode is
+    // persistent, but setting it again is harmless.
+    QSqlQuery q("PRAGMA journal_mode = WAL", db);
+    if (!q.exec()) {
+      qLog(Warning) << "Couldn't enable WAL mode:" << q.lastError().text();
+    }
+  }
+
   {
     QSqlQuery set_fts_tokenizer("SELECT fts3_tokenizer(:name, :pointer)", db);
     set_fts_tokenizer.bindValue(":name", "unicode");
@@ -277,6 +355,10 @@ QSqlDatabase Database::Connect() {
     // to release any remaining database locks!
   }
 
+  // FTS5 tables can't be opened without their tokenizer, so this has to
+  // happen on every connection.
+  const bool fts5_available = RegisterFts5Tokenizer(db);
+
   if (db.tables().count() == 0) {
     // Set up initial schema
     qLog(Info) << "Creating initial database schema";
@@ -297,10 +379,16 @@ QSqlDatabase Database::Connect() {
       qFatal("Couldn't attach external database '%s'",
              key.toAscii().constData());
     }
+
+    if (wal_enabled_ && !attached_databases_[key].is_temporary_) {
+      QSqlQuery wal(QString("PRAGMA %1.journal_mode = WAL").arg(key), db);
+      wal.exec();
+    }
   }
 
   if (startup_schema_version_ == -1) {
     UpdateMainSchema(&db);
+    UpdateFtsTables(db, fts5_available);
   }
 
   // We might have to initialise the schema in some attached databases now, if
@@ -348,6 +436,79 @@ void Database::UpdateMainSchema(QSqlDatabase* db) {
   }
 }
 
+bool Database::RegisterFts5Tokenizer(QSqlDatabase& db) {
+  QVariant handle = db.driver()->handle();
+  if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0) {
+    return false;
+  }
+
+  sqlite3* connection = *static_cast<sqlite3**>(handle.data());
+  return connection && FoldingTokenizer::Register(connection);
+}
+
+void Database::UpdateFtsTables(QSqlDatabase& db, bool fts5_available) {
+  // Only the library is big enough for FTS5's prefix indexes to be worth the
+  // space.  Devices and internet services keep their FTS3 tables.
+  const QString table = "songs_fts";
+
+  QString sql;
+  {
+    QSqlQuery q("SELECT sql FROM sqlite_master WHERE type = 'table'"
+                " AND name = :name",
+                db);
+    q.bindValue(":name", table);
+    if (!q.exec() || !q.next()) return;
+    sql = q.value(0).toString();
+  }
+
+  if (sql.contains("fts5", Qt::CaseInsensitive)) {
+    if (!fts5_available) {
+      // There's no way to drop the table without FTS5 either.
+      qLog(Error) << "The library's search index needs a version of sqlite"
+                  << "with FTS5";
+      return;
+    }
+    fts5_tables_ << table;
+    return;
+  }
+
+  if (!fts5_available) return;
+
+  qLog(Info) << "Moving" << table << "to FTS5";
+  QTime time;
+  time.start();
+
+  // The source columns are the fts columns without their "fts" prefix.
+  QStringList source_columns;
+  for (const QString& column : Song::kFtsColumns) {
+    source_columns << column.mid(3);
+  }
+
+  const QStringList commands =
+      QStringList()
+      << QString("DROP TABLE %1").arg(table)
+      << QString("CREATE VIRTUAL TABLE %1 USING fts5(%2, tokenize = '%3',"
+                 " prefix = '2 3 4')")
+             .arg(table, Song::kFtsColumnSpec, FoldingTokenizer::kName)
+      << QString("INSERT INTO %1 (ROWID, %2) SELECT ROWID, %3 FROM songs")
+             .arg(table, Song::kFtsColumnSpec, source_columns.join(", "));
+
+  ScopedTransaction t(&db);
+  for (const QString& command : commands) {
+    QSqlQuery q(db);
+    if (!q.exec(command)) {
+      qLog(Error) << "Couldn't move" << table << "to FTS5:"
+                  << q.lastError().text();
+      // The transaction is rolled back, leaving the FTS3 table.
+      return;
+    }
+  }
+  t.Commit();
+
+  fts5_tables_ << table;
+  qLog(Info) << "Rebuilt" << table << "in" << time.elapsed() << "ms";
+}
+
 void Database::RecreateAttachedDb(const QString& database_name) {
   if (!attached_databases_.contains(database_name)) {
     qLog(Warning) << "Attached database does not exist:" << database_name;
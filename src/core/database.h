@@ -24,6 +24,7 @@
 #ifndef CORE_DATABASE_H_
 #define CORE_DATABASE_H_
 
+#include <QAtomicInt>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
@@ -49,6 +50,42 @@ class Database : public QObject {
  public:
   Database(Application* app, QObject* parent = nullptr,
            const QString& database_name = QString());
+  ~Database();
+
+  // How often a lock was taken, how often the caller had to wait for it and
+  // for how long in total.
+  struct LockStats {
+    int acquisitions_;
+    int contended_;
+    int wait_msec_;
+  };
+
+  // Serialises changes to the database - hold one of these around anything
+  // that modifies it.
+  class WriteLocker {
+   public:
+    explicit WriteLocker(Database* db);
+    ~WriteLocker();
+
+   private:
+    Database* db_;
+    Q_DISABLE_COPY(WriteLocker);
+  };
+
+  // Hold one of these around read-only queries.  In WAL mode every thread
+  // reads from its own connection and sees a consistent snapshot of the
+  // database, so this doesn't lock anything and readers never wait for a
+  // writer.  Otherwise it's the same as a WriteLocker.
+  class ReadLocker {
+   public:
+    explicit ReadLocker(Database* db);
+    ~ReadLocker();
+
+   private:
+    Database* db_;
+    bool locked_;
+    Q_DISABLE_COPY(ReadLocker);
+  };
 
   struct AttachedDatabase {
     AttachedDatabase() {}
@@ -67,8 +104,20 @@ class Database : public QObject {
 
   QSqlDatabase Connect();
   bool CheckErrors(const QSqlQuery& query);
+  // The writer lock.  Prefer WriteLocker and ReadLocker, which also keep the
+  // contention counters up to date.
   QMutex* Mutex() { return &mutex_; }
 
+  bool is_wal_enabled() const { return wal_enabled_; }
+  LockStats write_lock_stats() const;
+  LockStats read_lock_stats() const;
+
+  // True if this full text index uses FTS5, which needs a different MATCH
+  // syntax.  The others are FTS3 tables.
+  bool is_fts5_table(const QString& table) const {
+    return fts5_tables_.contains(table);
+  }
+
   void RecreateAttachedDb(const QString& database_name);
   void ExecSchemaCommands(QSqlDatabase& db, const QString& schema,
                           int schema_version, bool in_transaction = false);
@@ -91,6 +140,10 @@ class Database : public QObject {
 
  private:
   void UpdateMainSchema(QSqlDatabase* db);
+  // Returns false if sqlite doesn't support FTS5.
+  bool RegisterFts5Tokenizer(QSqlDatabase& db);
+  // Moves the library's full text index to FTS5 if it's available.
+  void UpdateFtsTables(QSqlDatabase& db, bool fts5_available);
 
   void ExecSchemaCommandsFromFile(QSqlDatabase& db, const QString& filename,
                                   int schema_version,
@@ -105,6 +158,15 @@ class Database : public QObject {
   void BackupFile(const QString& filename);
   bool OpenDatabase(const QString& filename, sqlite3** connection) const;
 
+  struct AtomicLockStats {
+    QAtomicInt acquisitions_;
+    QAtomicInt contended_;
+    QAtomicInt wait_msec_;
+  };
+
+  void LockMutex(AtomicLockStats* stats);
+  static LockStats ToLockStats(const AtomicLockStats& stats);
+
   Application* app_;
 
   // Alias -> filename
@@ -114,6 +176,17 @@ class Database : public QObject {
   QMutex connect_mutex_;
   QMutex mutex_;
 
+  // Whether connections use SQLite's write-ahead log.  Only possible for
+  // databases on disk.
+  bool wal_enabled_;
+
+  AtomicLockStats write_lock_stats_;
+  AtomicLockStats read_lock_stats_;
+
+  // Full text tables that use FTS5 and the folding tokenizer.  Only written
+  // during the first Connect().
+  QStringList fts5_tables_;
+
   // This ID makes the QSqlDatabase name unique to the object as well as the
   // thread
   int connection_id_;
@@ -0,0 +1,256 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "foldingtokenizer.h"
+
+#include <string.h>
+
+namespace FoldingTokenizer {
+
+const char* kName = "clementine";
+
+namespace {
+
+// Longer tokens are truncated.
+const int kMaxTokenBytes = 128;
+
+// ASCII replacements for U+00C0 to U+017F.  A space means the character is a
+// separator, and the capital letters stand for the two letter replacements
+// handled in Fold().
+const char kLatinFold[] =
+    "aaaaaaAceeeeiiiidnooooo ouuuuyTS"   // U+00C0 - U+00DF
+    "aaaaaaAceeeeiiiidnooooo ouuuuyTy"   // U+00E0 - U+00FF
+    "aaaaaaccccccccddddeeeeeeeeeegggg"   // U+0100 - U+011F
+    "gggghhhhiiiiiiiiiiJJjjkkklllllll"   // U+0120 - U+013F
+    "lllnnnnnnnnnooooooOOrrrrrrssssss"   // U+0140 - U+015F
+    "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs";  // U+0160 - U+017F
+
+// Decodes the character at p.  Returns the number of bytes it uses, or 0 if
+// it's not valid UTF-8.
+int Decode(const unsigned char* p, const unsigned char* end,
+           unsigned int* codepoint) {
+  int length;
+  unsigned int c = *p;
+  if (c < 0x80) {
+    *codepoint = c;
+    return 1;
+  } else if ((c & 0xe0) == 0xc0) {
+    length = 2;
+    c &= 0x1f;
+  } else if ((c & 0xf0) == 0xe0) {
+    length = 3;
+    c &= 0x0f;
+  } else if ((c & 0xf8) == 0xf0) {
+    length = 4;
+    c &= 0x07;
+  } else {
+    return 0;
+  }
+
+  if (end - p < length) return 0;
+  for (int i = 1; i < length; ++i) {
+    if ((p[i] & 0xc0) != 0x80) return 0;
+    c = (c << 6) | (p[i] & 0x3f);
+  }
+  *codepoint = c;
+  return length;
+}
+
+int Encode(unsigned int c, char* out) {
+  if (c < 0x80) {
+    out[0] = c;
+    return 1;
+  } else if (c < 0x800) {
+    out[0] = 0xc0 | (c >> 6);
+    out[1] = 0x80 | (c & 0x3f);
+    return 2;
+  } else if (c < 0x10000) {
+    out[0] = 0xe0 | (c >> 12);
+    out[1] = 0x80 | ((c >> 6) & 0x3f);
+    out[2] = 0x80 | (c & 0x3f);
+    return 3;
+  }
+  out[0] = 0xf0 | (c >> 18);
+  out[1] = 0x80 | ((c >> 12) & 0x3f);
+  out[2] = 0x80 | ((c >> 6) & 0x3f);
+  out[3] = 0x80 | (c & 0x3f);
+  return 4;
+}
+
+bool IsSeparator(unsigned int c) {
+  if (c < 0x80) {
+    return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+             (c >= '0' && c <= '9'));
+  }
+  return (c < 0xc0) ||                      // Latin-1 punctuation and symbols
+         (c >= 0x2000 && c <= 0x2bff) ||    // Punctuation, arrows, symbols
+         (c >= 0x2e00 && c <= 0x2e7f) ||    // Supplemental punctuation
+         (c >= 0x3000 && c <= 0x303f) ||    // CJK punctuation
+         (c >= 0xfe30 && c <= 0xfe4f) ||    // CJK compatibility forms
+         (c >= 0xff00 && c <= 0xff0f) ||    // Fullwidth punctuation
+         (c >= 0xd800 && c <= 0xdfff) ||    // Surrogates
+         c == 0xfeff;                       // Byte order mark
+}
+
+// Writes the folded form of c to out and returns its length, 0 if c should be
+// dropped from the token or -1 if it ends the token.
+int Fold(unsigned int c, char* out) {
+  if (c < 0x80) {
+    if (IsSeparator(c)) return -1;
+    out[0] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    return 1;
+  }
+
+  if (c >= 0xc0 && c <= 0x17f) {
+    const char replacement = kLatinFold[c - 0xc0];
+    switch (replacement) {
+      case ' ':
+        return -1;
+      case 'A':
+        memcpy(out, "ae", 2);
+        return 2;
+      case 'J':
+        memcpy(out, "ij", 2);
+        return 2;
+      case 'O':
+        memcpy(out, "oe", 2);
+        return 2;
+      case 'S':
+        memcpy(out, "ss", 2);
+        return 2;
+      case 'T':
+        memcpy(out, "th", 2);
+        return 2;
+      default:
+        out[0] = replacement;
+        return 1;
+    }
+  }
+
+  // Combining diacritical marks, for text that is already decomposed.
+  if (c >= 0x300 && c <= 0x36f) return 0;
+
+  if (IsSeparator(c)) return -1;
+
+  // Greek and Cyrillic capitals.
+  if (c >= 0x391 && c <= 0x3a9 && c != 0x3a2) {
+    c += 0x20;
+  } else if (c >= 0x410 && c <= 0x42f) {
+    c += 0x20;
+  } else if (c >= 0x400 && c <= 0x40f) {
+    c += 0x50;
+  }
+
+  return Encode(c, out);
+}
+
+// FTS5 needs a non-null tokenizer object, but this one has no state.
+char sInstance;
+
+int XCreate(void*, const char**, int, Fts5Tokenizer** tokenizer) {
+  *tokenizer = reinterpret_cast<Fts5Tokenizer*>(&sInstance);
+  return SQLITE_OK;
+}
+
+void XDelete(Fts5Tokenizer*) {}
+
+int XTokenize(Fts5Tokenizer*, void* context, int, const char* text, int bytes,
+              TokenCallback callback) {
+  return FoldingTokenizer::Tokenize(text, bytes, context, callback);
+}
+
+}  // namespace
+
+int Tokenize(const char* text, int bytes, void* context,
+             TokenCallback callback) {
+  const unsigned char* begin = reinterpret_cast<const unsigned char*>(text);
+  const unsigned char* end = begin + bytes;
+
+  char token[kMaxTokenBytes];
+  int length = 0;
+  int start = 0;
+  bool in_token = false;
+
+  for (const unsigned char* p = begin; p < end;) {
+    const int offset = p - begin;
+
+    unsigned int codepoint;
+    int used = Decode(p, end, &codepoint);
+    char folded[4];
+    int folded_length = -1;
+    if (used == 0) {
+      // Treat invalid bytes as separators.
+      used = 1;
+    } else {
+      folded_length = Fold(codepoint, folded);
+    }
+    p += used;
+
+    if (folded_length < 0) {
+      if (in_token && length > 0) {
+        const int rc = callback(context, 0, token, length, start, offset);
+        if (rc != SQLITE_OK) return rc;
+      }
+      in_token = false;
+      length = 0;
+      continue;
+    }
+
+    if (!in_token) {
+      in_token = true;
+      start = offset;
+    }
+    if (length + folded_length <= kMaxTokenBytes) {
+      memcpy(token + length, folded, folded_length);
+      length += folded_length;
+    }
+  }
+
+  if (in_token && length > 0) {
+    return callback(context, 0, token, length, start, bytes);
+  }
+  return SQLITE_OK;
+}
+
+bool Register(sqlite3* db) {
+#if SQLITE_VERSION_NUMBER >= 3020000
+  // This is the documented way to get hold of the fts5_api.  The fts5()
+  // function doesn't exist if sqlite was built without FTS5.
+  fts5_api* api = nullptr;
+  sqlite3_stmt* statement = nullptr;
+  if (sqlite3_prepare_v2(db, "SELECT fts5(?1)", -1, &statement, nullptr) !=
+      SQLITE_OK) {
+    sqlite3_finalize(statement);
+    return false;
+  }
+  sqlite3_bind_pointer(statement, 1, &api, "fts5_api_ptr", nullptr);
+  sqlite3_step(statement);
+  sqlite3_finalize(statement);
+
+  if (!api || api->iVersion < 2) return false;
+
+  fts5_tokenizer tokenizer = {&XCreate, &XDelete, &XTokenize};
+  return api->xCreateTokenizer(api, kName, nullptr, &tokenizer, nullptr) ==
+         SQLITE_OK;
+#else
+  // sqlite3_bind_pointer() is needed to get the fts5_api.
+  return false;
+#endif
+}
+
+}  // namespace FoldingTokenizer
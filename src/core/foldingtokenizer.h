@@ -0,0 +1,49 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_FOLDINGTOKENIZER_H_
+#define CORE_FOLDINGTOKENIZER_H_
+
+#include <sqlite3.h>
+
+// An FTS5 tokenizer that splits text on anything that isn't a letter or a
+// number, lowercases it and strips diacritics, so "Motörhead" is indexed as
+// "motorhead".  Unlike the FTS3 tokenizer in Database it works on the UTF-8
+// bytes directly and never builds a QString.
+namespace FoldingTokenizer {
+
+// The name the tokenizer is registered under, used in tokenize='...'.
+extern const char* kName;
+
+// Registers the tokenizer on this connection.  Returns false if sqlite was
+// built without FTS5.
+bool Register(sqlite3* db);
+
+// Has the same signature as FTS5's xToken callback.
+typedef int (*TokenCallback)(void* context, int flags, const char* token,
+                             int bytes, int start, int end);
+
+// Calls callback for every folded token in text.  start and end are byte
+// offsets into text.  Stops early and returns the callback's result if it
+// isn't SQLITE_OK.
+int Tokenize(const char* text, int bytes, void* context,
+             TokenCallback callback);
+
+}  // namespace FoldingTokenizer
+
+#endif  // CORE_FOLDINGTOKENIZER_H_
@@ -57,6 +57,7 @@ void RegisterMetaTypes() {
   qRegisterMetaType<const char*>("const char*");
   qRegisterMetaType<CoverSearchResult>("CoverSearchResult");
   qRegisterMetaType<CoverSearchResults>("CoverSearchResults");
+  qRegisterMetaType<CoverSearchStatistics>("CoverSearchStatistics");
   qRegisterMetaType<DigitallyImportedClient::Channel>(
       "DigitallyImportedClient::Channel");
   qRegisterMetaType<Directory>("Directory");
@@ -70,6 +71,7 @@ void RegisterMetaTypes() {
   qRegisterMetaType<GstElement*>("GstElement*");
   qRegisterMetaType<GstEngine::OutputDetails>("GstEngine::OutputDetails");
   qRegisterMetaType<GstEnginePipeline*>("GstEnginePipeline*");
+  qRegisterMetaType<PlaylistChanges>("PlaylistChanges");
   qRegisterMetaType<PlaylistItemList>("PlaylistItemList");
   qRegisterMetaType<PlaylistItemPtr>("PlaylistItemPtr");
   qRegisterMetaType<PodcastEpisodeList>("PodcastEpisodeList");
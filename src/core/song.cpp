@@ -65,6 +65,7 @@
 #include "core/logging.h"
 #include "core/messagehandler.h"
 #include "core/mpris_common.h"
+#include "core/stringpool.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
@@ -111,7 +112,8 @@ const QStringList Song::kColumns = QStringList() << "title"
                                                  << "effective_albumartist"
                                                  << "etag"
                                                  << "performer"
-                                                 << "grouping";
+                                                 << "grouping"
+                                                 << "content_id";
 
 const QString Song::kColumnSpec = Song::kColumns.join(", ");
 const QString Song::kBindSpec =
@@ -219,6 +221,7 @@ struct Song::Private : public QSharedData {
   bool unavailable_;
 
   QString etag_;
+  QString content_id_;
 };
 
 Song::Private::Private()
@@ -316,6 +319,7 @@ bool Song::is_library_song() const {
 const QString& Song::art_automatic() const { return d->art_automatic_; }
 const QString& Song::art_manual() const { return d->art_manual_; }
 const QString& Song::etag() const { return d->etag_; }
+const QString& Song::content_id() const { return d->content_id_; }
 bool Song::has_manually_unset_cover() const {
   return d->art_manual_ == kManuallyUnsetCover;
 }
@@ -367,6 +371,7 @@ void Song::set_score(int v) { d->score_ = qBound(0, v, 100); }
 void Song::set_cue_path(const QString& v) { d->cue_path_ = v; }
 void Song::set_unavailable(bool v) { d->unavailable_ = v; }
 void Song::set_etag(const QString& etag) { d->etag_ = etag; }
+void Song::set_content_id(const QString& v) { d->content_id_ = v; }
 
 void Song::set_url(const QUrl& v) {
   if (Application::kIsPortable) {
@@ -517,6 +522,10 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
     d->art_automatic_ = QStringFromStdString(pb.art_automatic());
   }
 
+  if (pb.has_content_id()) {
+    d->content_id_ = QStringFromStdString(pb.content_id());
+  }
+
   if (pb.has_rating()) {
     d->rating_ = pb.rating();
   }
@@ -625,6 +634,7 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
 
   d->performer_ = tostr(col + 38);
   d->grouping_ = tostr(col + 39);
+  d->content_id_ = tostr(col + 40);
 
   InitArtManual();
 
@@ -665,6 +675,20 @@ void Song::InitArtManual() {
   }
 }
 
+void Song::ShareStrings(StringPool* pool) {
+  pool->Share(&d->album_);
+  pool->Share(&d->artist_);
+  pool->Share(&d->albumartist_);
+  pool->Share(&d->composer_);
+  pool->Share(&d->performer_);
+  pool->Share(&d->grouping_);
+  pool->Share(&d->genre_);
+  pool->Share(&d->comment_);
+  pool->Share(&d->cue_path_);
+  pool->Share(&d->art_automatic_);
+  pool->Share(&d->art_manual_);
+}
+
 #ifdef HAVE_LIBLASTFM
 void Song::InitFromLastFM(const lastfm::Track& track) {
   d->valid_ = true;
@@ -904,7 +928,11 @@ void Song::BindToQuery(QSqlQuery* query) const {
   query->bindValue(":compilation", d->compilation_ ? 1 : 0);
 
   query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
+  // A sample rate of exactly 0 means the audio properties haven't been read
+  // yet, which is stored as NULL.  See LibraryWatcher::ReadAudioPropertiesNow.
+  query->bindValue(":samplerate", d->samplerate_ == 0
+                                      ? QVariant()
+                                      : QVariant(intval(d->samplerate_)));
 
   query->bindValue(":directory", notnullintval(d->directory_id_));
 
@@ -950,6 +978,7 @@ void Song::BindToQuery(QSqlQuery* query) const {
 
   query->bindValue(":performer", strval(d->performer_));
   query->bindValue(":grouping", strval(d->grouping_));
+  query->bindValue(":content_id", strval(d->content_id_));
 
 #undef intval
 #undef notnullintval
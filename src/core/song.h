@@ -62,6 +62,7 @@ class Track;
 #endif
 
 class SqlRow;
+class StringPool;
 
 class Song {
  public:
@@ -122,6 +123,10 @@ class Song {
       const QString& filename);  // Just store the filename: incomplete but fast
   void InitArtManual();  // Check if there is already a art in the cache and
                          // store the filename in art_manual
+
+  // Shares the strings that are usually the same for many songs, like the
+  // artist and album, with equal strings from other songs in the pool.
+  void ShareStrings(StringPool* pool);
 #ifdef HAVE_LIBLASTFM
   void InitFromLastFM(const lastfm::Track& track);
 #endif
@@ -212,6 +217,9 @@ class Song {
   const QString& art_manual() const;
 
   const QString& etag() const;
+  // Identifies the file's contents, so it can be recognised after it's been
+  // moved or renamed.  Set by LibraryWatcher.
+  const QString& content_id() const;
 
   // Returns true if this Song had it's cover manually unset by user.
   bool has_manually_unset_cover() const;
@@ -281,6 +289,7 @@ class Song {
   void set_cue_path(const QString& v);
   void set_unavailable(bool v);
   void set_etag(const QString& etag);
+  void set_content_id(const QString& v);
 
   // Setters that should only be used by tests
   void set_url(const QUrl& v);
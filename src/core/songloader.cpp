@@ -253,8 +253,32 @@ void SongLoader::LoadLocalAsync(const QString& filename) {
 }
 
 void SongLoader::LoadMetadataBlocking() {
+  // Songs that aren't in the library are read from disk together, so a whole
+  // directory costs a handful of ReadFiles requests instead of one round trip
+  // per file.
+  QStringList filenames;
+  QList<int> indices;
+  SongList songs_to_read;
+
   for (int i = 0; i < songs_.size(); i++) {
-    EffectiveSongLoad(&songs_[i]);
+    Song* song = &songs_[i];
+    if (song->filetype() != Song::Type_Unknown) continue;
+
+    Song library_song = library_->GetSongByUrl(song->url());
+    if (library_song.is_valid()) {
+      *song = library_song;
+    } else {
+      filenames << song->url().toLocalFile();
+      indices << i;
+      songs_to_read << *song;
+    }
+  }
+
+  if (filenames.isEmpty()) return;
+
+  TagReaderClient::Instance()->ReadFilesBlocking(filenames, &songs_to_read);
+  for (int i = 0; i < indices.count(); ++i) {
+    songs_[indices[i]] = songs_to_read[i];
   }
 }
 
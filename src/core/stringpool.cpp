@@ -0,0 +1,32 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stringpool.h"
+
+void StringPool::Share(QString* s) {
+  // Empty strings don't have any data worth sharing, and null ones have to
+  // stay null.
+  if (s->isEmpty()) return;
+
+  QSet<QString>::const_iterator it = strings_.constFind(*s);
+  if (it == strings_.constEnd()) {
+    strings_.insert(*s);
+  } else {
+    *s = *it;
+  }
+}
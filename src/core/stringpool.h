@@ -0,0 +1,41 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_STRINGPOOL_H_
+#define CORE_STRINGPOOL_H_
+
+#include <QSet>
+#include <QString>
+
+// Makes equal strings share their data.  QString only shares data between
+// copies of the same string, so the artist of every song on an album loaded
+// from the database is otherwise stored once per song.
+// Not thread safe.
+class StringPool {
+ public:
+  // Replaces the string with an equal one from the pool, adding it if there
+  // isn't one yet.
+  void Share(QString* s);
+
+  int count() const { return strings_.count(); }
+
+ private:
+  QSet<QString> strings_;
+};
+
+#endif  // CORE_STRINGPOOL_H_
@@ -27,7 +27,10 @@
 #include <QThread>
 #include <QUrl>
 
+#include "core/sharedmemoryblob.h"
+
 const char* TagReaderClient::kWorkerExecutableName = "clementine-tagreader";
+const int TagReaderClient::kReadFilesBatchSize = 32;
 TagReaderClient* TagReaderClient::sInstance = nullptr;
 
 TagReaderClient::TagReaderClient(QObject* parent)
@@ -35,7 +38,8 @@ TagReaderClient::TagReaderClient(QObject* parent)
   sInstance = this;
 
   worker_pool_->SetExecutableName(kWorkerExecutableName);
-  worker_pool_->SetWorkerCount(QThread::idealThreadCount());
+  // One extra for the worker WorkerPool keeps free for interactive requests.
+  worker_pool_->SetWorkerCount(QThread::idealThreadCount() + 1);
   connect(worker_pool_, SIGNAL(WorkerFailedToStart()),
           SLOT(WorkerFailedToStart()));
 }
@@ -57,6 +61,48 @@ TagReaderReply* TagReaderClient::ReadFile(const QString& filename) {
   return worker_pool_->SendMessageWithReply(&message);
 }
 
+TagReaderReply* TagReaderClient::ReadFiles(const QStringList& filenames,
+                                           bool tags_only, Priority priority,
+                                           bool content_ids) {
+  pb::tagreader::Message message;
+  pb::tagreader::ReadFilesRequest* req = message.mutable_read_files_request();
+
+  for (const QString& filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+  if (tags_only) req->set_tags_only(true);
+  if (content_ids) req->set_content_ids(true);
+
+  return worker_pool_->SendMessageWithReply(&message, priority);
+}
+
+TagReaderReply* TagReaderClient::ReadContentIds(const QStringList& filenames) {
+  pb::tagreader::Message message;
+  pb::tagreader::ReadContentIdsRequest* req =
+      message.mutable_read_content_ids_request();
+
+  for (const QString& filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+
+  return worker_pool_->SendMessageWithReply(&message,
+                                            _WorkerPoolBase::Priority_Bulk);
+}
+
+TagReaderReply* TagReaderClient::ReadAudioProperties(
+    const QStringList& filenames) {
+  pb::tagreader::Message message;
+  pb::tagreader::ReadAudioPropertiesRequest* req =
+      message.mutable_read_audio_properties_request();
+
+  for (const QString& filename : filenames) {
+    req->add_filenames(DataCommaSizeFromQString(filename));
+  }
+
+  return worker_pool_->SendMessageWithReply(&message,
+                                            _WorkerPoolBase::Priority_Bulk);
+}
+
 TagReaderReply* TagReaderClient::SaveFile(const QString& filename,
                                           const Song& metadata) {
   pb::tagreader::Message message;
@@ -68,7 +114,8 @@ TagReaderReply* TagReaderClient::SaveFile(const QString& filename,
   return worker_pool_->SendMessageWithReply(&message);
 }
 
-TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata) {
+TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata,
+                                                      Priority priority) {
   pb::tagreader::Message message;
   pb::tagreader::SaveSongStatisticsToFileRequest* req =
       message.mutable_save_song_statistics_to_file_request();
@@ -76,17 +123,19 @@ TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata) {
   req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
   metadata.ToProtobuf(req->mutable_metadata());
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return worker_pool_->SendMessageWithReply(&message, priority);
 }
 
 void TagReaderClient::UpdateSongsStatistics(const SongList& songs) {
   for (const Song& song : songs) {
-    TagReaderReply* reply = UpdateSongStatistics(song);
+    TagReaderReply* reply =
+        UpdateSongStatistics(song, _WorkerPoolBase::Priority_Bulk);
     connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
   }
 }
 
-TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata) {
+TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata,
+                                                  Priority priority) {
   pb::tagreader::Message message;
   pb::tagreader::SaveSongRatingToFileRequest* req =
       message.mutable_save_song_rating_to_file_request();
@@ -94,12 +143,13 @@ TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata) {
   req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
   metadata.ToProtobuf(req->mutable_metadata());
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return worker_pool_->SendMessageWithReply(&message, priority);
 }
 
 void TagReaderClient::UpdateSongsRating(const SongList& songs) {
   for (const Song& song : songs) {
-    TagReaderReply* reply = UpdateSongRating(song);
+    TagReaderReply* reply =
+        UpdateSongRating(song, _WorkerPoolBase::Priority_Bulk);
     connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
   }
 }
@@ -114,14 +164,16 @@ TagReaderReply* TagReaderClient::IsMediaFile(const QString& filename) {
   return worker_pool_->SendMessageWithReply(&message);
 }
 
-TagReaderReply* TagReaderClient::LoadEmbeddedArt(const QString& filename) {
+TagReaderReply* TagReaderClient::LoadEmbeddedArt(const QString& filename,
+                                                 Priority priority) {
   pb::tagreader::Message message;
   pb::tagreader::LoadEmbeddedArtRequest* req =
       message.mutable_load_embedded_art_request();
 
   req->set_filename(DataCommaSizeFromQString(filename));
+  req->set_allow_shared_memory(true);
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return worker_pool_->SendMessageWithReply(&message, priority);
 }
 
 TagReaderReply* TagReaderClient::ReadCloudFile(
@@ -151,6 +203,60 @@ void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
   reply->deleteLater();
 }
 
+void TagReaderClient::ReadFilesBlocking(const QStringList& filenames,
+                                        SongList* songs) {
+  Q_ASSERT(QThread::currentThread() != thread());
+  Q_ASSERT(filenames.count() == songs->count());
+
+  // Send every batch first so they are spread over all the workers, then
+  // collect the responses in order.
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    replies << ReadFiles(filenames.mid(i, kReadFilesBatchSize));
+  }
+
+  for (int i = 0; i < replies.count(); ++i) {
+    TagReaderReply* reply = replies[i];
+    if (reply->WaitForFinished()) {
+      const pb::tagreader::ReadFilesResponse& response =
+          reply->message().read_files_response();
+      const int offset = i * kReadFilesBatchSize;
+      for (int j = 0; j < response.metadata_size() &&
+                      offset + j < songs->count(); ++j) {
+        (*songs)[offset + j].InitFromProtobuf(response.metadata(j));
+      }
+    }
+    reply->deleteLater();
+  }
+}
+
+QStringList TagReaderClient::ReadContentIdsBlocking(
+    const QStringList& filenames) {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    replies << ReadContentIds(filenames.mid(i, kReadFilesBatchSize));
+  }
+
+  QStringList ret;
+  for (int i = 0; i < replies.count(); ++i) {
+    TagReaderReply* reply = replies[i];
+    const int batch_size =
+        qMin(kReadFilesBatchSize, filenames.count() - i * kReadFilesBatchSize);
+    const bool success = reply->WaitForFinished();
+    const pb::tagreader::ReadContentIdsResponse& response =
+        reply->message().read_content_ids_response();
+    for (int j = 0; j < batch_size; ++j) {
+      ret << (success && j < response.content_ids_size()
+                  ? QStringFromStdString(response.content_ids(j))
+                  : QString());
+    }
+    reply->deleteLater();
+  }
+  return ret;
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString& filename,
                                        const Song& metadata) {
   Q_ASSERT(QThread::currentThread() != thread());
@@ -215,9 +321,44 @@ QImage TagReaderClient::LoadEmbeddedArtBlocking(const QString& filename) {
 
   TagReaderReply* reply = LoadEmbeddedArt(filename);
   if (reply->WaitForFinished()) {
-    const std::string& data_str =
-        reply->message().load_embedded_art_response().data();
-    ret.loadFromData(QByteArray(data_str.data(), data_str.size()));
+    const pb::tagreader::LoadEmbeddedArtResponse& response =
+        reply->message().load_embedded_art_response();
+    if (response.has_shared_memory()) {
+      // Decode straight out of the worker's shared memory.
+      SharedMemoryBlob blob(response.shared_memory().name(),
+                            response.shared_memory().size());
+      if (blob.is_valid()) ret.loadFromData(blob.data(), blob.size());
+    } else {
+      const std::string& data_str = response.data();
+      ret.loadFromData(reinterpret_cast<const uchar*>(data_str.data()),
+                       data_str.size());
+    }
+  }
+  reply->deleteLater();
+
+  return ret;
+}
+
+QByteArray TagReaderClient::LoadEmbeddedArtDataBlocking(const QString& filename,
+                                                        Priority priority) {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  QByteArray ret;
+
+  TagReaderReply* reply = LoadEmbeddedArt(filename, priority);
+  if (reply->WaitForFinished()) {
+    const pb::tagreader::LoadEmbeddedArtResponse& response =
+        reply->message().load_embedded_art_response();
+    if (response.has_shared_memory()) {
+      SharedMemoryBlob blob(response.shared_memory().name(),
+                            response.shared_memory().size());
+      if (blob.is_valid()) {
+        ret = QByteArray(reinterpret_cast<const char*>(blob.data()),
+                         blob.size());
+      }
+    } else {
+      ret = QByteArray(response.data().data(), response.data().size());
+    }
   }
   reply->deleteLater();
 
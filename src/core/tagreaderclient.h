@@ -39,17 +39,41 @@ class TagReaderClient : public QObject {
 
   typedef AbstractMessageHandler<pb::tagreader::Message> HandlerType;
   typedef HandlerType::ReplyType ReplyType;
+  typedef _WorkerPoolBase::Priority Priority;
 
   static const char* kWorkerExecutableName;
 
+  // The maximum number of filenames sent in one ReadFiles request by
+  // ReadFilesBlocking.  Larger lists are split so several workers can read
+  // them at once.
+  static const int kReadFilesBatchSize;
+
   void Start();
 
+  // Requests for things the user is waiting on should be left interactive.
+  // Library scans and other batch work pass Priority_Bulk so they don't hold
+  // those up.  ReadAudioProperties is only ever used for background work, so
+  // it is always bulk.
   ReplyType* ReadFile(const QString& filename);
+  ReplyType* ReadFiles(
+      const QStringList& filenames, bool tags_only = false,
+      Priority priority = _WorkerPoolBase::Priority_Interactive,
+      bool content_ids = false);
+  ReplyType* ReadAudioProperties(const QStringList& filenames);
+  ReplyType* ReadContentIds(const QStringList& filenames);
   ReplyType* SaveFile(const QString& filename, const Song& metadata);
-  ReplyType* UpdateSongStatistics(const Song& metadata);
-  ReplyType* UpdateSongRating(const Song& metadata);
+  ReplyType* UpdateSongStatistics(
+      const Song& metadata,
+      Priority priority = _WorkerPoolBase::Priority_Interactive);
+  ReplyType* UpdateSongRating(
+      const Song& metadata,
+      Priority priority = _WorkerPoolBase::Priority_Interactive);
   ReplyType* IsMediaFile(const QString& filename);
-  ReplyType* LoadEmbeddedArt(const QString& filename);
+  // The reply may carry the image in a SharedMemoryBlob instead of inline, so
+  // use LoadEmbeddedArtBlocking unless you handle that too.
+  ReplyType* LoadEmbeddedArt(
+      const QString& filename,
+      Priority priority = _WorkerPoolBase::Priority_Interactive);
   ReplyType* ReadCloudFile(const QUrl& download_url, const QString& title,
                            int size, const QString& mime_type,
                            const QString& authorisation_header);
@@ -58,11 +82,20 @@ class TagReaderClient : public QObject {
   // response.  These block the calling thread with a semaphore, and must NOT
   // be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString& filename, Song* song);
+  // songs must contain one entry per filename.  Each entry is initialised
+  // from the file's metadata if the read succeeded.
+  void ReadFilesBlocking(const QStringList& filenames, SongList* songs);
+  // Returns one ID per filename, empty for files that couldn't be read.
+  QStringList ReadContentIdsBlocking(const QStringList& filenames);
   bool SaveFileBlocking(const QString& filename, const Song& metadata);
   bool UpdateSongStatisticsBlocking(const Song& metadata);
   bool UpdateSongRatingBlocking(const Song& metadata);
   bool IsMediaFileBlocking(const QString& filename);
   QImage LoadEmbeddedArtBlocking(const QString& filename);
+  // Returns the art as it's stored in the file, without decoding it.
+  QByteArray LoadEmbeddedArtDataBlocking(
+      const QString& filename,
+      Priority priority = _WorkerPoolBase::Priority_Interactive);
 
   // TODO(David Sansome): Make this not a singleton
   static TagReaderClient* Instance() { return sInstance; }
@@ -50,6 +50,17 @@ QList<TaskManager::Task> TaskManager::GetTasks() {
   return ret;
 }
 
+void TaskManager::SetTaskName(int id, const QString& name) {
+  {
+    QMutexLocker l(&mutex_);
+    if (!tasks_.contains(id)) return;
+
+    tasks_[id].name = name;
+  }
+
+  emit TasksChanged();
+}
+
 void TaskManager::SetTaskBlocksLibraryScans(int id) {
   {
     QMutexLocker l(&mutex_);
@@ -57,6 +57,7 @@ class TaskManager : public QObject {
   QList<Task> GetTasks();
 
   int StartTask(const QString& name);
+  void SetTaskName(int id, const QString& name);
   void SetTaskBlocksLibraryScans(int id);
   void SetTaskProgress(int id, int progress, int max = 0);
   void IncreaseTaskProgress(int id, int progress, int max = 0);
@@ -130,6 +130,7 @@ enum ConfigPath {
   Path_DefaultMusicLibrary,
   Path_LocalSpotifyBlob,
   Path_MoodbarCache,
+  Path_ThumbnailCache,
   Path_CacheRoot,
 };
 QString GetConfigPath(ConfigPath config);
@@ -19,7 +19,11 @@
 
 #include "albumcoverexporter.h"
 
+#include <cstdio>
+
 #include <QFile>
+#include <QMutexLocker>
+#include <QThread>
 #include <QThreadPool>
 
 #include "coverexportrunnable.h"
@@ -33,7 +37,8 @@ AlbumCoverExporter::AlbumCoverExporter(QObject* parent)
       exported_(0),
       skipped_(0),
       all_(0) {
-  thread_pool_->setMaxThreadCount(kMaxConcurrentRequests);
+  thread_pool_->setMaxThreadCount(
+      qMax(kMaxConcurrentRequests, QThread::idealThreadCount()));
 }
 
 void AlbumCoverExporter::SetDialogResult(
@@ -42,18 +47,84 @@ void AlbumCoverExporter::SetDialogResult(
 }
 
 void AlbumCoverExporter::AddExportRequest(Song song) {
-  requests_.append(new CoverExportRunnable(dialog_result_, song));
+  requests_.append(new CoverExportRunnable(dialog_result_, song, this));
   all_ = requests_.count();
 }
 
-void AlbumCoverExporter::Cancel() { requests_.clear(); }
+void AlbumCoverExporter::Cancel() {
+  qDeleteAll(requests_);
+  requests_.clear();
+}
 
 void AlbumCoverExporter::StartExporting() {
   exported_ = 0;
   skipped_ = 0;
+
+  {
+    QMutexLocker l(&mutex_);
+    exported_files_.clear();
+    exported_keys_.clear();
+  }
+
   AddJobsToPool();
 }
 
+QByteArray AlbumCoverExporter::ExportedData(const QByteArray& key) const {
+  QFile file;
+  {
+    QMutexLocker l(&mutex_);
+    const QString filename = exported_files_.value(key);
+    if (filename.isEmpty()) return QByteArray();
+
+    // Files are only ever replaced by renaming another one over them, so once
+    // this one's open it can be read without the lock.
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+  }
+  return file.readAll();
+}
+
+bool AlbumCoverExporter::ReplaceExportedFile(const QByteArray& key,
+                                             const QString& temp_filename,
+                                             const QString& filename) {
+  QMutexLocker l(&mutex_);
+
+#ifdef Q_OS_WIN32
+  // rename() won't replace an existing file on Windows.
+  QFile::remove(filename);
+  if (!QFile::rename(temp_filename, filename)) {
+#else
+  if (::rename(QFile::encodeName(temp_filename).constData(),
+               QFile::encodeName(filename).constData()) != 0) {
+#endif
+    QFile::remove(temp_filename);
+    return false;
+  }
+
+  RecordExportedFile(key, filename);
+  return true;
+}
+
+void AlbumCoverExporter::FileExported(const QByteArray& key,
+                                      const QString& filename) {
+  QMutexLocker l(&mutex_);
+  RecordExportedFile(key, filename);
+}
+
+void AlbumCoverExporter::RecordExportedFile(const QByteArray& key,
+                                            const QString& filename) {
+  // Albums in the same directory can overwrite each other's covers.
+  const QByteArray old_key = exported_keys_.take(filename);
+  if (!old_key.isEmpty() && exported_files_.value(old_key) == filename) {
+    exported_files_.remove(old_key);
+  }
+
+  if (!key.isEmpty()) {
+    exported_files_[key] = filename;
+    exported_keys_[filename] = key;
+  }
+}
+
 void AlbumCoverExporter::AddJobsToPool() {
   while (!requests_.isEmpty() &&
          thread_pool_->activeThreadCount() < thread_pool_->maxThreadCount()) {
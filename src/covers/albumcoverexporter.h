@@ -23,6 +23,8 @@
 #include "core/song.h"
 #include "ui/albumcoverexport.h"
 
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QQueue>
 #include <QTimer>
@@ -45,6 +47,19 @@ class AlbumCoverExporter : public QObject {
 
   int request_count() { return requests_.size(); }
 
+  // The contents of the file a cover with this key has already been exported
+  // to during this export, so other albums with the same art can copy it
+  // instead of encoding it again.  Called from the CoverExportRunnables'
+  // threads.
+  QByteArray ExportedData(const QByteArray& key) const;
+  // Records that the file now holds the cover with this key, or something
+  // else if the key is empty.
+  void FileExported(const QByteArray& key, const QString& filename);
+  // Renames a fully written temporary file over the target and records it
+  // like FileExported(), so ExportedData() never sees a half written file.
+  bool ReplaceExportedFile(const QByteArray& key, const QString& temp_filename,
+                           const QString& filename);
+
  signals:
   void AlbumCoversExportUpdate(int exported, int skipped, int all);
 
@@ -54,11 +69,18 @@ class AlbumCoverExporter : public QObject {
 
  private:
   void AddJobsToPool();
+  // Must be called with mutex_ held.
+  void RecordExportedFile(const QByteArray& key, const QString& filename);
+
   AlbumCoverExport::DialogResult dialog_result_;
 
   QQueue<CoverExportRunnable*> requests_;
   QThreadPool* thread_pool_;
 
+  mutable QMutex mutex_;
+  QHash<QByteArray, QString> exported_files_;
+  QHash<QString, QByteArray> exported_keys_;
+
   int exported_;
   int skipped_;
   int all_;
@@ -20,12 +20,23 @@
 
 #include "albumcoverfetcher.h"
 
+#include <cmath>
+
+#include <QDateTime>
 #include <QTimer>
 
 #include "albumcoverfetchersearch.h"
+#include "coverprovider.h"
 #include "core/network.h"
 
 const int AlbumCoverFetcher::kMaxConcurrentRequests = 5;
+const int AlbumCoverFetcher::kMissCacheExpirySecs = 24 * 60 * 60;
+
+namespace {
+// Keys of fetches that found nothing, and when.  Shared by all the fetchers,
+// which all live in the GUI thread.
+QHash<QString, qint64> sMissCache;
+}
 
 AlbumCoverFetcher::AlbumCoverFetcher(CoverProviders* cover_providers,
                                      QObject* parent,
@@ -34,9 +45,15 @@ AlbumCoverFetcher::AlbumCoverFetcher(CoverProviders* cover_providers,
       cover_providers_(cover_providers),
       network_(network ? network : new NetworkAccessManager(this)),
       next_id_(0),
-      request_starter_(new QTimer(this)) {
+      request_starter_(new QTimer(this)),
+      provider_starter_(new QTimer(this)) {
   request_starter_->setInterval(1000);
   connect(request_starter_, SIGNAL(timeout()), SLOT(StartRequests()));
+
+  provider_starter_->setSingleShot(true);
+  connect(provider_starter_, SIGNAL(timeout()), SLOT(StartProviderSearches()));
+
+  clock_.start();
 }
 
 quint64 AlbumCoverFetcher::FetchAlbumCover(const QString& artist,
@@ -63,7 +80,34 @@ quint64 AlbumCoverFetcher::SearchForCovers(const QString& artist,
   return request.id;
 }
 
+QString AlbumCoverFetcher::RequestKey(const CoverSearchRequest& req) {
+  return QString("%1\n%2\n%3")
+      .arg(req.search ? "search" : "fetch", req.artist.simplified().toLower(),
+           req.album.simplified().toLower());
+}
+
 void AlbumCoverFetcher::AddRequest(const CoverSearchRequest& req) {
+  const QString key = RequestKey(req);
+
+  if (requests_by_key_.contains(key)) {
+    duplicate_requests_[requests_by_key_[key]] << req.id;
+    return;
+  }
+
+  // Only fetches use the miss cache - searching is something the user asked
+  // for explicitly.
+  if (!req.search && sMissCache.contains(key)) {
+    const qint64 age =
+        QDateTime::currentMSecsSinceEpoch() - sMissCache[key];
+    if (age < kMissCacheExpirySecs * qint64(1000)) {
+      cached_misses_.enqueue(req.id);
+      QTimer::singleShot(0, this, SLOT(EmitCachedMisses()));
+      return;
+    }
+    sMissCache.remove(key);
+  }
+
+  requests_by_key_[key] = req.id;
   queued_requests_.enqueue(req);
 
   if (!request_starter_->isActive()) request_starter_->start();
@@ -73,12 +117,19 @@ void AlbumCoverFetcher::AddRequest(const CoverSearchRequest& req) {
 
 void AlbumCoverFetcher::Clear() {
   queued_requests_.clear();
+  requests_by_key_.clear();
+  duplicate_requests_.clear();
+  cached_misses_.clear();
 
   for (AlbumCoverFetcherSearch* search : active_requests_.values()) {
     search->Cancel();
     search->deleteLater();
   }
   active_requests_.clear();
+
+  for (TokenBucket& bucket : token_buckets_) {
+    bucket.waiting_.clear();
+  }
 }
 
 void AlbumCoverFetcher::StartRequests() {
@@ -106,13 +157,125 @@ void AlbumCoverFetcher::StartRequests() {
   }
 }
 
+void AlbumCoverFetcher::QueueProviderSearch(AlbumCoverFetcherSearch* search,
+                                            CoverProvider* provider) {
+  if (!token_buckets_.contains(provider)) {
+    // Another provider could be created at the same address later.
+    connect(provider, SIGNAL(destroyed(QObject*)),
+            SLOT(ProviderDestroyed(QObject*)));
+
+    TokenBucket& bucket = token_buckets_[provider];
+    bucket.rate_ = provider->requests_per_second();
+    bucket.burst_ = qMax(1, provider->max_burst());
+    bucket.tokens_ = bucket.burst_;
+    bucket.last_refill_msec_ = clock_.elapsed();
+  }
+
+  token_buckets_[provider].waiting_.enqueue(search);
+
+  // The search may finish as soon as it's started, so never start it from
+  // inside the search's own Start().
+  if (!provider_starter_->isActive()) provider_starter_->start(0);
+}
+
+void AlbumCoverFetcher::ProviderDestroyed(QObject* provider) {
+  token_buckets_.remove(static_cast<CoverProvider*>(provider));
+}
+
+void AlbumCoverFetcher::StartProviderSearches() {
+  const qint64 now = clock_.elapsed();
+  qint64 next_msec = -1;
+
+  // Starting a search can finish another one and start more, which adds to
+  // token_buckets_, so don't hold iterators or references across it.
+  for (CoverProvider* provider : token_buckets_.keys()) {
+    forever {
+      TokenBucket& bucket = token_buckets_[provider];
+      bucket.tokens_ =
+          qMin(double(bucket.burst_),
+               bucket.tokens_ +
+                   (now - bucket.last_refill_msec_) * bucket.rate_ / 1000.0);
+      bucket.last_refill_msec_ = now;
+
+      // Skip searches that were cancelled or gave up while they waited.
+      while (!bucket.waiting_.isEmpty() &&
+             (!bucket.waiting_.head() ||
+              !bucket.waiting_.head()->IsWaitingFor(provider))) {
+        bucket.waiting_.dequeue();
+      }
+      if (bucket.waiting_.isEmpty()) break;
+
+      if (bucket.tokens_ < 1.0) {
+        if (bucket.rate_ > 0) {
+          const qint64 wait_msec =
+              std::ceil((1.0 - bucket.tokens_) * 1000.0 / bucket.rate_);
+          if (next_msec == -1 || wait_msec < next_msec) next_msec = wait_msec;
+        }
+        break;
+      }
+
+      bucket.tokens_ -= 1.0;
+      QPointer<AlbumCoverFetcherSearch> search = bucket.waiting_.dequeue();
+      search->StartProviderSearch(provider);
+    }
+  }
+
+  if (next_msec != -1) provider_starter_->start(next_msec);
+}
+
+CoverSearchStatistics AlbumCoverFetcher::DuplicateStatistics(
+    const CoverSearchStatistics& statistics) {
+  CoverSearchStatistics ret;
+  ret.chosen_images_by_provider_ = statistics.chosen_images_by_provider_;
+  ret.chosen_images_ = statistics.chosen_images_;
+  ret.missing_images_ = statistics.missing_images_;
+  ret.chosen_width_ = statistics.chosen_width_;
+  ret.chosen_height_ = statistics.chosen_height_;
+  ret.deduplicated_requests_ = 1;
+  ret.started_msec_ = statistics.started_msec_;
+  ret.finished_msec_ = statistics.finished_msec_;
+  return ret;
+}
+
+CoverSearchStatistics AlbumCoverFetcher::FinishSearch(
+    AlbumCoverFetcherSearch* search) {
+  requests_by_key_.remove(RequestKey(search->request()));
+  search->deleteLater();
+
+  // Make room for the next one straight away.
+  if (!queued_requests_.isEmpty()) {
+    QMetaObject::invokeMethod(this, "StartRequests", Qt::QueuedConnection);
+  }
+
+  CoverSearchStatistics statistics = search->statistics();
+  statistics.finished_msec_ = QDateTime::currentMSecsSinceEpoch();
+  return statistics;
+}
+
+void AlbumCoverFetcher::EmitCachedMisses() {
+  while (!cached_misses_.isEmpty()) {
+    CoverSearchStatistics statistics;
+    statistics.missing_images_ = 1;
+    statistics.cached_misses_ = 1;
+    statistics.started_msec_ = QDateTime::currentMSecsSinceEpoch();
+    statistics.finished_msec_ = statistics.started_msec_;
+
+    emit AlbumCoverFetched(cached_misses_.dequeue(), QImage(), statistics);
+  }
+}
+
 void AlbumCoverFetcher::SingleSearchFinished(quint64 request_id,
                                              CoverSearchResults results) {
   AlbumCoverFetcherSearch* search = active_requests_.take(request_id);
   if (!search) return;
 
-  search->deleteLater();
-  emit SearchFinished(request_id, results, search->statistics());
+  const CoverSearchStatistics statistics = FinishSearch(search);
+  const QList<quint64> duplicates = duplicate_requests_.take(request_id);
+
+  emit SearchFinished(request_id, results, statistics);
+  for (quint64 id : duplicates) {
+    emit SearchFinished(id, results, DuplicateStatistics(statistics));
+  }
 }
 
 void AlbumCoverFetcher::SingleCoverFetched(quint64 request_id,
@@ -120,6 +283,16 @@ void AlbumCoverFetcher::SingleCoverFetched(quint64 request_id,
   AlbumCoverFetcherSearch* search = active_requests_.take(request_id);
   if (!search) return;
 
-  search->deleteLater();
-  emit AlbumCoverFetched(request_id, image, search->statistics());
+  const CoverSearchStatistics statistics = FinishSearch(search);
+  const QList<quint64> duplicates = duplicate_requests_.take(request_id);
+
+  if (search->found_nothing()) {
+    sMissCache[RequestKey(search->request())] =
+        QDateTime::currentMSecsSinceEpoch();
+  }
+
+  emit AlbumCoverFetched(request_id, image, statistics);
+  for (quint64 id : duplicates) {
+    emit AlbumCoverFetched(id, image, DuplicateStatistics(statistics));
+  }
 }
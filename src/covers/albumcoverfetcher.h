@@ -23,19 +23,24 @@
 
 #include "coversearchstatistics.h"
 
+#include <QElapsedTimer>
 #include <QHash>
 #include <QImage>
 #include <QList>
+#include <QMap>
 #include <QMetaType>
 #include <QNetworkAccessManager>
 #include <QObject>
+#include <QPointer>
 #include <QQueue>
 #include <QUrl>
 
 class QNetworkReply;
 class QString;
+class QTimer;
 
 class AlbumCoverFetcherSearch;
+class CoverProvider;
 class CoverProviders;
 
 // This class represents a single search-for-cover request. It identifies
@@ -77,6 +82,12 @@ Q_DECLARE_METATYPE(QList<CoverSearchResult>);
 
 // This class searches for album covers for a given query or artist/album and
 // returns URLs. It's NOT thread-safe.
+//
+// Requests for an artist and album that is already being searched for share
+// that search's result, and a fetch that found nothing is remembered for a
+// while, so fetching all the missing covers again doesn't repeat it.  Each
+// search asks all the providers at once, but the fetcher only lets a search
+// start with a provider when that provider's token bucket allows it.
 class AlbumCoverFetcher : public QObject {
   Q_OBJECT
 
@@ -86,12 +97,18 @@ class AlbumCoverFetcher : public QObject {
   virtual ~AlbumCoverFetcher() {}
 
   static const int kMaxConcurrentRequests;
+  static const int kMissCacheExpirySecs;
 
   quint64 SearchForCovers(const QString& artist, const QString& album);
   quint64 FetchAlbumCover(const QString& artist, const QString& album);
 
   void Clear();
 
+  // Called by AlbumCoverFetcherSearch.  Starts the search with this provider
+  // once the provider's token bucket has a token for it.
+  void QueueProviderSearch(AlbumCoverFetcherSearch* search,
+                           CoverProvider* provider);
+
  signals:
   void AlbumCoverFetched(quint64, const QImage& cover,
                          const CoverSearchStatistics& statistics);
@@ -102,9 +119,33 @@ class AlbumCoverFetcher : public QObject {
   void SingleSearchFinished(quint64, CoverSearchResults results);
   void SingleCoverFetched(quint64, const QImage& cover);
   void StartRequests();
+  void StartProviderSearches();
+  void EmitCachedMisses();
+  void ProviderDestroyed(QObject* provider);
 
  private:
+  // Tokens are added at the provider's rate, up to its burst size, and each
+  // search started with the provider takes one.
+  struct TokenBucket {
+    TokenBucket() : rate_(0), burst_(0), tokens_(0), last_refill_msec_(0) {}
+
+    float rate_;
+    int burst_;
+    double tokens_;
+    qint64 last_refill_msec_;
+    QQueue<QPointer<AlbumCoverFetcherSearch>> waiting_;
+  };
+
+  // Requests with the same key get the same result.
+  static QString RequestKey(const CoverSearchRequest& req);
+  // The statistics for a request answered by another one's search: the same
+  // result, but none of the network traffic.
+  static CoverSearchStatistics DuplicateStatistics(
+      const CoverSearchStatistics& statistics);
+
   void AddRequest(const CoverSearchRequest& req);
+  // Stamps the search's statistics with the finish time and forgets it.
+  CoverSearchStatistics FinishSearch(AlbumCoverFetcherSearch* search);
 
   CoverProviders* cover_providers_;
   QNetworkAccessManager* network_;
@@ -113,7 +154,19 @@ class AlbumCoverFetcher : public QObject {
   QQueue<CoverSearchRequest> queued_requests_;
   QHash<quint64, AlbumCoverFetcherSearch*> active_requests_;
 
+  // Queued and active requests by key, and the requests waiting for each of
+  // them to finish.
+  QHash<QString, quint64> requests_by_key_;
+  QHash<quint64, QList<quint64>> duplicate_requests_;
+
+  // Requests answered by the miss cache, emitted from the event loop.
+  QQueue<quint64> cached_misses_;
+
+  QMap<CoverProvider*, TokenBucket> token_buckets_;
+  QElapsedTimer clock_;
+
   QTimer* request_starter_;
+  QTimer* provider_starter_;
 };
 
 #endif  // COVERS_ALBUMCOVERFETCHER_H_
@@ -22,6 +22,7 @@
 
 #include <cmath>
 
+#include <QDateTime>
 #include <QMutexLocker>
 #include <QNetworkReply>
 #include <QTimer>
@@ -41,19 +42,25 @@ const float AlbumCoverFetcherSearch::kGoodScore = 1.85;
 
 AlbumCoverFetcherSearch::AlbumCoverFetcherSearch(
     const CoverSearchRequest& request, QNetworkAccessManager* network,
-    QObject* parent)
-    : QObject(parent),
+    AlbumCoverFetcher* fetcher)
+    : QObject(fetcher),
       request_(request),
+      fetcher_(fetcher),
+      cover_providers_(nullptr),
       image_load_timeout_(new NetworkTimeouts(kImageLoadTimeoutMs, this)),
       network_(network),
-      cancel_requested_(false) {
-  // we will terminate the search after kSearchTimeoutMs miliseconds if we are
-  // not
-  // able to find all of the results before that point in time
-  QTimer::singleShot(kSearchTimeoutMs, this, SLOT(TerminateSearch()));
+      cancel_requested_(false),
+      incomplete_(false),
+      found_nothing_(false) {
+  statistics_.started_msec_ = QDateTime::currentMSecsSinceEpoch();
 }
 
 void AlbumCoverFetcherSearch::TerminateSearch() {
+  if (!waiting_providers_.isEmpty() || !pending_requests_.isEmpty()) {
+    incomplete_ = true;
+  }
+  waiting_providers_.clear();
+
   for (int id : pending_requests_.keys()) {
     pending_requests_.take(id)->CancelSearch(id);
   }
@@ -62,22 +69,45 @@ void AlbumCoverFetcherSearch::TerminateSearch() {
 }
 
 void AlbumCoverFetcherSearch::Start(CoverProviders* cover_providers) {
-  for (CoverProvider* provider : cover_providers->List()) {
-    connect(provider, SIGNAL(SearchFinished(int, QList<CoverSearchResult>)),
-            SLOT(ProviderSearchFinished(int, QList<CoverSearchResult>)));
-    const int id = cover_providers->NextId();
-    const bool success =
-        provider->StartSearch(request_.artist, request_.album, id);
-
-    if (success) {
-      pending_requests_[id] = provider;
-      statistics_.network_requests_made_++;
-    }
-  }
+  cover_providers_ = cover_providers;
+  waiting_providers_ = cover_providers->List();
 
   // end this search before it even began if there are no providers...
-  if (pending_requests_.isEmpty()) {
+  if (waiting_providers_.isEmpty()) {
     TerminateSearch();
+    return;
+  }
+
+  // we will terminate the search after kSearchTimeoutMs miliseconds if we are
+  // not able to find all of the results before that point in time.  This
+  // includes the time spent waiting for the providers' rate limits.
+  QTimer::singleShot(kSearchTimeoutMs, this, SLOT(TerminateSearch()));
+
+  for (CoverProvider* provider : waiting_providers_) {
+    fetcher_->QueueProviderSearch(this, provider);
+  }
+}
+
+void AlbumCoverFetcherSearch::StartProviderSearch(CoverProvider* provider) {
+  if (!waiting_providers_.removeOne(provider)) return;
+
+  connect(provider, SIGNAL(SearchFinished(int, QList<CoverSearchResult>)),
+          SLOT(ProviderSearchFinished(int, QList<CoverSearchResult>)),
+          Qt::UniqueConnection);
+  connect(provider, SIGNAL(SearchFailed(int)), SLOT(ProviderSearchFailed(int)),
+          Qt::UniqueConnection);
+  const int id = cover_providers_->NextId();
+  const bool success =
+      provider->StartSearch(request_.artist, request_.album, id);
+
+  if (success) {
+    pending_requests_[id] = provider;
+    statistics_.network_requests_made_++;
+  } else {
+    incomplete_ = true;
+    if (waiting_providers_.isEmpty() && pending_requests_.isEmpty()) {
+      AllProvidersFinished();
+    }
   }
 }
 
@@ -103,7 +133,20 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
   statistics_.total_images_by_provider_[provider->name()]++;
 
   // do we have more providers left?
-  if (!pending_requests_.isEmpty()) {
+  if (!pending_requests_.isEmpty() || !waiting_providers_.isEmpty()) {
+    return;
+  }
+
+  AllProvidersFinished();
+}
+
+void AlbumCoverFetcherSearch::ProviderSearchFailed(int id) {
+  if (!pending_requests_.contains(id)) return;
+
+  pending_requests_.remove(id);
+  incomplete_ = true;
+
+  if (!pending_requests_.isEmpty() || !waiting_providers_.isEmpty()) {
     return;
   }
 
@@ -115,6 +158,8 @@ void AlbumCoverFetcherSearch::AllProvidersFinished() {
     return;
   }
 
+  found_nothing_ = results_.isEmpty() && !incomplete_;
+
   // if we only wanted to do the search then we're done
   if (request_.search) {
     emit SearchFinished(request_.id, results_);
@@ -248,7 +293,7 @@ void AlbumCoverFetcherSearch::SendBestImage() {
 void AlbumCoverFetcherSearch::Cancel() {
   cancel_requested_ = true;
 
-  if (!pending_requests_.isEmpty()) {
+  if (!pending_requests_.isEmpty() || !waiting_providers_.isEmpty()) {
     TerminateSearch();
   } else if (!pending_image_loads_.isEmpty()) {
     for (RedirectFollower* reply : pending_image_loads_.keys()) {
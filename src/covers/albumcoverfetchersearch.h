@@ -35,21 +35,34 @@ class RedirectFollower;
 // This class encapsulates a single search for covers initiated by an
 // AlbumCoverFetcher. The search engages all of the known cover providers.
 // AlbumCoverFetcherSearch signals search results to an interested
-// AlbumCoverFetcher when all of the providers have done their part.
+// AlbumCoverFetcher when all of the providers have done their part.  Each
+// provider search waits for the fetcher's rate limit for that provider.
 class AlbumCoverFetcherSearch : public QObject {
   Q_OBJECT
 
  public:
   AlbumCoverFetcherSearch(const CoverSearchRequest& request,
-                          QNetworkAccessManager* network, QObject* parent);
+                          QNetworkAccessManager* network,
+                          AlbumCoverFetcher* fetcher);
 
   void Start(CoverProviders* cover_providers);
 
+  // Called by the AlbumCoverFetcher when the provider may be asked.
+  void StartProviderSearch(CoverProvider* provider);
+  bool IsWaitingFor(CoverProvider* provider) const {
+    return waiting_providers_.contains(provider);
+  }
+
   // Cancels all pending requests.  No Finished signals will be emitted, and it
   // is the caller's responsibility to delete the AlbumCoverFetcherSearch.
   void Cancel();
 
   CoverSearchStatistics statistics() const { return statistics_; }
+  const CoverSearchRequest& request() const { return request_; }
+
+  // True if every provider answered and none of them had anything.  Searches
+  // where a provider failed or timed out don't count.
+  bool found_nothing() const { return found_nothing_; }
 
  signals:
   // It's the end of search (when there was no fetch-me-a-cover request).
@@ -60,6 +73,7 @@ class AlbumCoverFetcherSearch : public QObject {
 
  private slots:
   void ProviderSearchFinished(int id, const QList<CoverSearchResult>& results);
+  void ProviderSearchFailed(int id);
   void ProviderCoverFetchFinished(RedirectFollower* reply);
   void TerminateSearch();
 
@@ -84,6 +98,11 @@ class AlbumCoverFetcherSearch : public QObject {
   // Complete results (from all of the available providers).
   CoverSearchResults results_;
 
+  AlbumCoverFetcher* fetcher_;
+  CoverProviders* cover_providers_;
+
+  // Providers that haven't been asked yet, and the ones that have.
+  QList<CoverProvider*> waiting_providers_;
   QMap<int, CoverProvider*> pending_requests_;
   QMap<RedirectFollower*, QString> pending_image_loads_;
   NetworkTimeouts* image_load_timeout_;
@@ -95,6 +114,9 @@ class AlbumCoverFetcherSearch : public QObject {
   QNetworkAccessManager* network_;
 
   bool cancel_requested_;
+  // Set if any provider didn't answer: it failed, or the search timed out.
+  bool incomplete_;
+  bool found_nothing_;
 };
 
 #endif  // COVERS_ALBUMCOVERFETCHERSEARCH_H_
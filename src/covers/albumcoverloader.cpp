@@ -21,14 +21,21 @@
 
 #include "albumcoverloader.h"
 
+#include <memory>
+
+#include <QBuffer>
 #include <QPainter>
 #include <QDir>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFileInfo>
 #include <QUrl>
+#include <QNetworkDiskCache>
 #include <QNetworkReply>
 
 #include "config.h"
 #include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/network.h"
 #include "core/tagreaderclient.h"
@@ -38,10 +45,27 @@
 
 AlbumCoverLoader::AlbumCoverLoader(QObject* parent)
     : QObject(parent),
-      stop_requested_(false),
+      stop_requested_(0),
+      active_decodes_(0),
+      caching_embedded_art_(false),
       next_id_(1),
       network_(new NetworkAccessManager(this)),
-      connected_spotify_(false) {}
+      thumbnail_cache_(new QNetworkDiskCache(this)),
+      connected_spotify_(false) {
+  thumbnail_cache_->setCacheDirectory(
+      Utilities::GetConfigPath(Utilities::Path_ThumbnailCache));
+  thumbnail_cache_->setMaximumCacheSize(kMaxThumbnailCacheSize);
+
+  // Reading embedded art is background work, so it never takes more than one
+  // tagreader request at a time.
+  embedded_art_pool_.setMaxThreadCount(1);
+}
+
+AlbumCoverLoader::~AlbumCoverLoader() {
+  Stop();
+  decode_pool_.waitForDone();
+  embedded_art_pool_.waitForDone();
+}
 
 QString AlbumCoverLoader::ImageCacheDir() {
   return Utilities::GetConfigPath(Utilities::Path_AlbumCovers);
@@ -49,6 +73,7 @@ QString AlbumCoverLoader::ImageCacheDir() {
 
 void AlbumCoverLoader::CancelTask(quint64 id) {
   QMutexLocker l(&mutex_);
+  running_tasks_.remove(id);
   for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end(); ++it) {
     if (it->id == id) {
       tasks_.erase(it);
@@ -59,6 +84,7 @@ void AlbumCoverLoader::CancelTask(quint64 id) {
 
 void AlbumCoverLoader::CancelTasks(const QSet<quint64>& ids) {
   QMutexLocker l(&mutex_);
+  running_tasks_.subtract(ids);
   for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end();) {
     if (ids.contains(it->id)) {
       it = tasks_.erase(it);
@@ -93,20 +119,53 @@ quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
 }
 
 void AlbumCoverLoader::ProcessTasks() {
-  while (!stop_requested_) {
-    // Get the next task
-    Task task;
-    {
-      QMutexLocker l(&mutex_);
-      if (tasks_.isEmpty()) return;
-      task = tasks_.dequeue();
-    }
+  QMutexLocker l(&mutex_);
 
+  // Only hand the pool as many tasks as it has threads, so the rest can still
+  // be cancelled and reordered.
+  while (!stop_requested_ && !tasks_.isEmpty() &&
+         active_decodes_ < decode_pool_.maxThreadCount()) {
+    // The most recent requests are usually for covers that have just scrolled
+    // into view, so they go first.
+    Task task = tasks_.takeLast();
+    running_tasks_.insert(task.id);
+    ++active_decodes_;
+
+    ConcurrentRun::Run<void>(
+        &decode_pool_, std::bind(&AlbumCoverLoader::DecodeTask, this, task));
+  }
+}
+
+void AlbumCoverLoader::DecodeTask(Task task) {
+  const bool stopped = stop_requested_;
+  if (!stopped) {
     ProcessTask(&task);
   }
+
+  {
+    QMutexLocker l(&mutex_);
+    --active_decodes_;
+    // It'll never finish now.
+    if (stopped) running_tasks_.remove(task.id);
+  }
+  metaObject()->invokeMethod(this, "ProcessTasks", Qt::QueuedConnection);
 }
 
 void AlbumCoverLoader::ProcessTask(Task* task) {
+  {
+    QMutexLocker l(&mutex_);
+    if (!running_tasks_.contains(task->id)) return;  // Cancelled
+  }
+
+  const QUrl thumbnail_key = ThumbnailCacheKey(*task);
+  if (!thumbnail_key.isEmpty()) {
+    const QImage thumbnail = LoadThumbnail(thumbnail_key);
+    if (!thumbnail.isNull()) {
+      EmitImageLoaded(task->id, thumbnail, thumbnail);
+      return;
+    }
+  }
+
   TryLoadResult result = TryLoadImage(*task);
   if (result.started_async) {
     // The image is being loaded from a remote URL, we'll carry on later
@@ -115,15 +174,211 @@ void AlbumCoverLoader::ProcessTask(Task* task) {
   }
 
   if (result.loaded_success) {
-    QImage scaled = ScaleAndPad(task->options, result.image);
-    emit ImageLoaded(task->id, scaled);
-    emit ImageLoaded(task->id, scaled, result.image);
+    ImageLoadedForTask(*task, result.image);
     return;
   }
 
   NextState(task);
 }
 
+void AlbumCoverLoader::ImageLoadedForTask(const Task& task,
+                                          const QImage& image) {
+  QImage scaled = ScaleAndPad(task.options, image);
+
+  const QUrl thumbnail_key = ThumbnailCacheKey(task);
+  if (!thumbnail_key.isEmpty()) {
+    SaveThumbnail(thumbnail_key, scaled);
+  }
+
+  EmitImageLoaded(task.id, scaled, image);
+}
+
+void AlbumCoverLoader::EmitImageLoaded(quint64 id, const QImage& scaled,
+                                       const QImage& original) {
+  {
+    QMutexLocker l(&mutex_);
+    if (!running_tasks_.remove(id)) return;  // Cancelled
+  }
+
+  emit ImageLoaded(id, scaled);
+  emit ImageLoaded(id, scaled, original);
+}
+
+bool AlbumCoverLoader::IsRemote(const QString& filename) {
+  const QString lower = filename.toLower();
+  return lower.startsWith("http://") || lower.startsWith("https://") ||
+         lower.startsWith("spotify://image/");
+}
+
+QUrl AlbumCoverLoader::ThumbnailCacheKey(const Task& task) {
+  if (!task.options.use_thumbnail_cache_ ||
+      !task.options.scale_output_image_ || !task.embedded_image.isNull()) {
+    return QUrl();
+  }
+
+  const QString filename =
+      task.state == State_TryingAuto ? task.art_automatic : task.art_manual;
+  if (filename.isEmpty() || filename == Song::kManuallyUnsetCover) {
+    return QUrl();
+  }
+
+  QString source;
+  if (IsRemote(filename)) {
+    source = filename;
+  } else {
+    source = LocalFileSource(
+        filename == Song::kEmbeddedCover ? task.song_filename : filename);
+    if (source.isEmpty()) return QUrl();
+  }
+
+  const QString key =
+      QString("%1\n%2\n%3")
+          .arg(source, QString::number(task.options.desired_height_),
+               QString::number(int(task.options.pad_output_image_)));
+  return QUrl(
+      "thumbnail:" +
+      QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1)
+          .toHex());
+}
+
+QString AlbumCoverLoader::LocalFileSource(const QString& filename) {
+  if (filename.isEmpty()) return QString();
+
+  const QFileInfo info(filename);
+  if (!info.exists()) return QString();
+  return QString("%1\n%2\n%3")
+      .arg(filename, QString::number(info.lastModified().toTime_t()),
+           QString::number(info.size()));
+}
+
+QImage AlbumCoverLoader::LoadThumbnail(const QUrl& key) {
+  QImage ret;
+  ret.loadFromData(ReadThumbnailCache(key), "PNG");
+  return ret;
+}
+
+void AlbumCoverLoader::SaveThumbnail(const QUrl& key, const QImage& image) {
+  if (image.isNull()) return;
+
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+  if (image.save(&buffer, "PNG")) {
+    WriteThumbnailCache(key, data);
+  }
+}
+
+QByteArray AlbumCoverLoader::ReadThumbnailCache(const QUrl& key) {
+  QMutexLocker l(&thumbnail_cache_mutex_);
+  std::unique_ptr<QIODevice> device(thumbnail_cache_->data(key));
+  return device ? device->readAll() : QByteArray();
+}
+
+void AlbumCoverLoader::WriteThumbnailCache(const QUrl& key,
+                                           const QByteArray& data) {
+  QMutexLocker l(&thumbnail_cache_mutex_);
+  QNetworkCacheMetaData metadata;
+  metadata.setUrl(key);
+
+  QIODevice* device = thumbnail_cache_->prepare(metadata);
+  if (!device) return;
+
+  if (device->write(data) == data.size()) {
+    thumbnail_cache_->insert(device);
+  } else {
+    thumbnail_cache_->remove(key);
+  }
+}
+
+QUrl AlbumCoverLoader::EmbeddedArtSongKey(const QString& song_filename) {
+  const QString source = LocalFileSource(song_filename);
+  if (source.isEmpty()) return QUrl();
+
+  return QUrl(
+      "embeddedsong:" +
+      QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Sha1)
+          .toHex());
+}
+
+QUrl AlbumCoverLoader::EmbeddedArtImageKey(const QByteArray& hash) {
+  return QUrl("embeddedart:" + hash);
+}
+
+QImage AlbumCoverLoader::LoadCachedEmbeddedArt(const QString& song_filename) {
+  QImage ret;
+
+  const QUrl song_key = EmbeddedArtSongKey(song_filename);
+  if (song_key.isEmpty()) return ret;
+
+  const QByteArray hash = ReadThumbnailCache(song_key);
+  if (!hash.isEmpty()) {
+    ret.loadFromData(ReadThumbnailCache(EmbeddedArtImageKey(hash)));
+  }
+  return ret;
+}
+
+void AlbumCoverLoader::CacheEmbeddedArt(const QStringList& filenames) {
+  QMutexLocker l(&mutex_);
+  embedded_art_queue_ << filenames;
+  if (caching_embedded_art_) return;
+
+  caching_embedded_art_ = true;
+  ConcurrentRun::Run<void>(
+      &embedded_art_pool_,
+      std::bind(&AlbumCoverLoader::CacheEmbeddedArtNow, this));
+}
+
+void AlbumCoverLoader::CacheEmbeddedArtNow() {
+  forever {
+    QString filename;
+    {
+      QMutexLocker l(&mutex_);
+      if (stop_requested_ || embedded_art_queue_.isEmpty()) {
+        caching_embedded_art_ = false;
+        return;
+      }
+      filename = embedded_art_queue_.takeFirst();
+    }
+
+    CacheEmbeddedArtForFile(filename);
+  }
+}
+
+void AlbumCoverLoader::CacheEmbeddedArtForFile(const QString& filename) {
+  const QUrl song_key = EmbeddedArtSongKey(filename);
+  if (song_key.isEmpty() || !ReadThumbnailCache(song_key).isEmpty()) return;
+
+  const QByteArray data =
+      TagReaderClient::Instance()->LoadEmbeddedArtDataBlocking(
+          filename, _WorkerPoolBase::Priority_Bulk);
+  if (data.isEmpty()) return;
+
+  // The tracks of an album usually all embed the same image, so it's only
+  // decoded and stored for the first of them.
+  const QByteArray hash =
+      QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+  const QUrl image_key = EmbeddedArtImageKey(hash);
+
+  if (ReadThumbnailCache(image_key).isEmpty()) {
+    QImage image;
+    if (!image.loadFromData(data)) return;
+
+    if (image.width() > kEmbeddedArtSize || image.height() > kEmbeddedArtSize) {
+      image = image.scaled(kEmbeddedArtSize, kEmbeddedArtSize,
+                           Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    QByteArray thumbnail;
+    QBuffer buffer(&thumbnail);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, image.hasAlphaChannel() ? "PNG" : "JPG")) return;
+
+    WriteThumbnailCache(image_key, thumbnail);
+  }
+
+  WriteThumbnailCache(song_key, hash);
+}
+
 void AlbumCoverLoader::NextState(Task* task) {
   if (task->state == State_TryingManual) {
     // Try the automatic one next
@@ -131,9 +386,8 @@ void AlbumCoverLoader::NextState(Task* task) {
     ProcessTask(task);
   } else {
     // Give up
-    emit ImageLoaded(task->id, task->options.default_output_image_);
-    emit ImageLoaded(task->id, task->options.default_output_image_,
-                     task->options.default_output_image_);
+    EmitImageLoaded(task->id, task->options.default_output_image_,
+                    task->options.default_output_image_);
   }
 }
 
@@ -158,6 +412,16 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(false, true, task.options.default_output_image_);
 
   if (filename == Song::kEmbeddedCover && !task.song_filename.isEmpty()) {
+    // The copy kept by CacheEmbeddedArt is big enough for most covers.
+    if (task.options.use_thumbnail_cache_ &&
+        task.options.scale_output_image_ &&
+        task.options.desired_height_ <= kEmbeddedArtSize) {
+      const QImage cached_image = LoadCachedEmbeddedArt(task.song_filename);
+      if (!cached_image.isNull()) {
+        return TryLoadResult(false, true, cached_image);
+      }
+    }
+
     const QImage taglib_image =
         TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
             task.song_filename);
@@ -167,6 +431,40 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
                            ScaleAndPad(task.options, taglib_image));
   }
 
+  if (IsRemote(filename)) {
+    // The network requests have to be made from the loader's own thread.
+    {
+      QMutexLocker l(&mutex_);
+      queued_remote_tasks_.enqueue(task);
+    }
+    metaObject()->invokeMethod(this, "StartRemoteTasks", Qt::QueuedConnection);
+    return TryLoadResult(true, false, QImage());
+  }
+
+  QImage image(filename);
+  return TryLoadResult(
+      false, !image.isNull(),
+      image.isNull() ? task.options.default_output_image_ : image);
+}
+
+void AlbumCoverLoader::StartRemoteTasks() {
+  forever {
+    Task task;
+    {
+      QMutexLocker l(&mutex_);
+      if (queued_remote_tasks_.isEmpty()) return;
+      task = queued_remote_tasks_.dequeue();
+      if (!running_tasks_.contains(task.id)) continue;  // Cancelled
+    }
+
+    StartRemoteTask(task);
+  }
+}
+
+void AlbumCoverLoader::StartRemoteTask(const Task& task) {
+  const QString filename =
+      task.state == State_TryingAuto ? task.art_automatic : task.art_manual;
+
   if (filename.toLower().startsWith("http://") ||
       filename.toLower().startsWith("https://")) {
     QUrl url(filename);
@@ -175,7 +473,6 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
                SLOT(RemoteFetchFinished(QNetworkReply*)), reply);
 
     remote_tasks_.insert(reply, task);
-    return TryLoadResult(true, false, QImage());
   } else if (filename.toLower().startsWith("spotify://image/")) {
     // HACK: we should add generic image URL handlers
     SpotifyService* spotify = InternetModel::Service<SpotifyService>();
@@ -195,13 +492,7 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     // Need to schedule this in the spotify service's thread
     QMetaObject::invokeMethod(spotify, "LoadImage", Qt::QueuedConnection,
                               Q_ARG(QString, id));
-    return TryLoadResult(true, false, QImage());
   }
-
-  QImage image(filename);
-  return TryLoadResult(
-      false, !image.isNull(),
-      image.isNull() ? task.options.default_output_image_ : image);
 }
 
 void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
@@ -209,9 +500,7 @@ void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
   if (!remote_spotify_tasks_.contains(id)) return;
 
   Task task = remote_spotify_tasks_.take(id);
-  QImage scaled = ScaleAndPad(task.options, image);
-  emit ImageLoaded(task.id, scaled);
-  emit ImageLoaded(task.id, scaled, image);
+  ImageLoadedForTask(task, image);
 }
 
 void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
@@ -224,6 +513,8 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
       reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
   if (redirect.isValid()) {
     if (++task.redirects > kMaxRedirects) {
+      QMutexLocker l(&mutex_);
+      running_tasks_.remove(task.id);
       return;  // Give up.
     }
     QNetworkRequest request = reply->request();
@@ -237,19 +528,25 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
   }
 
   if (reply->error() == QNetworkReply::NoError) {
-    // Try to load the image
-    QImage image;
-    if (image.load(reply, 0)) {
-      QImage scaled = ScaleAndPad(task.options, image);
-      emit ImageLoaded(task.id, scaled);
-      emit ImageLoaded(task.id, scaled, image);
-      return;
-    }
+    // Decode the image on the pool like any other.
+    ConcurrentRun::Run<void>(
+        &decode_pool_, std::bind(&AlbumCoverLoader::DecodeRemoteImage, this,
+                                 task, reply->readAll()));
+    return;
   }
 
   NextState(&task);
 }
 
+void AlbumCoverLoader::DecodeRemoteImage(Task task, const QByteArray& data) {
+  QImage image;
+  if (image.loadFromData(data)) {
+    ImageLoadedForTask(task, image);
+  } else {
+    NextState(&task);
+  }
+}
+
 QImage AlbumCoverLoader::ScaleAndPad(const AlbumCoverLoaderOptions& options,
                                      const QImage& image) {
   if (image.isNull()) return image;
@@ -24,13 +24,18 @@
 #include "albumcoverloaderoptions.h"
 #include "core/song.h"
 
+#include <QAtomicInt>
 #include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QQueue>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
 #include <QUrl>
 
 class NetworkAccessManager;
+class QNetworkDiskCache;
 class QNetworkReply;
 
 class AlbumCoverLoader : public QObject {
@@ -38,8 +43,9 @@ class AlbumCoverLoader : public QObject {
 
  public:
   explicit AlbumCoverLoader(QObject* parent = nullptr);
+  ~AlbumCoverLoader();
 
-  void Stop() { stop_requested_ = true; }
+  void Stop() { stop_requested_.fetchAndStoreOrdered(1); }
 
   static QString ImageCacheDir();
 
@@ -51,6 +57,7 @@ class AlbumCoverLoader : public QObject {
                                  const QString& song_filename = QString(),
                                  const QImage& embedded_image = QImage());
 
+  // Cancelled tasks don't emit ImageLoaded, even if they have already started.
   void CancelTask(quint64 id);
   void CancelTasks(const QSet<quint64>& ids);
 
@@ -59,12 +66,19 @@ class AlbumCoverLoader : public QObject {
   static QImage ScaleAndPad(const AlbumCoverLoaderOptions& options,
                             const QImage& image);
 
+ public slots:
+  // Keeps small copies of the art embedded in these songs in the thumbnail
+  // cache, so later requests for it don't need the tagreader.  The files are
+  // read in the background, one at a time.
+  void CacheEmbeddedArt(const QStringList& filenames);
+
  signals:
   void ImageLoaded(quint64 id, const QImage& image);
   void ImageLoaded(quint64 id, const QImage& scaled, const QImage& original);
 
  protected slots:
   void ProcessTasks();
+  void StartRemoteTasks();
   void RemoteFetchFinished(QNetworkReply* reply);
   void SpotifyImageLoaded(const QString& url, const QImage& image);
 
@@ -94,23 +108,83 @@ class AlbumCoverLoader : public QObject {
     QImage image;
   };
 
+  // These run on decode_pool_.
+  void DecodeTask(Task task);
+  void DecodeRemoteImage(Task task, const QByteArray& data);
+
   void ProcessTask(Task* task);
   void NextState(Task* task);
   TryLoadResult TryLoadImage(const Task& task);
-
-  bool stop_requested_;
-
+  void StartRemoteTask(const Task& task);
+
+  // Emits both ImageLoaded signals, unless the task was cancelled.
+  void EmitImageLoaded(quint64 id, const QImage& scaled,
+                       const QImage& original);
+  static bool IsRemote(const QString& filename);
+
+  // Scales the image the task loaded, adds it to the thumbnail cache and
+  // emits it.
+  void ImageLoadedForTask(const Task& task, const QImage& image);
+
+  // Returns the key of the thumbnail for the image the task is trying to load
+  // in its current state, or an empty QUrl if it shouldn't be cached.  Local
+  // files are keyed by their path, modification time and size, and remote
+  // images by their URL.
+  static QUrl ThumbnailCacheKey(const Task& task);
+  // Identifies a local file by its path, modification time and size.  Returns
+  // an empty string if the file doesn't exist.
+  static QString LocalFileSource(const QString& filename);
+  QImage LoadThumbnail(const QUrl& key);
+  void SaveThumbnail(const QUrl& key, const QImage& image);
+  QByteArray ReadThumbnailCache(const QUrl& key);
+  void WriteThumbnailCache(const QUrl& key, const QByteArray& data);
+
+  // Embedded art is stored once per image, keyed by a hash of the image data,
+  // and each song file maps to the hash of its art.  Both live in the
+  // thumbnail cache.
+  static QUrl EmbeddedArtSongKey(const QString& song_filename);
+  static QUrl EmbeddedArtImageKey(const QByteArray& hash);
+  // Returns the cached copy of the art embedded in the song, or a null image.
+  QImage LoadCachedEmbeddedArt(const QString& song_filename);
+  // These run on embedded_art_pool_.
+  void CacheEmbeddedArtNow();
+  void CacheEmbeddedArtForFile(const QString& filename);
+
+  // Set by Stop() from any thread and read by the pools' threads.
+  QAtomicInt stop_requested_;
+
+  // Protects tasks_, running_tasks_, queued_remote_tasks_, active_decodes_,
+  // embedded_art_queue_ and caching_embedded_art_.
   QMutex mutex_;
   QQueue<Task> tasks_;
+  // Tasks that have been taken from tasks_ and not finished or cancelled.
+  QSet<quint64> running_tasks_;
+  // Tasks waiting for the loader's thread to start fetching a remote image.
+  QQueue<Task> queued_remote_tasks_;
+  int active_decodes_;
+  QStringList embedded_art_queue_;
+  bool caching_embedded_art_;
   QMap<QNetworkReply*, Task> remote_tasks_;
   QMap<QString, Task> remote_spotify_tasks_;
   quint64 next_id_;
 
   NetworkAccessManager* network_;
+  QMutex thumbnail_cache_mutex_;
+  QNetworkDiskCache* thumbnail_cache_;
 
   bool connected_spotify_;
 
   static const int kMaxRedirects = 3;
+  static const qint64 kMaxThumbnailCacheSize = 100 * 1024 * 1024;
+  // Cached embedded art is scaled down to fit in a square this big, so it's
+  // only used for covers up to this size.
+  static const int kEmbeddedArtSize = 300;
+
+  // Decodes and scales images, and reads embedded art for the cache.  Declared
+  // last so they are destroyed, and their threads stopped, before anything
+  // they use.
+  QThreadPool decode_pool_;
+  QThreadPool embedded_art_pool_;
 };
 
 #endif  // COVERS_ALBUMCOVERLOADER_H_
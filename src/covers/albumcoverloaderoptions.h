@@ -26,11 +26,16 @@ struct AlbumCoverLoaderOptions {
   AlbumCoverLoaderOptions()
       : desired_height_(120),
         scale_output_image_(true),
-        pad_output_image_(true) {}
+        pad_output_image_(true),
+        use_thumbnail_cache_(true) {}
 
   int desired_height_;
   bool scale_output_image_;
   bool pad_output_image_;
+  // Scaled images are kept in AlbumCoverLoader's thumbnail cache.  When one is
+  // loaded from there, the "original" image it emits is the thumbnail too, so
+  // turn this off if you need the full size image.
+  bool use_thumbnail_cache_;
   QImage default_output_image_;
 };
 
@@ -98,6 +98,12 @@ bool AmazonCoverProvider::StartSearch(const QString& artist,
 void AmazonCoverProvider::QueryFinished(QNetworkReply* reply, int id) {
   reply->deleteLater();
 
+  if (reply->error() != QNetworkReply::NoError) {
+    qLog(Info) << "Amazon cover search failed:" << reply->errorString();
+    emit SearchFailed(id);
+    return;
+  }
+
   CoverSearchResults results;
 
   QXmlStreamReader reader(reply);
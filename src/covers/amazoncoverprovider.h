@@ -38,6 +38,9 @@ class AmazonCoverProvider : public CoverProvider {
   static const char* kAssociateTag;
 
   bool StartSearch(const QString& artist, const QString& album, int id);
+  // The Product Advertising API allows one request a second.
+  float requests_per_second() const { return 1.0; }
+  int max_burst() const { return 1; }
 
  private slots:
   void QueryFinished(QNetworkReply* reply, int id);
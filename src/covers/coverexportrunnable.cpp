@@ -19,7 +19,14 @@
 
 #include "coverexportrunnable.h"
 
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QThread>
 #include <QUrl>
 
 #include "albumcoverexporter.h"
@@ -27,8 +34,11 @@
 #include "core/tagreaderclient.h"
 
 CoverExportRunnable::CoverExportRunnable(
-    const AlbumCoverExport::DialogResult& dialog_result, const Song& song)
-    : dialog_result_(dialog_result), song_(song) {}
+    const AlbumCoverExport::DialogResult& dialog_result, const Song& song,
+    AlbumCoverExporter* album_cover_exporter)
+    : dialog_result_(dialog_result),
+      song_(song),
+      album_cover_exporter_(album_cover_exporter) {}
 
 void CoverExportRunnable::run() {
   QString cover_path = GetCoverPath();
@@ -37,11 +47,7 @@ void CoverExportRunnable::run() {
   if (cover_path.isEmpty()) {
     EmitCoverSkipped();
   } else {
-    if (dialog_result_.RequiresCoverProcessing()) {
-      ProcessAndExportCover();
-    } else {
-      ExportCover();
-    }
+    ExportCover(cover_path);
   }
 }
 
@@ -62,133 +68,142 @@ QString CoverExportRunnable::GetCoverPath() {
   }
 }
 
-// Exports a single album cover using a "save QImage to file" approach.
-// For performance reasons this method will be invoked only if loading
-// and in memory processing of images is necessary for current settings
-// which means that:
-// - either the force size flag is being used
-// - or the "overwrite smaller" mode is used
-// In all other cases, the faster ExportCover() method will be used.
-void CoverExportRunnable::ProcessAndExportCover() {
-  QString cover_path = GetCoverPath();
+QByteArray CoverExportRunnable::FormatForExtension(const QString& extension) {
+  const QByteArray format = extension.toLower().toAscii();
+  return format == "jpg" ? "jpeg" : format;
+}
 
-  // either embedded or disk - the one we'll export for the current album
-  QImage cover;
+// Exports a single album cover.  The cover's bytes are written out unchanged
+// whenever they're already in the format the target file needs.  The image is
+// only decoded when it has to be resized or converted, and even then only
+// once for each distinct image - other albums with the same art copy the
+// first album's exported file.  Targets that are already up to date aren't
+// written again.
+void CoverExportRunnable::ExportCover(const QString& cover_path) {
+  const bool embedded = cover_path == Song::kEmbeddedCover;
 
-  QImage embedded_cover;
-  QImage disk_cover;
+  QString dir = song_.url().toLocalFile().section('/', 0, -2);
+  QString extension = embedded ? "jpg" : cover_path.section('.', -1);
+  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' + extension;
 
-  // load embedded cover if any
-  if (song_.has_embedded_cover()) {
-    embedded_cover = TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
-        song_.url().toLocalFile());
+  const QFileInfo target(new_file);
 
-    if (embedded_cover.isNull()) {
-      EmitCoverSkipped();
-      return;
-    }
-    cover = embedded_cover;
+  // If the file exists, do not override!
+  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None &&
+      target.exists()) {
+    EmitCoverSkipped();
+    return;
   }
 
-  // load a file cover which iss mandatory if there's no embedded cover
-  disk_cover.load(cover_path);
+  // An embedded cover changes whenever its song file does.
+  const QFileInfo source(embedded ? song_.url().toLocalFile() : cover_path);
+  const bool target_is_newer =
+      target.exists() && target.lastModified() >= source.lastModified();
 
-  if (embedded_cover.isNull()) {
-    if (disk_cover.isNull()) {
-      EmitCoverSkipped();
-      return;
-    }
-    cover = disk_cover;
+  // A plain copy that's already been made can be skipped without reading
+  // anything.
+  if (!embedded && !dialog_result_.RequiresCoverProcessing() &&
+      target_is_newer && target.size() == source.size()) {
+    EmitCoverSkipped();
+    return;
   }
 
-  // rescale if necessary
-  if (dialog_result_.IsSizeForced()) {
-    cover = cover.scaled(QSize(dialog_result_.width_, dialog_result_.height_),
-                         Qt::IgnoreAspectRatio);
+  QByteArray data;
+  if (embedded) {
+    data = TagReaderClient::Instance()->LoadEmbeddedArtDataBlocking(
+        song_.url().toLocalFile());
+  } else {
+    QFile file(cover_path);
+    if (file.open(QIODevice::ReadOnly)) data = file.readAll();
+  }
+  if (data.isEmpty()) {
+    EmitCoverSkipped();
+    return;
   }
 
-  QString dir = song_.url().toLocalFile().section('/', 0, -2);
-  QString extension = cover_path.section('.', -1);
-
-  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' +
-                     (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
-
-  // If the file exists, do not override!
-  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None && QFile::exists(new_file)) {
+  // Reads just the image's header.
+  QBuffer buffer(&data);
+  QImageReader reader(&buffer);
+  const QByteArray source_format = reader.format();
+  QSize size = reader.size();
+  if (source_format.isEmpty() || !size.isValid()) {
     EmitCoverSkipped();
     return;
   }
 
-  // we're handling overwrite as remove + copy so we need to delete the old file
-  // first
-  if (QFile::exists(new_file) && dialog_result_.overwrite_ != AlbumCoverExport::OverwriteMode_None) {
-    // if the mode is "overwrite smaller" then skip the cover if a bigger one
-    // is already available in the folder
-    if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_Smaller) {
-      QImage existing;
-      existing.load(new_file);
-
-      if (existing.isNull() || existing.size().height() >= cover.size().height() ||
-          existing.size().width() >= cover.size().width()) {
-        EmitCoverSkipped();
-        return;
-      }
-    }
+  if (dialog_result_.IsSizeForced()) {
+    size = QSize(dialog_result_.width_, dialog_result_.height_);
+  }
 
-    if (!QFile::remove(new_file)) {
+  // if the mode is "overwrite smaller" then skip the cover if a bigger one
+  // is already available in the folder
+  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_Smaller &&
+      target.exists()) {
+    const QSize existing = QImageReader(new_file).size();
+    if (!existing.isValid() || existing.height() >= size.height() ||
+        existing.width() >= size.width()) {
       EmitCoverSkipped();
       return;
     }
   }
 
-  if (cover.save(new_file)) {
-    EmitCoverExported();
+  const QByteArray target_format = FormatForExtension(extension);
+  QByteArray output;
+  QByteArray key;
+
+  if (!dialog_result_.IsSizeForced() && source_format == target_format) {
+    output = data;
   } else {
-    EmitCoverSkipped();
-  }
-}
+    // Every image with these bytes is exported the same way.
+    key = QCryptographicHash::hash(data, QCryptographicHash::Sha1) + '.' +
+          target_format;
 
-// Exports a single album cover using a "copy file" approach.
-void CoverExportRunnable::ExportCover() {
-  QString cover_path = GetCoverPath();
+    output = album_cover_exporter_->ExportedData(key);
 
-  QString dir = song_.url().toLocalFile().section('/', 0, -2);
-  QString extension = cover_path.section('.', -1);
+    if (output.isEmpty()) {
+      QImage cover;
+      if (!cover.loadFromData(data)) {
+        EmitCoverSkipped();
+        return;
+      }
 
-  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' +
-                     (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
+      // rescale if necessary
+      if (dialog_result_.IsSizeForced()) {
+        cover = cover.scaled(size, Qt::IgnoreAspectRatio);
+      }
 
-  // If the file exists, do not override!
-  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None &&
-      QFile::exists(new_file)) {
+      QBuffer output_buffer(&output);
+      output_buffer.open(QIODevice::WriteOnly);
+      if (!cover.save(&output_buffer, target_format.constData())) {
+        EmitCoverSkipped();
+        return;
+      }
+    }
+  }
+
+  // Don't rewrite a target that's already got these contents.
+  if (target_is_newer && target.size() == output.size()) {
+    if (!key.isEmpty()) album_cover_exporter_->FileExported(key, new_file);
     EmitCoverSkipped();
     return;
   }
 
-  // we're handling overwrite as remove + copy so we need to delete the old file
-  // first
-  if (dialog_result_.overwrite_ != AlbumCoverExport::OverwriteMode_None &&
-      QFile::exists(new_file)) {
-    if (!QFile::remove(new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
+  // Write to a temporary file first so the target is never seen half written,
+  // either by other runnables copying it or by anything else.
+  const QString temp_file = QString("%1.%2.tmp").arg(new_file).arg(
+      reinterpret_cast<quintptr>(QThread::currentThread()), 0, 16);
+  QFile file(temp_file);
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(output) != output.size()) {
+    file.remove();
+    EmitCoverSkipped();
+    return;
   }
+  file.close();
 
-  if (cover_path == Song::kEmbeddedCover) {
-    // an embedded cover
-    QImage embedded = TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
-        song_.url().toLocalFile());
-    if (!embedded.save(new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
-  } else {
-    // automatic or manual cover, available in an image file
-    if (!QFile::copy(cover_path, new_file)) {
-      EmitCoverSkipped();
-      return;
-    }
+  if (!album_cover_exporter_->ReplaceExportedFile(key, temp_file, new_file)) {
+    EmitCoverSkipped();
+    return;
   }
   EmitCoverExported();
 }
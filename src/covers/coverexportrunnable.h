@@ -33,7 +33,8 @@ class CoverExportRunnable : public QObject, public QRunnable {
 
  public:
   CoverExportRunnable(const AlbumCoverExport::DialogResult& dialog_result,
-                      const Song& song);
+                      const Song& song,
+                      AlbumCoverExporter* album_cover_exporter);
   virtual ~CoverExportRunnable() {}
 
   void run();
@@ -46,10 +47,12 @@ class CoverExportRunnable : public QObject, public QRunnable {
   void EmitCoverExported();
   void EmitCoverSkipped();
 
-  void ProcessAndExportCover();
-  void ExportCover();
+  void ExportCover(const QString& cover_path);
   QString GetCoverPath();
 
+  // The QImageWriter format for a file extension.
+  static QByteArray FormatForExtension(const QString& extension);
+
   AlbumCoverExport::DialogResult dialog_result_;
   Song song_;
   AlbumCoverExporter* album_cover_exporter_;
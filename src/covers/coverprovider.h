@@ -48,8 +48,19 @@ class CoverProvider : public QObject {
 
   virtual void CancelSearch(int id) {}
 
+  // Limits on how often AlbumCoverFetcher starts searches with this provider,
+  // so fetching a whole library's covers stays within what the service
+  // allows.  Up to max_burst() searches can start at once, and after that they
+  // are spaced out to requests_per_second().
+  virtual float requests_per_second() const { return 5.0; }
+  virtual int max_burst() const { return 5; }
+
  signals:
   void SearchFinished(int id, const QList<CoverSearchResult>& results);
+  // Emitted instead of SearchFinished when the service couldn't be asked, for
+  // example because of a network error, so that isn't mistaken for the
+  // service not having a cover.
+  void SearchFailed(int id);
 
  private:
   QString name_;
@@ -25,7 +25,11 @@ CoverSearchStatistics::CoverSearchStatistics()
       chosen_images_(0),
       missing_images_(0),
       chosen_width_(0),
-      chosen_height_(0) {}
+      chosen_height_(0),
+      deduplicated_requests_(0),
+      cached_misses_(0),
+      started_msec_(0),
+      finished_msec_(0) {}
 
 CoverSearchStatistics& CoverSearchStatistics::operator+=(
     const CoverSearchStatistics& other) {
@@ -45,6 +49,15 @@ CoverSearchStatistics& CoverSearchStatistics::operator+=(
   chosen_width_ += other.chosen_width_;
   chosen_height_ += other.chosen_height_;
 
+  deduplicated_requests_ += other.deduplicated_requests_;
+  cached_misses_ += other.cached_misses_;
+
+  if (other.started_msec_ &&
+      (!started_msec_ || other.started_msec_ < started_msec_)) {
+    started_msec_ = other.started_msec_;
+  }
+  finished_msec_ = qMax(finished_msec_, other.finished_msec_);
+
   return *this;
 }
 
@@ -56,3 +69,12 @@ QString CoverSearchStatistics::AverageDimensions() const {
   return QString::number(chosen_width_ / chosen_images_) + "x" +
          QString::number(chosen_height_ / chosen_images_);
 }
+
+double CoverSearchStatistics::Throughput() const {
+  if (finished_msec_ <= started_msec_) {
+    return 0.0;
+  }
+
+  return (chosen_images_ + missing_images_) * 1000.0 /
+         (finished_msec_ - started_msec_);
+}
@@ -21,6 +21,7 @@
 #define COVERS_COVERSEARCHSTATISTICS_H_
 
 #include <QMap>
+#include <QMetaType>
 #include <QString>
 
 struct CoverSearchStatistics {
@@ -39,7 +40,20 @@ struct CoverSearchStatistics {
   quint64 chosen_width_;
   quint64 chosen_height_;
 
+  // Requests that were answered without searching: by an identical search
+  // that was already running, or because an earlier search found nothing.
+  quint64 deduplicated_requests_;
+  quint64 cached_misses_;
+
+  // When the first search started and the last one finished, in msecs since
+  // the epoch.
+  qint64 started_msec_;
+  qint64 finished_msec_;
+
   QString AverageDimensions() const;
+  // Albums searched for per second between started_msec_ and finished_msec_.
+  double Throughput() const;
 };
+Q_DECLARE_METATYPE(CoverSearchStatistics);
 
 #endif  // COVERS_COVERSEARCHSTATISTICS_H_
@@ -66,6 +66,11 @@ void CoverSearchStatisticsDialog::Show(
 
   AddLine(tr("Total network requests made"),
           QString::number(statistics.network_requests_made_));
+  AddLine(tr("Albums that didn't need a search"),
+          QString::number(statistics.deduplicated_requests_ +
+                          statistics.cached_misses_));
+  AddLine(tr("Albums per second"),
+          QString::number(statistics.Throughput(), 'f', 1));
   AddLine(tr("Average image size"), statistics.AverageDimensions());
   AddLine(tr("Total bytes transferred"),
           statistics.bytes_transferred_
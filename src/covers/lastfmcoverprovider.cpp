@@ -26,6 +26,7 @@
 #include "albumcoverfetcher.h"
 #include "coverprovider.h"
 #include "core/closure.h"
+#include "core/logging.h"
 #include "internet/lastfm/lastfmcompat.h"
 
 LastFmCoverProvider::LastFmCoverProvider(QObject* parent)
@@ -50,7 +51,11 @@ void LastFmCoverProvider::QueryFinished(QNetworkReply* reply, int id) {
   CoverSearchResults results;
 
   lastfm::XmlQuery query(lastfm::compat::EmptyXmlQuery());
-  if (lastfm::compat::ParseQuery(reply->readAll(), &query)) {
+  if (reply->error() != QNetworkReply::NoError) {
+    qLog(Info) << "last.fm cover search failed:" << reply->errorString();
+    emit SearchFailed(id);
+    return;
+  } else if (lastfm::compat::ParseQuery(reply->readAll(), &query)) {
     // parse the list of search results
     QList<lastfm::XmlQuery> elements =
         query["results"]["albummatches"].children("album");
@@ -63,7 +68,9 @@ void LastFmCoverProvider::QueryFinished(QNetworkReply* reply, int id) {
       results << result;
     }
   } else {
-    // Drop through and emit an empty list of results.
+    // last.fm reports its own errors in the response.
+    emit SearchFailed(id);
+    return;
   }
 
   emit SearchFinished(id, results);
@@ -24,6 +24,7 @@
 #include <QXmlStreamReader>
 
 #include "core/closure.h"
+#include "core/logging.h"
 #include "core/network.h"
 
 using std::mem_fun;
@@ -62,6 +63,13 @@ void MusicbrainzCoverProvider::ReleaseSearchFinished(QNetworkReply* reply,
                                                      int id) {
   reply->deleteLater();
 
+  if (reply->error() != QNetworkReply::NoError) {
+    qLog(Info) << "MusicBrainz cover search failed:" << reply->errorString();
+    cover_names_.remove(id);
+    emit SearchFailed(id);
+    return;
+  }
+
   QList<QString> releases;
 
   QXmlStreamReader reader(reply);
@@ -75,6 +83,12 @@ void MusicbrainzCoverProvider::ReleaseSearchFinished(QNetworkReply* reply,
     }
   }
 
+  if (releases.isEmpty()) {
+    cover_names_.remove(id);
+    emit SearchFinished(id, QList<CoverSearchResult>());
+    return;
+  }
+
   for (const QString& release_id : releases) {
     QUrl url(QString(kAlbumCoverUrl).arg(release_id));
     QNetworkReply* reply = network_->head(QNetworkRequest(url));
@@ -91,18 +105,28 @@ void MusicbrainzCoverProvider::ImageCheckFinished(int id) {
   if (finished_count == replies.size()) {
     QString cover_name = cover_names_.take(id);
     QList<CoverSearchResult> results;
+    bool failed = false;
     for (QNetworkReply* reply : replies) {
       reply->deleteLater();
-      if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() <
-          400) {
+      if (reply->error() == QNetworkReply::NoError &&
+          reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() <
+              400) {
         CoverSearchResult result;
         result.description = cover_name;
         result.image_url = reply->url();
         results.append(result);
+      } else if (reply->error() != QNetworkReply::ContentNotFoundError) {
+        failed = true;
       }
     }
     image_checks_.remove(id);
-    emit SearchFinished(id, results);
+
+    // A release without a cover is a 404.  Anything else means we don't know.
+    if (results.isEmpty() && failed) {
+      emit SearchFailed(id);
+    } else {
+      emit SearchFinished(id, results);
+    }
   }
 }
 
@@ -34,6 +34,9 @@ class MusicbrainzCoverProvider : public CoverProvider {
   // CoverProvider
   virtual bool StartSearch(const QString& artist, const QString& album, int id);
   virtual void CancelSearch(int id);
+  // MusicBrainz allows one request a second.
+  virtual float requests_per_second() const { return 1.0; }
+  virtual int max_burst() const { return 1; }
 
  private slots:
   void ReleaseSearchFinished(QNetworkReply* reply, int id);
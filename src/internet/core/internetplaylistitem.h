@@ -39,6 +39,7 @@ class InternetPlaylistItem : public PlaylistItem {
   QList<QAction*> actions();
 
   bool InitFromQuery(const SqlRow& query);
+  void ShareStrings(StringPool* pool) { metadata_.ShareStrings(pool); }
 
   Song Metadata() const;
   QUrl Url() const;
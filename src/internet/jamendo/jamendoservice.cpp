@@ -284,7 +284,7 @@ void JamendoService::ParseDirectory(QIODevice* device) const {
 }
 
 void JamendoService::InsertTrackIds(const TrackIdList& ids) const {
-  QMutexLocker l(library_backend_->db()->Mutex());
+  Database::WriteLocker l(library_backend_->db());
   QSqlDatabase db(library_backend_->db()->Connect());
 
   ScopedTransaction t(&db);
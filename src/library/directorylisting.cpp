@@ -0,0 +1,203 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "directorylisting.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "core/logging.h"
+
+namespace {
+
+#ifdef Q_OS_UNIX
+void FillFromStat(const struct stat& st, DirectoryListing::Entry* entry) {
+  entry->exists_ = true;
+  entry->is_dir_ = S_ISDIR(st.st_mode);
+  entry->mtime_ = st.st_mtime;
+  entry->size_ = st.st_size;
+}
+#endif
+
+#ifdef Q_OS_LINUX
+// glibc only gained a getdents64() wrapper in 2.30.
+struct LinuxDirent64 {
+  quint64 d_ino;
+  qint64 d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+#endif
+
+}  // namespace
+
+DirectoryListing::Entry::Entry()
+    : exists_(false), is_dir_(false), is_symlink_(false), mtime_(0), size_(0) {}
+
+DirectoryListing::DirectoryListing(const QString& path)
+    : path_(path), prefix_(path.endsWith('/') ? path : path + "/") {
+#ifdef Q_OS_LINUX
+  ListPosix();
+#else
+  ListQt();
+#endif
+
+  for (int i = 0; i < entries_.count(); ++i) {
+    entries_by_name_[entries_[i].name_] = i;
+  }
+}
+
+bool DirectoryListing::Covers(const QString& path) const {
+  return path.length() > prefix_.length() && path.startsWith(prefix_) &&
+         path.indexOf('/', prefix_.length()) == -1;
+}
+
+const DirectoryListing::Entry* DirectoryListing::Find(
+    const QString& path) const {
+  if (!Covers(path)) return nullptr;
+
+  QHash<QString, int>::const_iterator it =
+      entries_by_name_.constFind(path.mid(prefix_.length()));
+  if (it == entries_by_name_.constEnd()) return nullptr;
+  return &entries_[it.value()];
+}
+
+DirectoryListing::Entry DirectoryListing::Stat(const QString& path) {
+  Entry ret;
+  ret.path_ = path;
+  ret.name_ = path.mid(path.lastIndexOf('/') + 1);
+
+#ifdef Q_OS_UNIX
+  const QByteArray encoded = QFile::encodeName(path);
+  struct stat st;
+  if (lstat(encoded.constData(), &st) != 0) return ret;
+
+  if (S_ISLNK(st.st_mode)) {
+    ret.is_symlink_ = true;
+    if (stat(encoded.constData(), &st) != 0) return ret;
+  }
+  FillFromStat(st, &ret);
+#else
+  QFileInfo info(path);
+  ret.exists_ = info.exists();
+  ret.is_dir_ = info.isDir();
+  ret.is_symlink_ = info.isSymLink();
+  ret.mtime_ = info.lastModified().toTime_t();
+  ret.size_ = info.size();
+#endif
+
+  return ret;
+}
+
+void DirectoryListing::ListPosix() {
+#ifdef Q_OS_LINUX
+  const int fd = open(QFile::encodeName(path_).constData(),
+                      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return;
+
+  // Aligned for the dirent structs inside it.
+  quint64 buffer[4096];
+
+  forever {
+    const long bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (bytes <= 0) {
+      if (bytes < 0) qLog(Warning) << "Error listing" << path_;
+      break;
+    }
+
+    const char* data = reinterpret_cast<const char*>(buffer);
+    for (long offset = 0; offset < bytes;) {
+      const LinuxDirent64* dirent =
+          reinterpret_cast<const LinuxDirent64*>(data + offset);
+      offset += dirent->d_reclen;
+
+      const char* name = dirent->d_name;
+      if (name[0] == '.' &&
+          (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+
+      Entry entry;
+      entry.name_ = QFile::decodeName(name);
+      entry.path_ = prefix_ + entry.name_;
+
+      if (dirent->d_type == DT_DIR && entry.is_hidden()) {
+        // Hidden directories are never scanned, so don't stat them.
+        entry.exists_ = true;
+        entry.is_dir_ = true;
+        entries_ << entry;
+        continue;
+      }
+
+      struct stat st;
+      if (dirent->d_type == DT_UNKNOWN) {
+        // Some filesystems don't fill in d_type, so ask without following
+        // links first.
+        if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (S_ISLNK(st.st_mode)) {
+          entry.is_symlink_ = true;
+          if (fstatat(fd, name, &st, 0) != 0) continue;
+        }
+      } else {
+        entry.is_symlink_ = dirent->d_type == DT_LNK;
+        // Dangling symlinks are skipped, like QDirIterator does.
+        if (fstatat(fd, name, &st, 0) != 0) continue;
+      }
+
+      FillFromStat(st, &entry);
+      entries_ << entry;
+    }
+  }
+
+  close(fd);
+#endif
+}
+
+void DirectoryListing::ListQt() {
+  QDirIterator it(path_, QDir::Dirs | QDir::Files | QDir::Hidden |
+                             QDir::NoDotAndDotDot);
+  while (it.hasNext()) {
+    it.next();
+    const QFileInfo info = it.fileInfo();
+
+    Entry entry;
+    entry.name_ = info.fileName();
+    entry.path_ = prefix_ + entry.name_;
+    entry.exists_ = true;
+    entry.is_dir_ = info.isDir();
+    entry.is_symlink_ = info.isSymLink();
+    entry.mtime_ = info.lastModified().toTime_t();
+    entry.size_ = info.size();
+    entries_ << entry;
+  }
+}
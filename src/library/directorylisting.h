@@ -0,0 +1,80 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIRECTORYLISTING_H
+#define DIRECTORYLISTING_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// The contents of one directory, with everything LibraryWatcher needs to know
+// about each entry, so a scan never has to go back to the filesystem for a
+// path it has already listed.
+//
+// On Linux the directory is read with getdents64() and each entry is stat'ed
+// once with fstatat() relative to the open directory.  The file type reported
+// by getdents64() is used to skip the stat entirely for hidden directories,
+// which the scanner never looks inside.  Elsewhere this falls back to
+// QDirIterator.
+class DirectoryListing {
+ public:
+  struct Entry {
+    Entry();
+
+    QString name_;
+    QString path_;
+    bool exists_;
+    bool is_dir_;
+    bool is_symlink_;
+    uint mtime_;
+    qint64 size_;
+
+    bool is_hidden() const { return name_.startsWith('.'); }
+  };
+
+  // Lists the directory.  If it can't be read the listing is empty.
+  explicit DirectoryListing(const QString& path);
+
+  // Stats a single path, following symlinks but remembering it was one.  A
+  // path that doesn't exist gives an entry with exists_ false.
+  static Entry Stat(const QString& path);
+
+  const QString& path() const { return path_; }
+  const QList<Entry>& entries() const { return entries_; }
+
+  // True if the path is directly inside this directory, so the listing knows
+  // whether it exists.
+  bool Covers(const QString& path) const;
+
+  // Returns the entry with this full path, or nullptr if the path isn't
+  // directly inside this directory or doesn't exist.
+  const Entry* Find(const QString& path) const;
+  bool Contains(const QString& path) const { return Find(path) != nullptr; }
+
+ private:
+  void ListPosix();
+  void ListQt();
+
+  QString path_;
+  QString prefix_;  // path_ with a trailing slash
+  QList<Entry> entries_;
+  QHash<QString, int> entries_by_name_;
+};
+
+#endif  // DIRECTORYLISTING_H
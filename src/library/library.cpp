@@ -19,11 +19,14 @@
 
 #include "librarymodel.h"
 #include "librarybackend.h"
+#include "librarychangejournal.h"
 #include "core/application.h"
 #include "core/database.h"
 #include "core/player.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
+#include "core/utilities.h"
+#include "covers/albumcoverloader.h"
 #include "smartplaylists/generator.h"
 #include "smartplaylists/querygenerator.h"
 #include "smartplaylists/search.h"
@@ -42,6 +45,7 @@ Library::Library(Application* app, QObject* parent)
       model_(nullptr),
       watcher_(nullptr),
       watcher_thread_(nullptr),
+      change_journal_(nullptr),
       save_statistics_in_files_(false),
       save_ratings_in_files_(false) {
   backend_ = new LibraryBackend;
@@ -126,7 +130,14 @@ Library::Library(Application* app, QObject* parent)
 Library::~Library() {
   watcher_->deleteLater();
   watcher_thread_->exit();
-  watcher_thread_->wait(5000 /* five seconds */);
+  const bool watcher_finished = watcher_thread_->wait(5000 /* five seconds */);
+
+  // Only trust the journal next time if nothing could have been missed.  A
+  // watcher that's still running might use the journal, so it's leaked.
+  if (watcher_finished) {
+    if (change_journal_) change_journal_->MarkCleanShutdown();
+    delete change_journal_;
+  }
 }
 
 void Library::Init() {
@@ -136,8 +147,13 @@ void Library::Init() {
   watcher_->moveToThread(watcher_thread_);
   watcher_thread_->start(QThread::IdlePriority);
 
+  change_journal_ = new LibraryChangeJournal(
+      Utilities::GetConfigPath(Utilities::Path_Root) + "/library-journal");
+  change_journal_->Open();
+
   watcher_->set_backend(backend_);
   watcher_->set_task_manager(app_->task_manager());
+  watcher_->set_change_journal(change_journal_);
 
   connect(backend_, SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)),
           watcher_, SLOT(AddDirectory(Directory, SubdirectoryList)));
@@ -161,6 +177,8 @@ void Library::Init() {
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(CompilationsNeedUpdating()), backend_,
           SLOT(UpdateCompilations()));
+  connect(watcher_, SIGNAL(EmbeddedArtFound(QStringList)),
+          app_->album_cover_loader(), SLOT(CacheEmbeddedArt(QStringList)));
   connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)),
           SLOT(CurrentSongChanged(Song)));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(Stopped()));
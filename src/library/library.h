@@ -27,6 +27,7 @@
 class Application;
 class Database;
 class LibraryBackend;
+class LibraryChangeJournal;
 class LibraryModel;
 class LibraryWatcher;
 class TaskManager;
@@ -80,6 +81,7 @@ class Library : public QObject {
 
   LibraryWatcher* watcher_;
   QThread* watcher_thread_;
+  LibraryChangeJournal* change_journal_;
 
   bool save_statistics_in_files_;
   bool save_ratings_in_files_;
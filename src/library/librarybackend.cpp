@@ -34,6 +34,7 @@
 #include <QtDebug>
 
 const char* LibraryBackend::kSettingsGroup = "LibraryBackend";
+const int LibraryBackend::kAddOrUpdateChunkSize = 1000;
 
 const char* LibraryBackend::kNewScoreSql =
     "case when playcount <= 0 then (%1 * 100 + score) / 2"
@@ -96,7 +97,7 @@ void LibraryBackend::UpdateSongsRatingAsync(const QList<int>& ids,
 void LibraryBackend::LoadDirectories() {
   DirectoryList dirs = GetAllDirectories();
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   for (const Directory& dir : dirs) {
@@ -106,7 +107,7 @@ void LibraryBackend::LoadDirectories() {
 
 void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
                                    const QString& new_path) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   ScopedTransaction t(&db);
 
@@ -151,7 +152,7 @@ void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
 }
 
 DirectoryList LibraryBackend::GetAllDirectories() {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   DirectoryList ret;
@@ -171,7 +172,7 @@ DirectoryList LibraryBackend::GetAllDirectories() {
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db = db_->Connect();
   return SubdirsInDirectory(id, db);
 }
@@ -198,7 +199,7 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
 }
 
 void LibraryBackend::UpdateTotalSongCount() {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0")
@@ -222,7 +223,7 @@ void LibraryBackend::AddDirectory(const QString& path) {
     qLog(Debug) << "db_path" << db_path;
   }
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -241,7 +242,7 @@ void LibraryBackend::AddDirectory(const QString& path) {
 }
 
 void LibraryBackend::RemoveDirectory(const Directory& dir) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   // Remove songs first
@@ -269,7 +270,7 @@ void LibraryBackend::RemoveDirectory(const Directory& dir) {
 }
 
 SongList LibraryBackend::FindSongsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(
@@ -289,8 +290,33 @@ SongList LibraryBackend::FindSongsInDirectory(int id) {
   return ret;
 }
 
+SongList LibraryBackend::FindSongsWithoutAudioProperties(int directory_id) {
+  Database::ReadLocker l(db_);
+  QSqlDatabase db(db_->Connect());
+
+  // Cue sheet sections get their lengths from the cue sheet.
+  QSqlQuery q(QString("SELECT ROWID, " + Song::kColumnSpec +
+                      " FROM %1"
+                      " WHERE directory = :directory AND samplerate IS NULL"
+                      " AND unavailable = 0"
+                      " AND (cue_path IS NULL OR cue_path = '')")
+                  .arg(songs_table_),
+              db);
+  q.bindValue(":directory", directory_id);
+  q.exec();
+  if (db_->CheckErrors(q)) return SongList();
+
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
+}
+
 void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery find_query(
       QString(
@@ -346,11 +372,52 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
 }
 
 void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  SongList added_songs;
+  SongList deleted_songs;
+
+  for (int i = 0; i < songs.count(); i += kAddOrUpdateChunkSize) {
+    AddOrUpdateSongsChunk(songs.mid(i, kAddOrUpdateChunkSize), &added_songs,
+                          &deleted_songs);
+  }
+
+  if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
+
+  if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
+
+  UpdateTotalSongCountAsync();
+}
+
+QSet<int> LibraryBackend::ExistingDirectoryIds(const SongList& songs,
+                                               QSqlDatabase& db) {
+  QSet<int> ids;
+  for (const Song& song : songs) {
+    ids.insert(song.directory_id());
+  }
+
+  QStringList str_ids;
+  for (int id : ids) {
+    str_ids << QString::number(id);
+  }
+
+  QSet<int> ret;
+  QSqlQuery q(QString("SELECT ROWID FROM %1 WHERE ROWID IN (%2)")
+                  .arg(dirs_table_, str_ids.join(",")),
+              db);
+  q.exec();
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    ret.insert(q.value(0).toInt());
+  }
+  return ret;
+}
+
+void LibraryBackend::AddOrUpdateSongsChunk(const SongList& songs,
+                                           SongList* added_songs,
+                                           SongList* deleted_songs) {
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery check_dir(
-      QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_), db);
   QSqlQuery add_song(QString("INSERT INTO %1 (" + Song::kColumnSpec +
                              ")"
                              " VALUES (" +
@@ -359,31 +426,39 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
   QSqlQuery update_song(QString("UPDATE %1 SET " + Song::kUpdateSpec +
                                 " WHERE ROWID = :id").arg(songs_table_),
                         db);
-  QSqlQuery add_song_fts(
-      QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
-              ")"
-              " VALUES (:id, " +
-              Song::kFtsBindSpec + ")").arg(fts_table_),
-      db);
   QSqlQuery update_song_fts(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
                                     " WHERE ROWID = :id").arg(fts_table_),
                             db);
 
   ScopedTransaction transaction(&db);
 
-  SongList added_songs;
-  SongList deleted_songs;
+  // Do a sanity check first - make sure the songs' directories still exist.
+  // This is to fix a possible race condition when a directory is removed
+  // while LibraryWatcher is scanning it.
+  QSet<int> existing_dirs;
+  if (!dirs_table_.isEmpty()) existing_dirs = ExistingDirectoryIds(songs, db);
+
+  // Get the previous data of all the songs we're about to update in one go.
+  QStringList update_ids;
+  for (const Song& song : songs) {
+    if (song.id() != -1) update_ids << QString::number(song.id());
+  }
+
+  QHash<int, Song> old_songs;
+  if (!update_ids.isEmpty()) {
+    for (const Song& old_song : GetSongsById(update_ids, db)) {
+      old_songs[old_song.id()] = old_song;
+    }
+  }
+
+  QStringList new_ids;
+  SongList chunk_added_songs;
+  SongList chunk_deleted_songs;
 
   for (const Song& song : songs) {
-    // Do a sanity check first - make sure the song's directory still exists
-    // This is to fix a possible race condition when a directory is removed
-    // while LibraryWatcher is scanning it.
-    if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
-
-      if (!check_dir.next()) continue;  // Directory didn't exist
+    if (!dirs_table_.isEmpty() &&
+        !existing_dirs.contains(song.directory_id())) {
+      continue;  // Directory didn't exist
     }
 
     if (song.id() == -1) {
@@ -396,19 +471,13 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
 
       // Get the new ID
       const int id = add_song.lastInsertId().toInt();
-
-      // Add to the FTS index
-      add_song_fts.bindValue(":id", id);
-      song.BindToFtsQuery(&add_song_fts);
-      add_song_fts.exec();
-      if (db_->CheckErrors(add_song_fts)) continue;
+      new_ids << QString::number(id);
 
       Song copy(song);
       copy.set_id(id);
-      added_songs << copy;
+      chunk_added_songs << copy;
     } else {
-      // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
+      const Song old_song = old_songs.value(song.id());
       if (!old_song.is_valid()) continue;
 
       // Update
@@ -422,31 +491,48 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
       update_song_fts.exec();
       if (db_->CheckErrors(update_song_fts)) continue;
 
-      deleted_songs << old_song;
-      added_songs << song;
+      chunk_deleted_songs << old_song;
+      chunk_added_songs << song;
     }
   }
 
-  transaction.Commit();
+  // Add all the new rows to the FTS index with one statement.  The FTS
+  // columns are the song columns with an "fts" prefix.
+  if (!new_ids.isEmpty()) {
+    QStringList source_columns;
+    for (const QString& column : Song::kFtsColumns) {
+      source_columns << column.mid(3);
+    }
 
-  if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
+    QSqlQuery add_songs_fts(
+        QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
+                ")"
+                " SELECT ROWID, %2 FROM %3 WHERE ROWID IN (%4)")
+            .arg(fts_table_, source_columns.join(", "), songs_table_,
+                 new_ids.join(",")),
+        db);
+    add_songs_fts.exec();
+    if (db_->CheckErrors(add_songs_fts)) return;
+  }
 
-  if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
+  transaction.Commit();
 
-  UpdateTotalSongCountAsync();
+  *added_songs << chunk_added_songs;
+  *deleted_songs << chunk_deleted_songs;
 }
 
 void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id")
-                  .arg(songs_table_),
+  QSqlQuery q(QString("UPDATE %1 SET mtime = :mtime, content_id = :content_id"
+                      " WHERE ROWID = :id").arg(songs_table_),
               db);
 
   ScopedTransaction transaction(&db);
   for (const Song& song : songs) {
     q.bindValue(":mtime", song.mtime());
+    q.bindValue(":content_id", song.content_id());
     q.bindValue(":id", song.id());
     q.exec();
     db_->CheckErrors(q);
@@ -454,8 +540,41 @@ void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
   transaction.Commit();
 }
 
+void LibraryBackend::UpdateAudioProperties(const SongList& songs) {
+  if (songs.isEmpty()) return;
+
+  QStringList ids;
+  {
+    Database::WriteLocker l(db_);
+    QSqlDatabase db(db_->Connect());
+
+    QSqlQuery q(QString("UPDATE %1 SET length = :length, bitrate = :bitrate,"
+                        " samplerate = :samplerate WHERE ROWID = :id")
+                    .arg(songs_table_),
+                db);
+
+    ScopedTransaction transaction(&db);
+    for (const Song& song : songs) {
+      // Unknown values are stored as -1, as Song::BindToQuery does, so these
+      // songs are never picked up again.
+      q.bindValue(":length",
+                  song.length_nanosec() <= 0 ? -1 : song.length_nanosec());
+      q.bindValue(":bitrate", song.bitrate() <= 0 ? -1 : song.bitrate());
+      q.bindValue(":samplerate",
+                  song.samplerate() <= 0 ? -1 : song.samplerate());
+      q.bindValue(":id", song.id());
+      q.exec();
+      if (db_->CheckErrors(q)) continue;
+      ids << QString::number(song.id());
+    }
+    transaction.Commit();
+  }
+
+  emit SongsAudioPropertiesChanged(GetSongsById(ids));
+}
+
 void LibraryBackend::DeleteSongs(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery remove(
@@ -482,7 +601,7 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
 
 void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
                                           bool unavailable) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery remove(QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id")
@@ -508,7 +627,7 @@ QStringList LibraryBackend::GetAll(const QString& column,
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -528,7 +647,7 @@ QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
   query.AddCompilationRequirement(false);
   query.AddWhere("album", "", "!=");
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -567,7 +686,7 @@ SongList LibraryBackend::GetSongs(const QString& artist, const QString& album,
 
 SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
   query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(query)) return SongList();
 
   SongList ret;
@@ -580,13 +699,13 @@ SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
 }
 
 Song LibraryBackend::GetSongById(int id) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
   return GetSongById(id, db);
 }
 
 SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QStringList str_ids;
@@ -598,7 +717,7 @@ SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
 }
 
 SongList LibraryBackend::GetSongsById(const QStringList& ids) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   return GetSongsById(ids, db);
@@ -607,7 +726,7 @@ SongList LibraryBackend::GetSongsById(const QStringList& ids) {
 SongList LibraryBackend::GetSongsByForeignId(const QStringList& ids,
                                              const QString& table,
                                              const QString& column) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QString in = ids.join(",");
@@ -702,7 +821,7 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -715,7 +834,7 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
 }
 
 void LibraryBackend::UpdateCompilations() {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   // Look for albums that have songs by more than one 'effective album artist'
@@ -847,7 +966,7 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
     query.AddWhere("artist", artist);
   }
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return ret;
 
   QString last_album;
@@ -884,7 +1003,7 @@ LibraryBackend::Album LibraryBackend::GetAlbumArt(const QString& artist,
   query.AddWhere("artist", artist);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -907,7 +1026,7 @@ void LibraryBackend::UpdateManualAlbumArtAsync(const QString& artist,
 void LibraryBackend::UpdateManualAlbumArt(const QString& artist,
                                           const QString& album,
                                           const QString& art) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   // Get the songs before they're updated
@@ -958,7 +1077,7 @@ void LibraryBackend::UpdateManualAlbumArt(const QString& artist,
 
 void LibraryBackend::ForceCompilation(const QString& album,
                                       const QList<QString>& artists, bool on) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   SongList deleted_songs, added_songs;
 
@@ -1013,11 +1132,12 @@ void LibraryBackend::ForceCompilation(const QString& album,
 }
 
 bool LibraryBackend::ExecQuery(LibraryQuery* q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_,
+                                    db_->is_fts5_table(fts_table_)));
 }
 
 SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   // Build the query
@@ -1049,7 +1169,7 @@ SongList LibraryBackend::GetAllSongs() {
 void LibraryBackend::IncrementPlayCount(int id) {
   if (id == -1) return;
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -1072,7 +1192,7 @@ void LibraryBackend::IncrementSkipCount(int id, float progress) {
   if (id == -1) return;
   progress = qBound(0.0f, progress, 1.0f);
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -1092,7 +1212,7 @@ void LibraryBackend::IncrementSkipCount(int id, float progress) {
 void LibraryBackend::ResetStatistics(int id) {
   if (id == -1) return;
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -1120,7 +1240,7 @@ void LibraryBackend::UpdateSongsRating(const QList<int>& id_list,
                                        float rating) {
   if (id_list.isEmpty()) return;
 
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QStringList id_str_list;
@@ -1141,7 +1261,7 @@ void LibraryBackend::UpdateSongsRating(const QList<int>& id_list,
 
 void LibraryBackend::DeleteAll() {
   {
-    QMutexLocker l(db_->Mutex());
+    Database::WriteLocker l(db_);
     QSqlDatabase db(db_->Connect());
     ScopedTransaction t(&db);
 
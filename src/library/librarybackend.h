@@ -121,6 +121,10 @@ class LibraryBackend : public LibraryBackendInterface {
  public:
   static const char* kSettingsGroup;
 
+  // AddOrUpdateSongs writes large lists in chunks of this many songs, each
+  // in its own transaction, so other queries can get the database in between.
+  static const int kAddOrUpdateChunkSize;
+
   Q_INVOKABLE LibraryBackend(QObject* parent = nullptr);
   void Init(Database* db, const QString& songs_table, const QString& dirs_table,
             const QString& subdirs_table, const QString& fts_table);
@@ -138,6 +142,9 @@ class LibraryBackend : public LibraryBackendInterface {
   void UpdateTotalSongCountAsync();
 
   SongList FindSongsInDirectory(int id);
+  // Returns the songs in the directory that were added without reading their
+  // length, bitrate and sample rate.
+  SongList FindSongsWithoutAudioProperties(int directory_id);
   SubdirectoryList SubdirsInDirectory(int id);
   DirectoryList GetAllDirectories();
   void ChangeDirPath(int id, const QString& old_path, const QString& new_path);
@@ -193,6 +200,9 @@ class LibraryBackend : public LibraryBackendInterface {
   void UpdateTotalSongCount();
   void AddOrUpdateSongs(const SongList& songs);
   void UpdateMTimesOnly(const SongList& songs);
+  // Stores the length, bitrate and sample rate of songs that were added
+  // without them.  A sample rate of 0 means they couldn't be read.
+  void UpdateAudioProperties(const SongList& songs);
   void DeleteSongs(const SongList& songs);
   void MarkSongsUnavailable(const SongList& songs, bool unavailable = true);
   void AddOrUpdateSubdirs(const SubdirectoryList& subdirs);
@@ -216,6 +226,9 @@ signals:
   void SongsDeleted(const SongList& songs);
   void SongsStatisticsChanged(const SongList& songs);
   void SongsRatingChanged(const SongList& songs);
+  // Emitted once the length, bitrate and sample rate of songs that were added
+  // without them have been read.
+  void SongsAudioPropertiesChanged(const SongList& songs);
   void DatabaseReset();
 
   void TotalSongCountUpdated(int total);
@@ -240,6 +253,10 @@ signals:
                       const QueryOptions& opt = QueryOptions());
   SubdirectoryList SubdirsInDirectory(int id, QSqlDatabase& db);
 
+  void AddOrUpdateSongsChunk(const SongList& songs, SongList* added_songs,
+                             SongList* deleted_songs);
+  QSet<int> ExistingDirectoryIds(const SongList& songs, QSqlDatabase& db);
+
   Song GetSongById(int id, QSqlDatabase& db);
   SongList GetSongsById(const QStringList& ids, QSqlDatabase& db);
 
@@ -0,0 +1,134 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "librarychangejournal.h"
+
+#include "core/logging.h"
+
+#include <QMutexLocker>
+
+namespace {
+const char kCleanShutdownMarker[] = "#clean";
+}
+
+LibraryChangeJournal::LibraryChangeJournal(const QString& filename)
+    : file_(filename), was_clean_shutdown_(false) {}
+
+LibraryChangeJournal::~LibraryChangeJournal() { file_.close(); }
+
+void LibraryChangeJournal::Open() {
+  QMutexLocker l(&mutex_);
+
+  dirty_paths_.clear();
+  pending_full_scans_.clear();
+  was_clean_shutdown_ = false;
+
+  if (file_.open(QIODevice::ReadOnly)) {
+    while (!file_.atEnd()) {
+      const QByteArray line = file_.readLine().trimmed();
+      if (line.isEmpty()) continue;
+
+      // Anything recorded after the marker means the marker is stale.
+      was_clean_shutdown_ = line == kCleanShutdownMarker;
+
+      const QString path = QString::fromUtf8(line.mid(1));
+      if (line.startsWith('+')) {
+        dirty_paths_.insert(path);
+      } else if (line.startsWith('-')) {
+        dirty_paths_.remove(path);
+      } else if (line.startsWith('*')) {
+        pending_full_scans_.insert(path);
+      } else if (line.startsWith('=')) {
+        pending_full_scans_.remove(path);
+      }
+    }
+    file_.close();
+  }
+
+  // Rewrite the journal with just the outstanding paths and no marker, so a
+  // crash from now on is detected on the next startup.
+  if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qLog(Warning) << "Couldn't open library change journal"
+                  << file_.fileName();
+    return;
+  }
+
+  for (const QString& path : dirty_paths_) {
+    file_.write("+" + path.toUtf8() + "\n");
+  }
+  for (const QString& path : pending_full_scans_) {
+    file_.write("*" + path.toUtf8() + "\n");
+  }
+  file_.flush();
+}
+
+QSet<QString> LibraryChangeJournal::dirty_paths() const {
+  QMutexLocker l(&mutex_);
+  return dirty_paths_;
+}
+
+bool LibraryChangeJournal::IsDirty(const QString& path) const {
+  QMutexLocker l(&mutex_);
+  return dirty_paths_.contains(path);
+}
+
+void LibraryChangeJournal::MarkDirty(const QString& path) {
+  QMutexLocker l(&mutex_);
+  if (dirty_paths_.contains(path)) return;
+
+  dirty_paths_.insert(path);
+  Append("+" + path.toUtf8());
+}
+
+void LibraryChangeJournal::MarkClean(const QString& path) {
+  QMutexLocker l(&mutex_);
+  if (!dirty_paths_.remove(path)) return;
+
+  Append("-" + path.toUtf8());
+}
+
+bool LibraryChangeJournal::IsFullScanPending(const QString& dir_path) const {
+  QMutexLocker l(&mutex_);
+  return pending_full_scans_.contains(dir_path);
+}
+
+void LibraryChangeJournal::SetFullScanPending(const QString& dir_path,
+                                              bool pending) {
+  QMutexLocker l(&mutex_);
+  if (pending) {
+    if (pending_full_scans_.contains(dir_path)) return;
+    pending_full_scans_.insert(dir_path);
+    Append("*" + dir_path.toUtf8());
+  } else {
+    if (!pending_full_scans_.remove(dir_path)) return;
+    Append("=" + dir_path.toUtf8());
+  }
+}
+
+void LibraryChangeJournal::MarkCleanShutdown() {
+  QMutexLocker l(&mutex_);
+  Append(kCleanShutdownMarker);
+  file_.close();
+}
+
+void LibraryChangeJournal::Append(const QByteArray& line) {
+  if (!file_.isOpen()) return;
+
+  file_.write(line + "\n");
+  file_.flush();
+}
@@ -0,0 +1,73 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_LIBRARYCHANGEJOURNAL_H_
+#define LIBRARY_LIBRARYCHANGEJOURNAL_H_
+
+#include <QFile>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Remembers which library subdirectories have changed (according to the
+// filesystem watcher) but haven't been rescanned yet.  The journal is an
+// append-only file of "+path" and "-path" lines, and a final marker line is
+// written when Clementine shuts down cleanly.  If the marker is there on the
+// next startup, the dirty set is complete and only those directories need to
+// be rescanned.
+// A library directory whose full incremental scan was started but never
+// finished is recorded with "*path" and "=path" lines, since changes made
+// before that scan aren't in the dirty set.
+// All methods are thread safe.
+class LibraryChangeJournal {
+ public:
+  explicit LibraryChangeJournal(const QString& filename);
+  ~LibraryChangeJournal();
+
+  // Replays and compacts the journal on disk, then opens it for appending.
+  void Open();
+
+  // True if the previous session ended with MarkCleanShutdown().
+  bool was_clean_shutdown() const { return was_clean_shutdown_; }
+
+  QSet<QString> dirty_paths() const;
+  bool IsDirty(const QString& path) const;
+
+  void MarkDirty(const QString& path);
+  void MarkClean(const QString& path);
+
+  bool IsFullScanPending(const QString& dir_path) const;
+  void SetFullScanPending(const QString& dir_path, bool pending);
+
+  // Writes the clean shutdown marker and closes the file.  Nothing can be
+  // recorded after this.
+  void MarkCleanShutdown();
+
+ private:
+  void Append(const QByteArray& line);
+
+ private:
+  mutable QMutex mutex_;
+  QFile file_;
+
+  bool was_clean_shutdown_;
+  QSet<QString> dirty_paths_;
+  QSet<QString> pending_full_scans_;
+};
+
+#endif  // LIBRARY_LIBRARYCHANGEJOURNAL_H_
@@ -25,7 +25,6 @@
 #include <QMetaEnum>
 #include <QNetworkCacheMetaData>
 #include <QNetworkDiskCache>
-#include <QPixmapCache>
 #include <QSettings>
 #include <QStringList>
 #include <QUrl>
@@ -63,6 +62,7 @@ const char* LibraryModel::kSmartPlaylistsSettingsGroup =
 const int LibraryModel::kSmartPlaylistsVersion = 4;
 const int LibraryModel::kPrettyCoverSize = 32;
 const qint64 LibraryModel::kIconCacheSize = 100000000;  //~100MB
+const int LibraryModel::kIconMemoryCacheSize = 8 * 1024 * 1024;
 typedef QFuture<LibraryModel::QueryResult> RootQueryFuture;
 typedef QFutureWatcher<LibraryModel::QueryResult> RootQueryWatcher;
 
@@ -89,9 +89,13 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
       playlists_dir_icon_(IconLoader::Load("folder-sound")),
       playlist_icon_(":/icons/22x22/x-clementine-albums.png"),
       icon_cache_(new QNetworkDiskCache(this)),
+      icon_memory_cache_(kIconMemoryCacheSize),
+      icon_cache_hits_(0),
+      icon_cache_misses_(0),
       init_task_id_(-1),
       use_pretty_covers_(false),
-      show_dividers_(true) {
+      show_dividers_(true),
+      use_song_index_(false) {
   root_->lazy_loaded = true;
 
   group_by_[0] = GroupBy_Artist;
@@ -102,8 +106,11 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.scale_output_image_ = true;
 
-  connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
-          SLOT(AlbumArtLoaded(quint64, QImage)));
+  // Tests and benchmarks create models without an Application.
+  if (app_) {
+    connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
+            SLOT(AlbumArtLoaded(quint64, QImage)));
+  }
 
   icon_cache_->setCacheDirectory(
       Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/pixmapcache");
@@ -121,7 +128,9 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
           SLOT(SongsSlightlyChanged(SongList)));
   connect(backend_, SIGNAL(SongsRatingChanged(SongList)),
           SLOT(SongsSlightlyChanged(SongList)));
-  connect(backend_, SIGNAL(DatabaseReset()), SLOT(Reset()));
+  connect(backend_, SIGNAL(SongsAudioPropertiesChanged(SongList)),
+          SLOT(SongsAudioPropertiesChanged(SongList)));
+  connect(backend_, SIGNAL(DatabaseReset()), SLOT(BackendReset()));
   connect(backend_, SIGNAL(TotalSongCountUpdated(int)),
           SLOT(TotalSongCountUpdatedSlot(int)));
 
@@ -144,6 +153,11 @@ void LibraryModel::set_show_dividers(bool show_dividers) {
   }
 }
 
+void LibraryModel::set_use_song_index(bool use_song_index) {
+  use_song_index_ = use_song_index;
+  if (!use_song_index_) song_index_.Clear();
+}
+
 void LibraryModel::Init(bool async) {
   if (async) {
     // Show a loading indicator in the model.
@@ -163,6 +177,8 @@ void LibraryModel::Init(bool async) {
 }
 
 void LibraryModel::SongsDiscovered(const SongList& songs) {
+  song_index_.AddOrUpdate(songs);
+
   for (const Song& song : songs) {
     // Sanity check to make sure we don't add songs that are outside the user's
     // filter
@@ -269,6 +285,20 @@ void LibraryModel::SongsSlightlyChanged(const SongList& songs) {
   }
 }
 
+void LibraryModel::SongsAudioPropertiesChanged(const SongList& songs) {
+  // The songs were added before their bitrate was known, so if that's one of
+  // the groupings they're in the wrong containers.
+  if (group_by_[0] == GroupBy_Bitrate || group_by_[1] == GroupBy_Bitrate ||
+      group_by_[2] == GroupBy_Bitrate) {
+    SongsDeleted(songs);
+    SongsDiscovered(songs);
+    return;
+  }
+
+  song_index_.AddOrUpdate(songs);
+  SongsSlightlyChanged(songs);
+}
+
 LibraryItem* LibraryModel::CreateCompilationArtistNode(bool signal,
                                                        LibraryItem* parent) {
   if (signal)
@@ -367,6 +397,8 @@ QString LibraryModel::DividerDisplayText(GroupBy type,
 }
 
 void LibraryModel::SongsDeleted(const SongList& songs) {
+  song_index_.Remove(songs);
+
   // Delete the actual song nodes first, keeping track of each parent so we
   // might check to see if they're empty later.
   QSet<LibraryItem*> parents;
@@ -463,25 +495,46 @@ QVariant LibraryModel::AlbumIcon(const QModelIndex& index) {
 
   // Check the cache for a pixmap we already loaded.
   const QString cache_key = AlbumIconPixmapCacheKey(index);
-  QPixmap cached_pixmap;
-  if (QPixmapCache::find(cache_key, &cached_pixmap)) {
-    return cached_pixmap;
+  const QPixmap* cached_pixmap = icon_memory_cache_.object(cache_key);
+  if (cached_pixmap) {
+    ++icon_cache_hits_;
+    return *cached_pixmap;
   }
+  ++icon_cache_misses_;
 
-  // Try to load it from the disk cache
-  std::unique_ptr<QIODevice> cache(icon_cache_->data(QUrl(cache_key)));
-  if (cache) {
-    QImage cached_pixmap;
-    if (cached_pixmap.load(cache.get(), "XPM")) {
-      QPixmapCache::insert(cache_key, QPixmap::fromImage(cached_pixmap));
-      return QPixmap::fromImage(cached_pixmap);
-    }
+  QPixmap pixmap;
+  if (LoadAlbumIconFromDisk(cache_key, &pixmap)) {
+    return pixmap;
   }
 
+  StartAlbumIconLoad(index, cache_key);
+  return no_cover_icon_;
+}
+
+bool LibraryModel::IsAlbumNode(const LibraryItem* item) const {
+  if (item->type != LibraryItem::Type_Container) return false;
+
+  GroupBy container_type = group_by_[item->container_level];
+  return container_type == GroupBy_Album || container_type == GroupBy_YearAlbum;
+}
+
+bool LibraryModel::LoadAlbumIconFromDisk(const QString& cache_key,
+                                         QPixmap* pixmap) {
+  std::unique_ptr<QIODevice> cache(icon_cache_->data(QUrl(cache_key)));
+  if (!cache) return false;
+
+  QImage image;
+  if (!image.load(cache.get(), "XPM")) return false;
+
+  *pixmap = QPixmap::fromImage(image);
+  InsertAlbumIcon(cache_key, *pixmap);
+  return true;
+}
+
+void LibraryModel::StartAlbumIconLoad(const QModelIndex& index,
+                                      const QString& cache_key) {
   // Maybe we're loading a pixmap already?
-  if (pending_cache_keys_.contains(cache_key)) {
-    return no_cover_icon_;
-  }
+  if (!app_ || pending_cache_keys_.contains(cache_key)) return;
 
   // No art is cached and we're not loading it already.  Load art for the first
   // Song in the album.
@@ -489,11 +542,54 @@ QVariant LibraryModel::AlbumIcon(const QModelIndex& index) {
   if (!songs.isEmpty()) {
     const quint64 id = app_->album_cover_loader()->LoadImageAsync(
         cover_loader_options_, songs.first());
-    pending_art_[id] = ItemAndCacheKey(item, cache_key);
+    pending_art_[id] = ItemAndCacheKey(IndexToItem(index), cache_key);
     pending_cache_keys_.insert(cache_key);
   }
+}
 
-  return no_cover_icon_;
+void LibraryModel::InsertAlbumIcon(const QString& cache_key,
+                                   const QPixmap& pixmap) {
+  const int cost = pixmap.width() * pixmap.height() * pixmap.depth() / 8;
+  icon_memory_cache_.insert(cache_key, new QPixmap(pixmap), cost);
+}
+
+void LibraryModel::PrefetchAlbumIcons(const QModelIndexList& indexes) {
+  if (!use_pretty_covers_ || !app_) return;
+
+  QSet<QString> wanted_cache_keys;
+  for (const QModelIndex& index : indexes) {
+    const LibraryItem* item = IndexToItem(index);
+    if (!item || !IsAlbumNode(item)) continue;
+
+    const QString cache_key = AlbumIconPixmapCacheKey(index);
+    wanted_cache_keys.insert(cache_key);
+
+    // This also marks the icon as recently used, so it outlives the ones that
+    // scrolled away.
+    if (icon_memory_cache_.object(cache_key)) continue;
+
+    QPixmap pixmap;
+    if (!LoadAlbumIconFromDisk(cache_key, &pixmap)) {
+      StartAlbumIconLoad(index, cache_key);
+    }
+  }
+
+  // Cancel the loads for icons that are no longer near the viewport.
+  QSet<quint64> cancelled_ids;
+  for (QMap<quint64, ItemAndCacheKey>::iterator it = pending_art_.begin();
+       it != pending_art_.end();) {
+    if (wanted_cache_keys.contains(it->second)) {
+      ++it;
+    } else {
+      cancelled_ids.insert(it.key());
+      pending_cache_keys_.remove(it->second);
+      it = pending_art_.erase(it);
+    }
+  }
+
+  if (!cancelled_ids.isEmpty()) {
+    app_->album_cover_loader()->CancelTasks(cancelled_ids);
+  }
 }
 
 void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
@@ -507,9 +603,9 @@ void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
   // Insert this image in the cache.
   if (image.isNull()) {
     // Set the no_cover image so we don't continually try to load art.
-    QPixmapCache::insert(cache_key, no_cover_icon_);
+    InsertAlbumIcon(cache_key, no_cover_icon_);
   } else {
-    QPixmapCache::insert(cache_key, QPixmap::fromImage(image));
+    InsertAlbumIcon(cache_key, QPixmap::fromImage(image));
   }
 
   // if not already in the disk cache
@@ -538,14 +634,7 @@ QVariant LibraryModel::data(const QModelIndex& index, int role) const {
   // QModelIndex& version of GetChildSongs, which satisfies const-ness, instead
   // of the LibraryItem* version, which doesn't.
   if (use_pretty_covers_) {
-    bool is_album_node = false;
-    if (role == Qt::DecorationRole &&
-        item->type == LibraryItem::Type_Container) {
-      GroupBy container_type = group_by_[item->container_level];
-      is_album_node = container_type == GroupBy_Album ||
-                      container_type == GroupBy_YearAlbum;
-    }
-    if (is_album_node) {
+    if (role == Qt::DecorationRole && IsAlbumNode(item)) {
       // It has const behaviour some of the time - that's ok right?
       return const_cast<LibraryModel*>(this)->AlbumIcon(index);
     }
@@ -638,13 +727,15 @@ bool LibraryModel::HasCompilations(const LibraryQuery& query) {
   q.AddCompilationRequirement(true);
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
+  Database::ReadLocker l(backend_->db());
   if (!backend_->ExecQuery(&q)) return false;
 
   return q.Next();
 }
 
 LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
+  if (CanUseSongIndex()) return RunIndexQuery(parent);
+
   QueryResult result;
 
   // Information about what we want the children to be
@@ -675,7 +766,7 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
+  Database::ReadLocker l(backend_->db());
   if (!backend_->ExecQuery(&q)) return result;
 
   while (q.Next()) {
@@ -684,6 +775,60 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   return result;
 }
 
+bool LibraryModel::CanUseSongIndex() const {
+  // The index doesn't know about the full text search table.
+  return use_song_index_ && query_options_.filter().isEmpty() &&
+         query_options_.query_mode() == QueryOptions::QueryMode_All;
+}
+
+LibraryModel::QueryResult LibraryModel::RunIndexQuery(LibraryItem* parent) {
+  QueryResult result;
+
+  // This reads the database the first time, but is a no-op afterwards.
+  song_index_.Load(backend_);
+
+  // Information about what we want the children to be
+  int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+
+  LibrarySongIndex::Query q;
+  q.SetMaxAge(query_options_.max_age());
+
+  // Walk up through the item's parents adding filters as necessary
+  LibraryItem* p = parent;
+  while (p && p->type == LibraryItem::Type_Container) {
+    FilterQuery(group_by_[p->container_level], p, &q);
+    p = p->parent;
+  }
+
+  // Artists GroupBy is special - we don't want compilation albums appearing
+  if (IsArtistGroupBy(child_type)) {
+    if (show_various_artists_) {
+      LibrarySongIndex::Query compilations = q;
+      compilations.AddCompilationRequirement(true);
+      result.create_va = song_index_.Contains(compilations);
+    }
+    q.AddCompilationRequirement(false);
+  }
+
+  if (child_type != GroupBy_None) {
+    for (const QVariantList& values :
+         song_index_.Distinct(GroupByColumns(child_type), q)) {
+      result.rows << SqlRow(values);
+    }
+    return result;
+  }
+
+  // The index only knows enough about each song to group it, so fetch the
+  // songs themselves from the database.  Usually this is a single album.
+  const QList<int> ids = song_index_.SongIds(q);
+  const int chunk_size = 1000;
+  for (int i = 0; i < ids.count(); i += chunk_size) {
+    result.songs << backend_->GetSongsById(ids.mid(i, chunk_size));
+  }
+  return result;
+}
+
 void LibraryModel::PostQuery(LibraryItem* parent,
                              const LibraryModel::QueryResult& result,
                              bool signal) {
@@ -707,6 +852,11 @@ void LibraryModel::PostQuery(LibraryItem* parent,
     else
       container_nodes_[child_level][item->key] = item;
   }
+
+  for (const Song& song : result.songs) {
+    song_nodes_[song.id()] = ItemFromSong(GroupBy_None, signal, child_level == 0,
+                                          parent, song, child_level);
+  }
 }
 
 void LibraryModel::LazyPopulate(LibraryItem* parent, bool signal) {
@@ -753,6 +903,7 @@ void LibraryModel::BeginReset() {
   container_nodes_[2].clear();
   divider_nodes_.clear();
   pending_art_.clear();
+  pending_cache_keys_.clear();
   smart_playlist_node_ = nullptr;
 
   root_ = new LibraryItem(this);
@@ -773,53 +924,51 @@ void LibraryModel::Reset() {
   endResetModel();
 }
 
-void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
-  // Say what type of thing we want to get back from the database.
+QStringList LibraryModel::GroupByColumns(GroupBy type) {
   switch (type) {
     case GroupBy_Artist:
-      q->SetColumnSpec("DISTINCT artist");
-      break;
+      return QStringList() << "artist";
     case GroupBy_Album:
-      q->SetColumnSpec("DISTINCT album");
-      break;
+      return QStringList() << "album";
     case GroupBy_Composer:
-      q->SetColumnSpec("DISTINCT composer");
-      break;
+      return QStringList() << "composer";
     case GroupBy_Performer:
-      q->SetColumnSpec("DISTINCT performer");
-      break;
+      return QStringList() << "performer";
     case GroupBy_Disc:
-      q->SetColumnSpec("DISTINCT disc");
-      break;
+      return QStringList() << "disc";
     case GroupBy_Grouping:
-      q->SetColumnSpec("DISTINCT grouping");
-      break;
+      return QStringList() << "grouping";
     case GroupBy_YearAlbum:
-      q->SetColumnSpec("DISTINCT year, album, grouping");
-      break;
+      return QStringList() << "year"
+                           << "album"
+                           << "grouping";
     case GroupBy_Year:
-      q->SetColumnSpec("DISTINCT year");
-      break;
+      return QStringList() << "year";
     case GroupBy_Genre:
-      q->SetColumnSpec("DISTINCT genre");
-      break;
+      return QStringList() << "genre";
     case GroupBy_AlbumArtist:
-      q->SetColumnSpec("DISTINCT effective_albumartist");
-      break;
+      return QStringList() << "effective_albumartist";
     case GroupBy_Bitrate:
-      q->SetColumnSpec("DISTINCT bitrate");
-      break;
-    case GroupBy_None:
-      q->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-      break;
+      return QStringList() << "bitrate";
     case GroupBy_FileType:
-      q->SetColumnSpec("DISTINCT filetype");
+      return QStringList() << "filetype";
+    case GroupBy_None:
       break;
   }
+  return QStringList();
+}
+
+void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
+  // Say what type of thing we want to get back from the database.
+  if (type == GroupBy_None) {
+    q->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+  } else {
+    q->SetColumnSpec("DISTINCT " + GroupByColumns(type).join(", "));
+  }
 }
 
-void LibraryModel::FilterQuery(GroupBy type, LibraryItem* item,
-                               LibraryQuery* q) {
+template <typename Query>
+void LibraryModel::FilterQuery(GroupBy type, LibraryItem* item, Query* q) {
   // Say how we want the query to be filtered.  This is done once for each
   // parent going up the tree.
 
@@ -1417,6 +1566,11 @@ GeneratorPtr LibraryModel::CreateGenerator(const QModelIndex& index) const {
   return ret;
 }
 
+void LibraryModel::BackendReset() {
+  song_index_.Clear();
+  Reset();
+}
+
 void LibraryModel::TotalSongCountUpdatedSlot(int count) {
   total_song_count_ = count;
   emit TotalSongCountUpdated(count);
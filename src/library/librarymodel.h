@@ -19,11 +19,13 @@
 #define LIBRARYMODEL_H
 
 #include <QAbstractItemModel>
+#include <QCache>
 #include <QIcon>
 #include <QNetworkDiskCache>
 
 #include "libraryitem.h"
 #include "libraryquery.h"
+#include "librarysongindex.h"
 #include "librarywatcher.h"
 #include "sqlrow.h"
 #include "core/simpletreemodel.h"
@@ -58,6 +60,8 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   static const int kSmartPlaylistsVersion;
   static const int kPrettyCoverSize;
   static const qint64 kIconCacheSize;
+  // The most bytes of album icons kept in memory.
+  static const int kIconMemoryCacheSize;
 
   enum Role {
     Role_Type = Qt::UserRole + 1,
@@ -109,6 +113,9 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
     QueryResult() : create_va(false) {}
 
     SqlRowList rows;
+    // Songs for the lowest level, when the query was answered by the song
+    // index.
+    SongList songs;
     bool create_va;
   };
 
@@ -156,9 +163,22 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   void set_pretty_covers(bool use_pretty_covers);
   bool use_pretty_covers() const { return use_pretty_covers_; }
 
+  // Starts loading the album icons for these indexes before they are shown,
+  // and cancels loads for any other icons.  The view calls this with the rows
+  // in and around its viewport as it scrolls.
+  void PrefetchAlbumIcons(const QModelIndexList& indexes);
+
+  // How often data() found an album icon in memory.
+  int icon_cache_hits() const { return icon_cache_hits_; }
+  int icon_cache_misses() const { return icon_cache_misses_; }
+
   // Whether or not to show letters heading in the library view
   void set_show_dividers(bool show_dividers);
 
+  // Whether to keep the columns used for grouping in memory, so changing the
+  // grouping or expanding a node doesn't have to query the database.
+  void set_use_song_index(bool use_song_index);
+
   // Utility functions for manipulating text
   static QString TextOrUnknown(const QString& text);
   static QString PrettyYearAlbum(int year, const QString& album);
@@ -191,7 +211,9 @@ signals:
   void SongsDiscovered(const SongList& songs);
   void SongsDeleted(const SongList& songs);
   void SongsSlightlyChanged(const SongList& songs);
+  void SongsAudioPropertiesChanged(const SongList& songs);
   void TotalSongCountUpdatedSlot(int count);
+  void BackendReset();
 
   // Called after ResetAsync
   void ResetAsyncQueryFinished();
@@ -203,6 +225,10 @@ signals:
   // This gets called a lot when filtering the playlist, so it's nice to be
   // able to do it in a background thread.
   QueryResult RunQuery(LibraryItem* parent);
+  // The same as RunQuery, but answered from song_index_.  Only possible when
+  // there's no search filter.
+  bool CanUseSongIndex() const;
+  QueryResult RunIndexQuery(LibraryItem* parent);
   void PostQuery(LibraryItem* parent, const QueryResult& result, bool signal);
 
   bool HasCompilations(const LibraryQuery& query);
@@ -214,8 +240,11 @@ signals:
   // constructs a database query to populate the items.  Filters are added
   // for each parent item, restricting the songs returned to a particular
   // album or artist for example.
+  // FilterQuery works on both LibraryQuery and LibrarySongIndex::Query.
+  static QStringList GroupByColumns(GroupBy type);
   static void InitQuery(GroupBy type, LibraryQuery* q);
-  void FilterQuery(GroupBy type, LibraryItem* item, LibraryQuery* q);
+  template <typename Query>
+  void FilterQuery(GroupBy type, LibraryItem* item, Query* q);
 
   // Items can be created either from a query that's been run to populate a
   // node, or by a spontaneous SongsDiscovered emission from the backend.
@@ -247,6 +276,10 @@ signals:
   // Helpers
   QString AlbumIconPixmapCacheKey(const QModelIndex& index) const;
   QVariant AlbumIcon(const QModelIndex& index);
+  bool IsAlbumNode(const LibraryItem* item) const;
+  bool LoadAlbumIconFromDisk(const QString& cache_key, QPixmap* pixmap);
+  void StartAlbumIconLoad(const QModelIndex& index, const QString& cache_key);
+  void InsertAlbumIcon(const QString& cache_key, const QPixmap& pixmap);
   QVariant data(const LibraryItem* item, int role) const;
   bool CompareItems(const LibraryItem* a, const LibraryItem* b) const;
 
@@ -284,12 +317,20 @@ signals:
   QIcon playlist_icon_;
 
   QNetworkDiskCache* icon_cache_;
+  // Least recently used album icons are dropped first.  The cost of each is
+  // its size in bytes.
+  QCache<QString, QPixmap> icon_memory_cache_;
+  int icon_cache_hits_;
+  int icon_cache_misses_;
 
   int init_task_id_;
 
   bool use_pretty_covers_;
   bool show_dividers_;
 
+  bool use_song_index_;
+  LibrarySongIndex song_index_;
+
   AlbumCoverLoaderOptions cover_loader_options_;
 
   typedef QPair<LibraryItem*, QString> ItemAndCacheKey;
@@ -27,6 +27,7 @@ class LibraryPlaylistItem : public PlaylistItem {
   LibraryPlaylistItem(const Song& song);
 
   bool InitFromQuery(const SqlRow& query);
+  void ShareStrings(StringPool* pool) { song_.ShareStrings(pool); }
   void Reload();
 
   Song Metadata() const;
@@ -28,44 +28,45 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
     : include_unavailable_(false), join_with_fts_(false), limit_(-1) {
   if (!options.filter().isEmpty()) {
     // We need to munge the filter text a little bit to get it to work as
-    // expected with sqlite's FTS3:
+    // expected with sqlite's full text search:
     //  1) Append * to all tokens.
     //  2) Prefix "fts" to column names.
     //  3) Remove colons which don't correspond to column names.
+    // The query itself is built in Exec() once we know whether the table is
+    // FTS3 or FTS5.
 
     // Split on whitespace
     QStringList tokens(
         options.filter().split(QRegExp("\\s+"), QString::SkipEmptyParts));
-    QString query;
     for (QString token : tokens) {
       token.remove('(');
       token.remove(')');
       token.remove('"');
       token.replace('-', ' ');
 
+      FtsTerm term;
       if (token.contains(':')) {
         // Only prefix fts if the token is a valid column name.
         if (Song::kFtsColumns.contains("fts" + token.section(':', 0, 0),
                                        Qt::CaseInsensitive)) {
           // Account for multiple colons.
-          QString columntoken =
-              token.section(':', 0, 0, QString::SectionIncludeTrailingSep);
           QString subtoken = token.section(':', 1, -1);
           subtoken.replace(":", " ");
-          subtoken = subtoken.trimmed();
-          query += "fts" + columntoken + subtoken + "* ";
+          term.column_ = "fts" + token.section(':', 0, 0);
+          term.text_ = subtoken.trimmed();
         } else {
           token.replace(":", " ");
-          token = token.trimmed();
-          query += token + "* ";
+          term.text_ = token.trimmed();
         }
       } else {
-        query += token + "* ";
+        term.text_ = token;
       }
+      fts_terms_ << term;
     }
 
+    // The value is filled in by Exec().
     where_clauses_ << "fts.%fts_table_noprefix MATCH ?";
-    bound_values_ << query;
+    bound_values_ << QVariant();
     join_with_fts_ = true;
   }
 
@@ -138,8 +139,31 @@ void LibraryQuery::AddCompilationRequirement(bool compilation) {
                         .arg(compilation ? 1 : 0);
 }
 
+QString LibraryQuery::FtsQuery(bool fts5) const {
+  QString query;
+  for (const FtsTerm& term : fts_terms_) {
+    if (!fts5) {
+      if (!term.column_.isEmpty()) query += term.column_ + ":";
+      query += term.text_ + "* ";
+      continue;
+    }
+
+    // FTS5 is stricter about what it accepts as a bare word, so quote every
+    // word.  Like FTS3, the column filter applies to the first word and only
+    // the last one is a prefix.
+    const QStringList words = term.text_.split(' ', QString::SkipEmptyParts);
+    for (int i = 0; i < words.count(); ++i) {
+      if (i == 0 && !term.column_.isEmpty()) query += term.column_ + ":";
+      query += "\"" + words[i] + "\"";
+      if (i == words.count() - 1) query += "*";
+      query += " ";
+    }
+  }
+  return query;
+}
+
 QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
-                             const QString& fts_table) {
+                             const QString& fts_table, bool fts5) {
   QString sql;
 
   if (join_with_fts_) {
@@ -168,8 +192,10 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
 
   query_ = QSqlQuery(sql, db);
 
-  // Bind values
-  for (const QVariant& value : bound_values_) {
+  // Bind values.  The MATCH is always the first one.
+  QVariantList bound_values(bound_values_);
+  if (join_with_fts_) bound_values[0] = FtsQuery(fts5);
+  for (const QVariant& value : bound_values) {
     query_.addBindValue(value);
   }
 
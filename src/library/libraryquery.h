@@ -86,18 +86,28 @@ class LibraryQuery {
     include_unavailable_ = include_unavailable;
   }
 
+  // fts5 says whether fts_table is an FTS5 table, which needs a different
+  // query syntax.
   QSqlQuery Exec(QSqlDatabase db, const QString& songs_table,
-                 const QString& fts_table);
+                 const QString& fts_table, bool fts5 = false);
   bool Next();
   QVariant Value(int column) const;
 
   operator const QSqlQuery&() const { return query_; }
 
  private:
+  // A word or words from the filter, optionally restricted to a column.
+  struct FtsTerm {
+    QString column_;
+    QString text_;
+  };
+
   QString GetInnerQuery();
+  QString FtsQuery(bool fts5) const;
 
   bool include_unavailable_;
   bool join_with_fts_;
+  QList<FtsTerm> fts_terms_;
   QString column_spec_;
   QString order_by_;
   QStringList where_clauses_;
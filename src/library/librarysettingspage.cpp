@@ -93,10 +93,12 @@ void LibrarySettingsPage::Save() {
   s.beginGroup(LibraryWatcher::kSettingsGroup);
   s.setValue("startup_scan", ui_->startup_scan->isChecked());
   s.setValue("monitor", ui_->monitor->isChecked());
+  s.setValue("startup_scan_journal", ui_->startup_scan_journal->isChecked());
 
   QString filter_text = ui_->cover_art_patterns->text();
   QStringList filters = filter_text.split(',', QString::SkipEmptyParts);
   s.setValue("cover_art_patterns", filters);
+  s.setValue("extract_embedded_art", ui_->extract_embedded_art->isChecked());
 
   s.endGroup();
 
@@ -133,11 +135,15 @@ void LibrarySettingsPage::Load() {
   s.beginGroup(LibraryWatcher::kSettingsGroup);
   ui_->startup_scan->setChecked(s.value("startup_scan", true).toBool());
   ui_->monitor->setChecked(s.value("monitor", true).toBool());
+  ui_->startup_scan_journal->setChecked(
+      s.value("startup_scan_journal", false).toBool());
 
   QStringList filters =
       s.value("cover_art_patterns", QStringList() << "front"
                                                   << "cover").toStringList();
   ui_->cover_art_patterns->setText(filters.join(","));
+  ui_->extract_embedded_art->setChecked(
+      s.value("extract_embedded_art", true).toBool());
 
   s.endGroup();
 
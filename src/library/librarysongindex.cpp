@@ -0,0 +1,338 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "librarysongindex.h"
+
+#include <QDateTime>
+#include <QSet>
+#include <QTime>
+
+#include "librarybackend.h"
+#include "libraryquery.h"
+#include "core/database.h"
+#include "core/logging.h"
+
+// In the same order as the Field enum.
+const char* LibrarySongIndex::kFieldColumns[] = {
+    "artist", "album", "effective_albumartist", "composer", "performer",
+    "grouping", "genre", "year", "disc", "bitrate", "filetype"};
+
+LibrarySongIndex::Query::Query()
+    : require_compilation_(false),
+      require_not_compilation_(false),
+      max_age_(-1) {}
+
+void LibrarySongIndex::Query::AddWhere(const QString& column,
+                                       const QVariant& value) {
+  where_ << qMakePair(column, value);
+}
+
+void LibrarySongIndex::Query::AddCompilationRequirement(bool compilation) {
+  if (compilation)
+    require_compilation_ = true;
+  else
+    require_not_compilation_ = true;
+}
+
+void LibrarySongIndex::Query::SetMaxAge(int max_age) { max_age_ = max_age; }
+
+LibrarySongIndex::LibrarySongIndex() : loaded_(false) {}
+
+int LibrarySongIndex::FieldForColumn(const QString& column) {
+  for (int i = 0; i < FieldCount; ++i) {
+    if (column == kFieldColumns[i]) return i;
+  }
+  return -1;
+}
+
+bool LibrarySongIndex::is_loaded() const {
+  QMutexLocker l(&mutex_);
+  return loaded_;
+}
+
+void LibrarySongIndex::Clear() {
+  QMutexLocker l(&mutex_);
+  ClearLocked();
+}
+
+void LibrarySongIndex::ClearLocked() {
+  loaded_ = false;
+  strings_.clear();
+  string_ids_.clear();
+  ids_.clear();
+  for (int i = 0; i < FieldCount; ++i) fields_[i].clear();
+  compilations_.clear();
+  ctimes_.clear();
+  rows_.clear();
+}
+
+void LibrarySongIndex::Load(LibraryBackend* backend) {
+  QMutexLocker l(&mutex_);
+  if (loaded_) return;
+  ClearLocked();
+
+  QTime time;
+  time.start();
+
+  QStringList columns;
+  for (int i = 0; i < FieldCount; ++i) columns << kFieldColumns[i];
+
+  LibraryQuery q;
+  q.SetColumnSpec("%songs_table.ROWID, " + columns.join(", ") +
+                  ", effective_compilation, ctime");
+
+  {
+    Database::ReadLocker db_lock(backend->db());
+    if (!backend->ExecQuery(&q)) return;
+
+    while (q.Next()) {
+      const int row = ids_.count();
+      ids_ << q.Value(0).toInt();
+      for (int i = 0; i < FieldCount; ++i) {
+        const QVariant value = q.Value(i + 1);
+        fields_[i] << (i < kFirstIntField ? Intern(value.toString())
+                                          : value.toInt());
+      }
+      compilations_ << q.Value(FieldCount + 1).toBool();
+      ctimes_ << q.Value(FieldCount + 2).toUInt();
+      rows_[ids_.last()] = row;
+    }
+  }
+
+  loaded_ = true;
+  qLog(Debug) << "Loaded" << ids_.count() << "songs and" << strings_.count()
+              << "strings into the song index in" << time.elapsed() << "ms";
+}
+
+int LibrarySongIndex::Intern(const QString& string) {
+  QHash<QString, int>::const_iterator it = string_ids_.constFind(string);
+  if (it != string_ids_.constEnd()) return it.value();
+
+  const int id = strings_.count();
+  strings_ << string;
+  string_ids_.insert(string, id);
+  return id;
+}
+
+void LibrarySongIndex::Append(const Song& song) {
+  rows_[song.id()] = ids_.count();
+  ids_ << song.id();
+  for (int i = 0; i < FieldCount; ++i) fields_[i] << 0;
+  compilations_ << false;
+  ctimes_ << 0;
+  Set(ids_.count() - 1, song);
+}
+
+void LibrarySongIndex::Set(int row, const Song& song) {
+  fields_[Field_Artist][row] = Intern(song.artist());
+  fields_[Field_Album][row] = Intern(song.album());
+  fields_[Field_EffectiveAlbumArtist][row] =
+      Intern(song.effective_albumartist());
+  fields_[Field_Composer][row] = Intern(song.composer());
+  fields_[Field_Performer][row] = Intern(song.performer());
+  fields_[Field_Grouping][row] = Intern(song.grouping());
+  fields_[Field_Genre][row] = Intern(song.genre());
+  fields_[Field_Year][row] = song.year();
+  fields_[Field_Disc][row] = song.disc();
+  fields_[Field_Bitrate][row] = song.bitrate();
+  fields_[Field_FileType][row] = song.filetype();
+  compilations_[row] = song.is_compilation();
+  ctimes_[row] = song.ctime();
+}
+
+void LibrarySongIndex::RemoveRow(int row) {
+  // Move the last row into this one so the arrays stay contiguous.
+  const int last = ids_.count() - 1;
+  rows_.remove(ids_[row]);
+  if (row != last) {
+    ids_[row] = ids_[last];
+    for (int i = 0; i < FieldCount; ++i) fields_[i][row] = fields_[i][last];
+    compilations_[row] = compilations_[last];
+    ctimes_[row] = ctimes_[last];
+    rows_[ids_[row]] = row;
+  }
+
+  ids_.resize(last);
+  for (int i = 0; i < FieldCount; ++i) fields_[i].resize(last);
+  compilations_.resize(last);
+  ctimes_.resize(last);
+}
+
+void LibrarySongIndex::AddOrUpdate(const SongList& songs) {
+  QMutexLocker l(&mutex_);
+  if (!loaded_) return;
+
+  for (const Song& song : songs) {
+    if (song.id() == -1) continue;
+
+    QHash<int, int>::const_iterator it = rows_.constFind(song.id());
+    if (song.is_unavailable()) {
+      if (it != rows_.constEnd()) RemoveRow(it.value());
+    } else if (it == rows_.constEnd()) {
+      Append(song);
+    } else {
+      Set(it.value(), song);
+    }
+  }
+}
+
+void LibrarySongIndex::Remove(const SongList& songs) {
+  QMutexLocker l(&mutex_);
+  if (!loaded_) return;
+
+  for (const Song& song : songs) {
+    QHash<int, int>::const_iterator it = rows_.constFind(song.id());
+    if (it != rows_.constEnd()) RemoveRow(it.value());
+  }
+}
+
+LibrarySongIndex::CompiledQuery LibrarySongIndex::Compile(
+    const Query& query) const {
+  CompiledQuery ret;
+  ret.matches_nothing_ = false;
+  ret.min_ctime_ = 0;
+
+  if (query.require_compilation_ && query.require_not_compilation_) {
+    ret.matches_nothing_ = true;
+  }
+  ret.compilation_ = query.require_compilation_
+                         ? 1
+                         : query.require_not_compilation_ ? 0 : -1;
+
+  if (query.max_age_ != -1) {
+    ret.min_ctime_ =
+        QDateTime::currentDateTime().toTime_t() - query.max_age_ + 1;
+  }
+
+  for (const QPair<QString, QVariant>& where : query.where_) {
+    const int field = FieldForColumn(where.first);
+    if (field == -1) {
+      qLog(Error) << "Column" << where.first << "isn't in the song index";
+      ret.matches_nothing_ = true;
+      continue;
+    }
+
+    int value;
+    if (field < kFirstIntField) {
+      // A string nobody has can't match anything.
+      QHash<QString, int>::const_iterator it =
+          string_ids_.constFind(where.second.toString());
+      if (it == string_ids_.constEnd()) {
+        ret.matches_nothing_ = true;
+        continue;
+      }
+      value = it.value();
+    } else {
+      value = where.second.toInt();
+    }
+    ret.conditions_ << qMakePair(field, value);
+  }
+
+  return ret;
+}
+
+bool LibrarySongIndex::Matches(const CompiledQuery& query, int row) const {
+  if (query.compilation_ != -1 &&
+      compilations_[row] != (query.compilation_ == 1)) {
+    return false;
+  }
+  if (ctimes_[row] < query.min_ctime_) return false;
+
+  for (const QPair<int, int>& condition : query.conditions_) {
+    if (fields_[condition.first][row] != condition.second) return false;
+  }
+  return true;
+}
+
+QVariant LibrarySongIndex::Value(int field, int row) const {
+  const int value = fields_[field][row];
+  if (field < kFirstIntField) return strings_[value];
+  return value;
+}
+
+QList<QVariantList> LibrarySongIndex::Distinct(const QStringList& columns,
+                                               const Query& query) const {
+  QMutexLocker l(&mutex_);
+  QList<QVariantList> ret;
+
+  // LibraryModel never asks for more than three columns at once.
+  QList<int> fields;
+  for (const QString& column : columns) {
+    const int field = FieldForColumn(column);
+    if (field == -1 || fields.count() == 3) {
+      qLog(Error) << "Can't select" << columns << "from the song index";
+      return ret;
+    }
+    fields << field;
+  }
+
+  const CompiledQuery compiled = Compile(query);
+  if (compiled.matches_nothing_) return ret;
+
+  typedef QPair<int, QPair<int, int> > Key;
+  QSet<Key> seen;
+
+  const int count = ids_.count();
+  for (int row = 0; row < count; ++row) {
+    if (!Matches(compiled, row)) continue;
+
+    int values[3] = {0, 0, 0};
+    for (int i = 0; i < fields.count(); ++i) {
+      values[i] = fields_[fields[i]][row];
+    }
+
+    const Key key = qMakePair(values[0], qMakePair(values[1], values[2]));
+    if (seen.contains(key)) continue;
+    seen.insert(key);
+
+    QVariantList result;
+    for (int field : fields) {
+      result << Value(field, row);
+    }
+    ret << result;
+  }
+
+  return ret;
+}
+
+QList<int> LibrarySongIndex::SongIds(const Query& query) const {
+  QMutexLocker l(&mutex_);
+  QList<int> ret;
+
+  const CompiledQuery compiled = Compile(query);
+  if (compiled.matches_nothing_) return ret;
+
+  const int count = ids_.count();
+  for (int row = 0; row < count; ++row) {
+    if (Matches(compiled, row)) ret << ids_[row];
+  }
+  return ret;
+}
+
+bool LibrarySongIndex::Contains(const Query& query) const {
+  QMutexLocker l(&mutex_);
+
+  const CompiledQuery compiled = Compile(query);
+  if (compiled.matches_nothing_) return false;
+
+  const int count = ids_.count();
+  for (int row = 0; row < count; ++row) {
+    if (Matches(compiled, row)) return true;
+  }
+  return false;
+}
@@ -0,0 +1,145 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYSONGINDEX_H
+#define LIBRARYSONGINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include "core/song.h"
+
+class LibraryBackend;
+
+// An in-memory copy of the columns LibraryModel groups by, for every
+// available song in a library.  Each column is a contiguous array and strings
+// are interned, so working out the distinct artists or albums under a node
+// is a scan over a few arrays of ints rather than a SQL query.
+//
+// The index is loaded from the database the first time it's needed and kept
+// up to date by the model from the backend's SongsDiscovered and SongsDeleted
+// signals.  All the methods are thread-safe.
+class LibrarySongIndex {
+ public:
+  LibrarySongIndex();
+
+  // The same subset of LibraryQuery that LibraryModel uses to filter a node's
+  // children.  Columns are named like the columns of the songs table.
+  class Query {
+   public:
+    Query();
+
+    void AddWhere(const QString& column, const QVariant& value);
+    void AddCompilationRequirement(bool compilation);
+    void SetMaxAge(int max_age);
+
+   private:
+    friend class LibrarySongIndex;
+
+    QList<QPair<QString, QVariant> > where_;
+    bool require_compilation_;
+    bool require_not_compilation_;
+    int max_age_;
+  };
+
+  bool is_loaded() const;
+
+  // Reads every available song from the backend, unless the index is already
+  // loaded.
+  void Load(LibraryBackend* backend);
+  // Forgets everything.  The next Load() reads the database again.
+  void Clear();
+
+  // These do nothing until the index has been loaded.
+  void AddOrUpdate(const SongList& songs);
+  void Remove(const SongList& songs);
+
+  // Returns each distinct combination of the columns among the songs that
+  // match the query, in the same form as a SELECT DISTINCT would.
+  QList<QVariantList> Distinct(const QStringList& columns,
+                               const Query& query) const;
+  // Returns the IDs of the songs that match the query.
+  QList<int> SongIds(const Query& query) const;
+  bool Contains(const Query& query) const;
+
+ private:
+  enum Field {
+    // String fields
+    Field_Artist = 0,
+    Field_Album,
+    Field_EffectiveAlbumArtist,
+    Field_Composer,
+    Field_Performer,
+    Field_Grouping,
+    Field_Genre,
+
+    // Integer fields
+    Field_Year,
+    Field_Disc,
+    Field_Bitrate,
+    Field_FileType,
+
+    FieldCount
+  };
+  static const int kFirstIntField = Field_Year;
+  static const char* kFieldColumns[];
+
+  // A query with its columns and values turned into field indexes and
+  // interned string IDs.
+  struct CompiledQuery {
+    QList<QPair<int, int> > conditions_;
+    int compilation_;  // -1 if it doesn't matter
+    uint min_ctime_;
+    bool matches_nothing_;
+  };
+
+  static int FieldForColumn(const QString& column);
+
+  CompiledQuery Compile(const Query& query) const;
+  bool Matches(const CompiledQuery& query, int row) const;
+  QVariant Value(int field, int row) const;
+
+  void ClearLocked();
+  int Intern(const QString& string);
+  void Append(const Song& song);
+  void Set(int row, const Song& song);
+  void RemoveRow(int row);
+
+  mutable QMutex mutex_;
+  bool loaded_;
+
+  // Interned strings.  These are never freed until the next Load().
+  QVector<QString> strings_;
+  QHash<QString, int> string_ids_;
+
+  // One entry per song in each of these.
+  QVector<int> ids_;
+  QVector<int> fields_[FieldCount];
+  QVector<bool> compilations_;
+  QVector<uint> ctimes_;
+
+  // Song ID -> row
+  QHash<int, int> rows_;
+};
+
+#endif  // LIBRARYSONGINDEX_H
@@ -22,9 +22,11 @@
 #include <QHelpEvent>
 #include <QMenu>
 #include <QMessageBox>
+#include <QScrollBar>
 #include <QSet>
 #include <QSettings>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QToolTip>
 #include <QWhatsThis>
 
@@ -49,6 +51,7 @@
 using smart_playlists::Wizard;
 
 const char* LibraryView::kSettingsGroup = "LibraryView";
+const int LibraryView::kPrefetchRows = 20;
 
 LibraryItemDelegate::LibraryItemDelegate(QObject* parent)
     : QStyledItemDelegate(parent) {}
@@ -168,7 +171,8 @@ LibraryView::LibraryView(QWidget* parent)
       total_song_count_(-1),
       nomusic_(":nomusic.png"),
       context_menu_(nullptr),
-      is_in_keyboard_search_(false) {
+      is_in_keyboard_search_(false),
+      prefetch_timer_(new QTimer(this)) {
   setItemDelegate(new LibraryItemDelegate(this));
   setAttribute(Qt::WA_MacShowFocusRect, false);
   setHeaderHidden(true);
@@ -178,6 +182,16 @@ LibraryView::LibraryView(QWidget* parent)
   setSelectionMode(QAbstractItemView::ExtendedSelection);
 
   setStyleSheet("QTreeView::item{padding-top:1px;}");
+
+  // Prefetch once per event loop iteration, however many times the view
+  // scrolled or changed size during it.
+  prefetch_timer_->setSingleShot(true);
+  prefetch_timer_->setInterval(0);
+  connect(prefetch_timer_, SIGNAL(timeout()), SLOT(PrefetchAlbumIcons()));
+  connect(verticalScrollBar(), SIGNAL(valueChanged(int)), prefetch_timer_,
+          SLOT(start()));
+  connect(verticalScrollBar(), SIGNAL(rangeChanged(int, int)),
+          prefetch_timer_, SLOT(start()));
 }
 
 LibraryView::~LibraryView() {}
@@ -302,6 +316,8 @@ void LibraryView::ReloadSettings() {
         s.value("pretty_covers", true).toBool());
     app_->library_model()->set_show_dividers(
         s.value("show_dividers", true).toBool());
+    app_->library_model()->set_use_song_index(
+        s.value("song_index", true).toBool());
   }
 }
 
@@ -354,6 +370,36 @@ void LibraryView::paintEvent(QPaintEvent* event) {
   }
 }
 
+void LibraryView::PrefetchAlbumIcons() {
+  if (!app_ || !app_->library_model()->use_pretty_covers()) return;
+
+  QSortFilterProxyModel* proxy =
+      qobject_cast<QSortFilterProxyModel*>(model());
+  if (!proxy) return;
+
+  const QRect rect = viewport()->rect();
+  const QModelIndex top = indexAt(QPoint(rect.center().x(), rect.top()));
+  if (!top.isValid()) return;
+
+  QModelIndexList indexes;
+  QModelIndex index = top;
+  for (int i = 0; i < kPrefetchRows; ++i) {
+    index = indexAbove(index);
+    if (!index.isValid()) break;
+    indexes << proxy->mapToSource(index);
+  }
+
+  // The visible rows, then kPrefetchRows more.
+  int rows_below = 0;
+  for (index = top; index.isValid() && rows_below < kPrefetchRows;
+       index = indexBelow(index)) {
+    indexes << proxy->mapToSource(index);
+    if (visualRect(index).top() > rect.bottom()) ++rows_below;
+  }
+
+  app_->library_model()->PrefetchAlbumIcons(indexes);
+}
+
 void LibraryView::mouseReleaseEvent(QMouseEvent* e) {
   QTreeView::mouseReleaseEvent(e);
 
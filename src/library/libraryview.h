@@ -29,6 +29,7 @@
 class Application;
 class LibraryFilterWidget;
 class OrganiseDialog;
+class QTimer;
 
 class QMimeData;
 
@@ -58,6 +59,10 @@ class LibraryView : public AutoExpandingTreeView {
 
   static const char* kSettingsGroup;
 
+  // The number of rows above and below the viewport to prefetch album icons
+  // for.
+  static const int kPrefetchRows;
+
   // Returns Songs currently selected in the library view. Please note that the
   // selection is recursive meaning that if for example an album is selected
   // this will return all of it's songs.
@@ -110,6 +115,8 @@ signals:
 
   void DeleteFinished(const SongList& songs_with_errors);
 
+  void PrefetchAlbumIcons();
+
  private:
   void RecheckIsEmpty();
   void ShowInVarious(bool on);
@@ -148,6 +155,8 @@ signals:
 
   bool is_in_keyboard_search_;
 
+  QTimer* prefetch_timer_;
+
   // Save focus
   Song last_selected_song_;
   QString last_selected_container_;
@@ -18,6 +18,8 @@
 #include "librarywatcher.h"
 
 #include "librarybackend.h"
+#include "librarychangejournal.h"
+#include "core/contentid.h"
 #include "core/filesystemwatcherinterface.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
@@ -26,10 +28,9 @@
 #include "playlistparsers/cueparser.h"
 
 #include <QDateTime>
-#include <QDirIterator>
+#include <QFileInfo>
 #include <QtDebug>
 #include <QThread>
-#include <QDateTime>
 #include <QHash>
 #include <QSet>
 #include <QSettings>
@@ -46,15 +47,25 @@
 QStringList LibraryWatcher::sValidImages;
 
 const char* LibraryWatcher::kSettingsGroup = "LibraryWatcher";
+const int LibraryWatcher::kReadAheadPerWorker = 32;
+const int LibraryWatcher::kReadBatchSize = 16;
+const int LibraryWatcher::kAudioPropertiesDelayMsec = 2000;
 
 LibraryWatcher::LibraryWatcher(QObject* parent)
     : QObject(parent),
       backend_(nullptr),
       task_manager_(nullptr),
+      change_journal_(nullptr),
       fs_watcher_(FileSystemWatcherInterface::Create(this)),
       stop_requested_(false),
       scan_on_startup_(true),
       monitor_(true),
+      pipelined_scan_(true),
+      read_ahead_(1),
+      use_change_journal_(false),
+      defer_audio_properties_(true),
+      audio_properties_timer_(new QTimer(this)),
+      extract_embedded_art_(true),
       rescan_timer_(new QTimer(this)),
       rescan_paused_(false),
       total_watches_(0),
@@ -64,6 +75,8 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
   rescan_timer_->setInterval(1000);
   rescan_timer_->setSingleShot(true);
 
+  audio_properties_timer_->setSingleShot(true);
+
   if (sValidImages.isEmpty()) {
     sValidImages << "jpg"
                  << "png"
@@ -74,6 +87,8 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
   ReloadSettings();
 
   connect(rescan_timer_, SIGNAL(timeout()), SLOT(RescanPathsNow()));
+  connect(audio_properties_timer_, SIGNAL(timeout()),
+          SLOT(ReadAudioPropertiesNow()));
 }
 
 LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
@@ -81,26 +96,49 @@ LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
                                                  bool ignores_mtime)
     : progress_(0),
       progress_max_(0),
+      pending_files_(0),
+      files_read_(0),
+      read_tags_only_(false),
+      last_rate_update_(0),
       dir_(dir),
       incremental_(incremental),
       ignores_mtime_(ignores_mtime),
       watcher_(watcher),
       cached_songs_dirty_(true),
+      move_candidates_dirty_(true),
       known_subdirs_dirty_(true) {
-  QString description;
   if (watcher_->device_name_.isEmpty())
-    description = tr("Updating library");
+    task_description_ = tr("Updating library");
   else
-    description = tr("Updating %1").arg(watcher_->device_name_);
+    task_description_ = tr("Updating %1").arg(watcher_->device_name_);
 
-  task_id_ = watcher_->task_manager_->StartTask(description);
+  task_id_ = watcher_->task_manager_->StartTask(task_description_);
   emit watcher_->ScanStarted(task_id_);
+
+  files_read_timer_.start();
 }
 
 LibraryWatcher::ScanTransaction::~ScanTransaction() {
+  // Outstanding replies must be waited for even when stopping, since the
+  // worker pool still holds pointers to them.
+  SendQueuedReads();
+  FlushPendingReads();
+
   // If we're stopping then don't commit the transaction
   if (watcher_->stop_requested_) return;
 
+  FinishContentIdBackfill();
+
+  // Songs that were moved have been updated in place, so they weren't really
+  // deleted.
+  if (!moved_song_ids_.isEmpty()) {
+    SongList really_deleted;
+    for (const Song& song : deleted_songs) {
+      if (!moved_song_ids_.contains(song.id())) really_deleted << song;
+    }
+    deleted_songs = really_deleted;
+  }
+
   if (!new_songs.isEmpty()) emit watcher_->NewOrUpdatedSongs(new_songs);
 
   if (!touched_songs.isEmpty()) emit watcher_->SongsMTimeUpdated(touched_songs);
@@ -114,8 +152,17 @@ LibraryWatcher::ScanTransaction::~ScanTransaction() {
   if (!touched_subdirs.isEmpty())
     emit watcher_->SubdirsMTimeUpdated(touched_subdirs);
 
+  if (!embedded_art_files.isEmpty())
+    emit watcher_->EmbeddedArtFound(embedded_art_files);
+
   watcher_->task_manager_->SetTaskFinished(task_id_);
 
+  // Fill in the audio properties of the songs we just added once the backend
+  // has had a chance to store them.
+  if (read_tags_only_ && !watcher_->audio_properties_timer_->isActive()) {
+    watcher_->audio_properties_timer_->start(kAudioPropertiesDelayMsec);
+  }
+
   if (watcher_->monitor_) {
     // Watch the new subdirectories
     for (const Subdirectory& subdir : new_subdirs) {
@@ -134,6 +181,106 @@ void LibraryWatcher::ScanTransaction::AddToProgressMax(int n) {
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 }
 
+void LibraryWatcher::ScanTransaction::QueueRead(const QString& file,
+                                                const QString& image,
+                                                const Song& matching_song,
+                                                bool is_new) {
+  PendingRead read;
+  read.file_ = file;
+  read.image_ = image;
+  read.matching_song_ = matching_song;
+  read.is_new_ = is_new;
+  queued_reads_ << read;
+
+  if (queued_reads_.count() >= qMin(kReadBatchSize, watcher_->read_ahead_)) {
+    SendQueuedReads();
+  }
+}
+
+void LibraryWatcher::ScanTransaction::SendQueuedReads() {
+  if (queued_reads_.isEmpty()) return;
+
+  // Make room in the read-ahead window for this batch.
+  FlushPendingReads(qMax(0, watcher_->read_ahead_ - queued_reads_.count()));
+
+  // Songs that are already in the library are always read completely, so
+  // their audio properties are never out of date.
+  bool tags_only = watcher_->defer_audio_properties_;
+  QStringList filenames;
+  for (const PendingRead& read : queued_reads_) {
+    filenames << read.file_;
+    tags_only = tags_only && read.is_new_;
+  }
+  read_tags_only_ = read_tags_only_ || tags_only;
+
+  PendingBatch batch;
+  batch.reply_ = TagReaderClient::Instance()->ReadFiles(
+      filenames, tags_only, _WorkerPoolBase::Priority_Bulk, true);
+  batch.reads_ = queued_reads_;
+  pending_batches_.enqueue(batch);
+  pending_files_ += queued_reads_.count();
+  queued_reads_.clear();
+
+  if (!watcher_->pipelined_scan_) FlushPendingReads();
+}
+
+void LibraryWatcher::ScanTransaction::FlushPendingReads(int max_pending) {
+  while (!pending_batches_.isEmpty() && pending_files_ > max_pending) {
+    PendingBatch batch = pending_batches_.dequeue();
+    pending_files_ -= batch.reads_.count();
+    FinishBatch(batch);
+  }
+}
+
+void LibraryWatcher::ScanTransaction::FinishBatch(const PendingBatch& batch) {
+  const bool success = batch.reply_->WaitForFinished();
+  const pb::tagreader::ReadFilesResponse& response =
+      batch.reply_->message().read_files_response();
+
+  for (int i = 0; i < batch.reads_.count(); ++i) {
+    Song song;
+    song.set_directory_id(dir_);
+    if (success && i < response.metadata_size()) {
+      song.InitFromProtobuf(response.metadata(i));
+    }
+    FinishRead(batch.reads_[i], &song);
+  }
+  batch.reply_->deleteLater();
+
+  files_read_ += batch.reads_.count();
+  UpdateTaskName();
+}
+
+void LibraryWatcher::ScanTransaction::FinishRead(const PendingRead& read,
+                                                 Song* song) {
+  if (watcher_->stop_requested_ || !song->is_valid()) return;
+
+  if (read.is_new_) {
+    qLog(Debug) << read.file_ << "created";
+    if (song->art_automatic().isEmpty()) song->set_art_automatic(read.image_);
+    new_songs << *song;
+  } else {
+    watcher_->PreserveUserSetData(read.file_, read.image_, read.matching_song_,
+                                  song, this);
+  }
+
+  if (watcher_->extract_embedded_art_ && song->has_embedded_cover()) {
+    embedded_art_files << read.file_;
+  }
+}
+
+void LibraryWatcher::ScanTransaction::UpdateTaskName() {
+  // Don't flood the task manager - once a second is plenty.
+  const int elapsed = files_read_timer_.elapsed();
+  if (elapsed - last_rate_update_ < 1000) return;
+  last_rate_update_ = elapsed;
+
+  const int files_per_second = files_read_ * 1000 / qMax(1, elapsed);
+  watcher_->task_manager_->SetTaskName(
+      task_id_,
+      tr("%1 (%2 files/s)").arg(task_description_).arg(files_per_second));
+}
+
 SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(
     const QString& path) {
   if (cached_songs_dirty_) {
@@ -149,6 +296,75 @@ SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(
   return ret;
 }
 
+bool LibraryWatcher::ScanTransaction::FindMovedSong(const QString& file,
+                                                   qint64 size, Song* out) {
+  if (move_candidates_dirty_) {
+    if (cached_songs_dirty_) {
+      cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_);
+      cached_songs_dirty_ = false;
+    }
+    for (const Song& song : cached_songs_) {
+      // Cue sections share a file, so they can't be moved one at a time.
+      if (song.content_id().isEmpty() || song.has_cue()) continue;
+      move_candidates_.insert(song.filesize(), song);
+    }
+    move_candidates_dirty_ = false;
+  }
+
+  // Only songs of the same size whose old file is gone can have been moved
+  // here.  If the old file is still there then this is a copy, not a move.
+  // Each old file is only looked for once per transaction.
+  SongList candidates;
+  for (const Song& song : move_candidates_.values(size)) {
+    if (moved_song_ids_.contains(song.id())) continue;
+
+    QHash<int, bool>::iterator missing = candidate_missing_.find(song.id());
+    if (missing == candidate_missing_.end()) {
+      missing = candidate_missing_.insert(
+          song.id(), !QFile::exists(song.url().toLocalFile()));
+    }
+    if (missing.value()) candidates << song;
+  }
+
+  // Only read the file if there's something it could be.
+  if (candidates.isEmpty()) return false;
+
+  const QString content_id = ContentId::ForFile(file);
+  if (content_id.isEmpty()) return false;
+
+  for (const Song& song : candidates) {
+    if (song.content_id() != content_id) continue;
+
+    moved_song_ids_.insert(song.id());
+    *out = song;
+    return true;
+  }
+  return false;
+}
+
+void LibraryWatcher::ScanTransaction::BackfillContentId(const Song& song) {
+  content_id_backfill_ << song;
+}
+
+void LibraryWatcher::ScanTransaction::FinishContentIdBackfill() {
+  if (content_id_backfill_.isEmpty()) return;
+
+  QStringList filenames;
+  for (const Song& song : content_id_backfill_) {
+    filenames << song.url().toLocalFile();
+  }
+  const QStringList content_ids =
+      TagReaderClient::Instance()->ReadContentIdsBlocking(filenames);
+
+  for (int i = 0; i < content_id_backfill_.count(); ++i) {
+    if (content_ids[i].isEmpty()) continue;
+    Song song(content_id_backfill_[i]);
+    song.set_content_id(content_ids[i]);
+    touched_songs << song;
+  }
+  content_id_backfill_.clear();
+}
+
 void LibraryWatcher::ScanTransaction::SetKnownSubdirs(
     const SubdirectoryList& subdirs) {
   known_subdirs_ = subdirs;
@@ -198,18 +414,57 @@ void LibraryWatcher::AddDirectory(const Directory& dir,
     transaction.SetKnownSubdirs(subdirs);
     transaction.AddToProgressMax(1);
     ScanSubdirectory(dir.path, Subdirectory(), &transaction);
+  } else if (scan_on_startup_ && CanUseChangeJournal(dir)) {
+    // Clementine was shut down cleanly and was watching the whole time, so
+    // the journal knows exactly which subdirectories changed.  Don't even
+    // look at the others.
+    SubdirectoryList dirty_subdirs;
+    for (const Subdirectory& subdir : subdirs) {
+      if (change_journal_->IsDirty(subdir.path)) dirty_subdirs << subdir;
+      if (monitor_) AddWatch(dir, subdir.path);
+    }
+    qLog(Debug) << "Change journal has" << dirty_subdirs.count() << "of"
+                << subdirs.count() << "subdirs of" << dir.path << "dirty";
+
+    {
+      ScanTransaction transaction(this, dir.id, false);
+      transaction.SetKnownSubdirs(subdirs);
+      transaction.AddToProgressMax(dirty_subdirs.count());
+      for (const Subdirectory& subdir : dirty_subdirs) {
+        if (stop_requested_) return;
+        ScanSubdirectory(subdir.path, subdir, &transaction);
+      }
+    }
+
+    for (const Subdirectory& subdir : dirty_subdirs) {
+      change_journal_->MarkClean(subdir.path);
+    }
   } else {
     // We can do an incremental scan - looking at the mtimes of each
     // subdirectory and only rescan if the directory has changed.
-    ScanTransaction transaction(this, dir.id, true);
-    transaction.SetKnownSubdirs(subdirs);
-    transaction.AddToProgressMax(subdirs.count());
-    for (const Subdirectory& subdir : subdirs) {
-      if (stop_requested_) return;
+    if (change_journal_ && scan_on_startup_) {
+      change_journal_->SetFullScanPending(dir.path, true);
+    }
 
-      if (scan_on_startup_) ScanSubdirectory(subdir.path, subdir, &transaction);
+    {
+      ScanTransaction transaction(this, dir.id, true);
+      transaction.SetKnownSubdirs(subdirs);
+      transaction.AddToProgressMax(subdirs.count());
+      for (const Subdirectory& subdir : subdirs) {
+        if (stop_requested_) return;
 
-      if (monitor_) AddWatch(dir, subdir.path);
+        if (scan_on_startup_)
+          ScanSubdirectory(subdir.path, subdir, &transaction);
+
+        if (monitor_) AddWatch(dir, subdir.path);
+      }
+    }
+
+    if (change_journal_ && scan_on_startup_) {
+      for (const Subdirectory& subdir : subdirs) {
+        change_journal_->MarkClean(subdir.path);
+      }
+      change_journal_->SetFullScanPending(dir.path, false);
     }
   }
 
@@ -220,11 +475,19 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
                                       const Subdirectory& subdir,
                                       ScanTransaction* t,
                                       bool force_noincremental) {
-  QFileInfo path_info(path);
+  ScanSubdirectory(DirectoryListing::Stat(path), subdir, t,
+                   force_noincremental);
+}
+
+void LibraryWatcher::ScanSubdirectory(const DirectoryListing::Entry& path_info,
+                                      const Subdirectory& subdir,
+                                      ScanTransaction* t,
+                                      bool force_noincremental) {
+  const QString& path = path_info.path_;
 
   // Do not scan symlinked dirs that are already in collection
-  if (path_info.isSymLink()) {
-    QString real_path = path_info.symLinkTarget();
+  if (path_info.is_symlink_) {
+    QString real_path = QFileInfo(path).symLinkTarget();
     for (const Directory& dir : watched_dirs_) {
       if (real_path.startsWith(dir.path)) {
         t->AddToProgress(1);
@@ -234,7 +497,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   }
 
   if (!t->ignores_mtime() && !force_noincremental && t->is_incremental() &&
-      subdir.mtime == path_info.lastModified().toTime_t()) {
+      subdir.mtime == path_info.mtime_) {
     // The directory hasn't changed since last time
     t->AddToProgress(1);
     return;
@@ -242,16 +505,23 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
   QMap<QString, QStringList> album_art;
   QStringList files_on_disk;
-  SubdirectoryList my_new_subdirs;
+  QList<DirectoryListing::Entry> my_new_subdirs;
+
+  // List the directory once.  Everything below asks this listing about the
+  // files in it instead of going back to the filesystem, which on a network
+  // share is a round trip per question.
+  const DirectoryListing listing(path);
 
   // If a directory is moved then only its parent gets a changed notification,
   // so we need to look and see if any of our children don't exist any more.
   // If one has been removed, "rescan" it to get the deleted songs
   SubdirectoryList previous_subdirs = t->GetImmediateSubdirs(path);
   for (const Subdirectory& subdir : previous_subdirs) {
-    if (!QFile::exists(subdir.path) && subdir.path != path) {
+    if (!listing.Contains(subdir.path) && subdir.path != path) {
       t->AddToProgressMax(1);
-      ScanSubdirectory(subdir.path, subdir, t, true);
+      DirectoryListing::Entry missing;
+      missing.path_ = subdir.path;
+      ScanSubdirectory(missing, subdir, t, true);
     }
   }
 
@@ -259,23 +529,16 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // think might be music.  While we're here, we also look for new
   // subdirectories
   // and possible album artwork.
-  QDirIterator it(
-      path, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
-  while (it.hasNext()) {
+  for (const DirectoryListing::Entry& child_info : listing.entries()) {
     if (stop_requested_) return;
 
-    QString child(it.next());
-    QFileInfo child_info(child);
+    const QString& child = child_info.path_;
 
-    if (child_info.isDir()) {
-      if (!child_info.isHidden() && !t->HasSeenSubdir(child)) {
+    if (child_info.is_dir_) {
+      if (!child_info.is_hidden() && !t->HasSeenSubdir(child)) {
         // We haven't seen this subdirectory before - add it to a list and
         // later we'll tell the backend about it and scan it.
-        Subdirectory new_subdir;
-        new_subdir.directory_id = -1;
-        new_subdir.path = child;
-        new_subdir.mtime = child_info.lastModified().toTime_t();
-        my_new_subdirs << new_subdir;
+        my_new_subdirs << child_info;
       }
     } else {
       QString ext_part(ExtensionPart(child));
@@ -283,7 +546,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
       if (sValidImages.contains(ext_part))
         album_art[dir_part] << child;
-      else if (!child_info.isHidden())
+      else if (!child_info.is_hidden())
         files_on_disk << child;
     }
   }
@@ -302,24 +565,17 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     // associated cue
     QString matching_cue = NoExtensionPart(file) + ".cue";
 
+    uint matching_cue_mtime = GetMtimeForCue(matching_cue, listing);
+    const DirectoryListing::Entry* file_info = listing.Find(file);
+
     Song matching_song;
     if (FindSongByPath(songs_in_db, file, &matching_song)) {
-      uint matching_cue_mtime = GetMtimeForCue(matching_cue);
-
       // The song is in the database and still on disk.
       // Check the mtime to see if it's been changed since it was added.
-      QFileInfo file_info(file);
-
-      if (!file_info.exists()) {
-        // Partially fixes race condition - if file was removed between being
-        // added to the list and now.
-        files_on_disk.removeAll(file);
-        continue;
-      }
 
       // cue sheet's path from library (if any)
       QString song_cue = matching_song.cue_path();
-      uint song_cue_mtime = GetMtimeForCue(song_cue);
+      uint song_cue_mtime = GetMtimeForCue(song_cue, listing);
 
       bool cue_deleted = song_cue_mtime == 0 && matching_song.has_cue();
       bool cue_added = matching_cue_mtime != 0 && !matching_song.has_cue();
@@ -327,8 +583,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
       // watch out for cue songs which have their mtime equal to
       // qMax(media_file_mtime, cue_sheet_mtime)
       bool changed =
-          (matching_song.mtime() !=
-           qMax(file_info.lastModified().toTime_t(), song_cue_mtime)) ||
+          (matching_song.mtime() != qMax(file_info->mtime_, song_cue_mtime)) ||
           cue_deleted || cue_added;
 
       // Also want to look to see whether the album art has changed
@@ -336,7 +591,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
       if ((matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
           (!matching_song.art_automatic().isEmpty() &&
            !matching_song.has_embedded_cover() &&
-           !QFile::exists(matching_song.art_automatic()))) {
+           !FileExists(matching_song.art_automatic(), listing))) {
         changed = true;
       }
 
@@ -352,6 +607,9 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
           UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted,
                                      t);
         }
+      } else if (matching_song.content_id().isEmpty() &&
+                 !matching_song.has_cue()) {
+        t->BackfillContentId(matching_song);
       }
 
       // nothing has changed - mark the song available without re-scanning
@@ -359,16 +617,41 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
     } else {
       // The song is on disk but not in the DB
-      SongList song_list =
-          ScanNewFile(file, path, matching_cue, &cues_processed);
+      // choose an image for the song(s)
+      QString image = ImageForSong(file, album_art);
+
+      // It might be a song we already know about that's been moved or
+      // renamed.  If so just update its path - there's no need to read the
+      // file again, and the user's play counts and ratings are kept.
+      Song moved_song;
+      if (matching_cue_mtime == 0 &&
+          t->FindMovedSong(file, file_info->size_, &moved_song)) {
+        qLog(Debug) << moved_song.url().toLocalFile() << "moved to" << file;
+
+        moved_song.set_url(QUrl::fromLocalFile(file));
+        moved_song.set_basefilename(file_info->name_);
+        moved_song.set_directory_id(t->dir());
+        moved_song.set_mtime(file_info->mtime_);
+        moved_song.set_unavailable(false);
+        if (!moved_song.has_embedded_cover()) {
+          moved_song.set_art_automatic(image);
+        } else if (extract_embedded_art_) {
+          // The copy of the art is keyed by path, so it needs making again.
+          t->embedded_art_files << file;
+        }
+        t->new_songs << moved_song;
+        continue;
+      }
+
+      SongList song_list = ScanNewFile(file, path, matching_cue,
+                                       matching_cue_mtime, image,
+                                       &cues_processed, t);
 
       if (song_list.isEmpty()) {
         continue;
       }
 
       qLog(Debug) << file << "created";
-      // choose an image for the song(s)
-      QString image = ImageForSong(file, album_art);
 
       for (Song song : song_list) {
         song.set_directory_id(t->dir());
@@ -379,6 +662,10 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     }
   }
 
+  // Send whatever is left of this directory's files to the tagreader.  The
+  // replies are collected later, while we're scanning other directories.
+  t->SendQueuedReads();
+
   // Look for deleted songs
   for (const Song& song : songs_in_db) {
     if (!song.is_unavailable() &&
@@ -391,8 +678,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // Add this subdir to the new or touched list
   Subdirectory updated_subdir;
   updated_subdir.directory_id = t->dir();
-  updated_subdir.mtime =
-      path_info.exists() ? path_info.lastModified().toTime_t() : 0;
+  updated_subdir.mtime = path_info.exists_ ? path_info.mtime_ : 0;
   updated_subdir.path = path;
 
   if (subdir.directory_id == -1)
@@ -404,9 +690,16 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
   // Recurse into the new subdirs that we found
   t->AddToProgressMax(my_new_subdirs.count());
-  for (const Subdirectory& my_new_subdir : my_new_subdirs) {
+  for (const DirectoryListing::Entry& my_new_subdir_info : my_new_subdirs) {
     if (stop_requested_) return;
-    ScanSubdirectory(my_new_subdir.path, my_new_subdir, t, true);
+
+    // We haven't seen this subdirectory before - the backend is told about it
+    // when the transaction is committed.
+    Subdirectory my_new_subdir;
+    my_new_subdir.directory_id = -1;
+    my_new_subdir.path = my_new_subdir_info.path_;
+    my_new_subdir.mtime = my_new_subdir_info.mtime_;
+    ScanSubdirectory(my_new_subdir_info, my_new_subdir, t, true);
   }
 }
 
@@ -467,21 +760,17 @@ void LibraryWatcher::UpdateNonCueAssociatedSong(const QString& file,
     }
   }
 
-  Song song_on_disk;
-  song_on_disk.set_directory_id(t->dir());
-  TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
-
-  if (song_on_disk.is_valid()) {
-    PreserveUserSetData(file, image, matching_song, &song_on_disk, t);
-  }
+  t->QueueRead(file, image, matching_song, false);
 }
 
 SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
                                      const QString& matching_cue,
-                                     QSet<QString>* cues_processed) {
+                                     uint matching_cue_mtime,
+                                     const QString& image,
+                                     QSet<QString>* cues_processed,
+                                     ScanTransaction* t) {
   SongList song_list;
 
-  uint matching_cue_mtime = GetMtimeForCue(matching_cue);
   // if it's a cue - create virtual tracks
   if (matching_cue_mtime) {
     // don't process the same cue many times
@@ -507,12 +796,7 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
 
     // it's a normal media file
   } else {
-    Song song;
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
-
-    if (song.is_valid()) {
-      song_list << song;
-    }
+    t->QueueRead(file, image, Song(), true);
   }
 
   return song_list;
@@ -548,20 +832,93 @@ void LibraryWatcher::PreserveUserSetData(const QString& file,
   }
 }
 
-uint LibraryWatcher::GetMtimeForCue(const QString& cue_path) {
+uint LibraryWatcher::GetMtimeForCue(const QString& cue_path,
+                                    const DirectoryListing& listing) {
   // slight optimisation
   if (cue_path.isEmpty()) {
     return 0;
   }
 
-  const QFileInfo file_info(cue_path);
-  if (!file_info.exists()) {
-    return 0;
+  // Cue sheets are nearly always next to their media file, so only go to the
+  // filesystem for ones that aren't.
+  if (listing.Covers(cue_path)) {
+    const DirectoryListing::Entry* entry = listing.Find(cue_path);
+    return entry ? entry->mtime_ : 0;
   }
 
-  const QDateTime cue_last_modified = file_info.lastModified();
+  const DirectoryListing::Entry file_info = DirectoryListing::Stat(cue_path);
+  return file_info.exists_ ? file_info.mtime_ : 0;
+}
 
-  return cue_last_modified.isValid() ? cue_last_modified.toTime_t() : 0;
+bool LibraryWatcher::FileExists(const QString& path,
+                                const DirectoryListing& listing) {
+  if (listing.Covers(path)) return listing.Contains(path);
+  return QFile::exists(path);
+}
+
+void LibraryWatcher::ReadAudioPropertiesNow() {
+  if (stop_requested_) return;
+
+  if (audio_properties_queue_.isEmpty()) {
+    for (const Directory& dir : watched_dirs_) {
+      for (const Song& song :
+           backend_->FindSongsWithoutAudioProperties(dir.id)) {
+        if (!audio_properties_failed_.contains(song.id())) {
+          audio_properties_queue_ << song;
+        }
+      }
+    }
+    if (audio_properties_queue_.isEmpty()) return;
+
+    qLog(Debug) << "Reading audio properties of"
+                << audio_properties_queue_.count() << "songs";
+  }
+
+  const SongList batch = audio_properties_queue_.mid(0, kReadBatchSize);
+  audio_properties_queue_ = audio_properties_queue_.mid(kReadBatchSize);
+
+  QStringList filenames;
+  for (const Song& song : batch) {
+    filenames << song.url().toLocalFile();
+  }
+
+  TagReaderReply* reply =
+      TagReaderClient::Instance()->ReadAudioProperties(filenames);
+  const bool success = reply->WaitForFinished();
+  const pb::tagreader::ReadAudioPropertiesResponse& response =
+      reply->message().read_audio_properties_response();
+
+  SongList updated;
+  for (int i = 0; i < batch.count(); ++i) {
+    Song song(batch[i]);
+    if (!success || i >= response.metadata_size()) {
+      // The worker crashed or timed out, which says nothing about the file.
+      // Leave it for the next time Clementine starts rather than trying it
+      // again and again now.
+      audio_properties_failed_ << song.id();
+      continue;
+    }
+
+    const pb::tagreader::SongMetadata& metadata = response.metadata(i);
+    if (metadata.valid()) {
+      song.set_length_nanosec(metadata.length_nanosec());
+      song.set_bitrate(metadata.bitrate());
+      song.set_samplerate(metadata.samplerate());
+    } else {
+      // TagLib can't read this file's audio properties.  It gets the same
+      // unknown values a full read would have given it, and isn't tried again.
+      song.set_length_nanosec(-1);
+      song.set_bitrate(-1);
+      song.set_samplerate(-1);
+    }
+    updated << song;
+  }
+  reply->deleteLater();
+
+  backend_->UpdateAudioProperties(updated);
+
+  // Go back to the event loop between batches so scans aren't held up.
+  if (!audio_properties_queue_.isEmpty()) audio_properties_timer_->start(0);
 }
 
 void LibraryWatcher::AddWatch(const Directory& dir, const QString& path) {
@@ -573,6 +930,12 @@ void LibraryWatcher::AddWatch(const Directory& dir, const QString& path) {
   subdir_mapping_[path] = dir;
 }
 
+bool LibraryWatcher::CanUseChangeJournal(const Directory& dir) const {
+  return change_journal_ && use_change_journal_ && monitor_ &&
+         change_journal_->was_clean_shutdown() &&
+         !change_journal_->IsFullScanPending(dir.path);
+}
+
 void LibraryWatcher::RemoveDirectory(const Directory& dir) {
   rescan_queue_.remove(dir.id);
   watched_dirs_.remove(dir.id);
@@ -611,22 +974,34 @@ void LibraryWatcher::DirectoryChanged(const QString& subdir) {
   // Queue the subdir for rescanning
   if (!rescan_queue_[dir.id].contains(subdir)) rescan_queue_[dir.id] << subdir;
 
+  // Remember it in case we're closed before the rescan is finished.
+  if (change_journal_) change_journal_->MarkDirty(subdir);
+
   if (!rescan_paused_) rescan_timer_->start();
 }
 
 void LibraryWatcher::RescanPathsNow() {
   for (int dir : rescan_queue_.keys()) {
     if (stop_requested_) return;
-    ScanTransaction transaction(this, dir, false);
-    transaction.AddToProgressMax(rescan_queue_[dir].count());
+    {
+      ScanTransaction transaction(this, dir, false);
+      transaction.AddToProgressMax(rescan_queue_[dir].count());
+
+      for (const QString& path : rescan_queue_[dir]) {
+        if (stop_requested_) return;
+        Subdirectory subdir;
+        subdir.directory_id = dir;
+        subdir.mtime = 0;
+        subdir.path = path;
+        ScanSubdirectory(path, subdir, &transaction);
+      }
+    }
 
-    for (const QString& path : rescan_queue_[dir]) {
-      if (stop_requested_) return;
-      Subdirectory subdir;
-      subdir.directory_id = dir;
-      subdir.mtime = 0;
-      subdir.path = path;
-      ScanSubdirectory(path, subdir, &transaction);
+    // The transaction has been committed, so these are up to date now.
+    if (change_journal_) {
+      for (const QString& path : rescan_queue_[dir]) {
+        change_journal_->MarkClean(path);
+      }
     }
   }
 
@@ -707,6 +1082,13 @@ void LibraryWatcher::ReloadSettings() {
   s.beginGroup(kSettingsGroup);
   scan_on_startup_ = s.value("startup_scan", true).toBool();
   monitor_ = s.value("monitor", true).toBool();
+  pipelined_scan_ = s.value("pipelined_scan", true).toBool();
+  use_change_journal_ = s.value("startup_scan_journal", false).toBool();
+  defer_audio_properties_ = s.value("defer_audio_properties", true).toBool();
+  extract_embedded_art_ = s.value("extract_embedded_art", true).toBool();
+  read_ahead_ = pipelined_scan_ ? qMax(1, QThread::idealThreadCount()) *
+                                      kReadAheadPerWorker
+                                : 1;
 
   best_image_filters_.clear();
   QStringList filters =
@@ -766,4 +1148,5 @@ void LibraryWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
   }
 
   emit CompilationsNeedUpdating();
+  emit ScanFinished();
 }
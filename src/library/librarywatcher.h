@@ -19,12 +19,17 @@
 #define LIBRARYWATCHER_H
 
 #include "directory.h"
+#include "directorylisting.h"
 #include "core/song.h"
+#include "core/tagreaderclient.h"
 
 #include <QHash>
 #include <QObject>
+#include <QQueue>
+#include <QSet>
 #include <QStringList>
 #include <QMap>
+#include <QTime>
 
 class QFileSystemWatcher;
 class QTimer;
@@ -32,6 +37,7 @@ class QTimer;
 class CueParser;
 class FileSystemWatcherInterface;
 class LibraryBackend;
+class LibraryChangeJournal;
 class TaskManager;
 
 class LibraryWatcher : public QObject {
@@ -42,6 +48,15 @@ class LibraryWatcher : public QObject {
 
   static const char* kSettingsGroup;
 
+  // The number of ReadFile requests kept in flight per tagreader worker during
+  // a pipelined scan.
+  static const int kReadAheadPerWorker;
+  // The maximum number of files sent in one ReadFiles request.
+  static const int kReadBatchSize;
+  // How long to wait after a scan before reading the audio properties of the
+  // songs it added.
+  static const int kAudioPropertiesDelayMsec;
+
   void set_backend(LibraryBackend* backend) { backend_ = backend; }
   void set_task_manager(TaskManager* task_manager) {
     task_manager_ = task_manager;
@@ -49,6 +64,10 @@ class LibraryWatcher : public QObject {
   void set_device_name(const QString& device_name) {
     device_name_ = device_name;
   }
+  // The journal is optional, and is owned by the caller.
+  void set_change_journal(LibraryChangeJournal* journal) {
+    change_journal_ = journal;
+  }
 
   void IncrementalScanAsync();
   void FullScanAsync();
@@ -65,8 +84,15 @@ signals:
   void SubdirsDiscovered(const SubdirectoryList& subdirs);
   void SubdirsMTimeUpdated(const SubdirectoryList& subdirs);
   void CompilationsNeedUpdating();
+  // Songs with art embedded in them were added or changed, so a copy of the
+  // art can be kept for showing it later.  Only emitted if the
+  // extract_embedded_art setting is on.
+  void EmbeddedArtFound(const QStringList& filenames);
 
   void ScanStarted(int task_id);
+  // Emitted when a full or incremental scan of every directory has finished
+  // and its results have been sent.
+  void ScanFinished();
 
  public slots:
   void ReloadSettings();
@@ -99,6 +125,29 @@ signals:
     void AddToProgress(int n = 1);
     void AddToProgressMax(int n);
 
+    // Adds the file to the current batch of files to read and remembers what
+    // to do with the result.  Batches are sent as one ReadFiles request when
+    // they are full or when SendQueuedReads() is called.  If the read-ahead
+    // window is full, the oldest outstanding requests are waited for first,
+    // so results are always applied in the order they were queued.
+    void QueueRead(const QString& file, const QString& image,
+                   const Song& matching_song, bool is_new);
+    void SendQueuedReads();
+    // Waits for outstanding requests until at most max_pending files remain.
+    void FlushPendingReads(int max_pending = 0);
+
+    // Looks for a song in this directory with the same contents as the file
+    // whose own file doesn't exist any more.  That song has been moved or
+    // renamed, so its row can be reused with the new path instead of
+    // reading the file again.  A song is only ever returned once, and it
+    // won't be reported as deleted when the transaction is committed.
+    bool FindMovedSong(const QString& file, qint64 size, Song* out);
+
+    // Gives a song that was added before content IDs existed one, so it's
+    // recognised if it's moved later.  The IDs are worked out by the
+    // tagreader workers when the transaction is committed.
+    void BackfillContentId(const Song& song);
+
     int dir() const { return dir_; }
     bool is_incremental() const { return incremental_; }
     bool ignores_mtime() const { return ignores_mtime_; }
@@ -109,15 +158,42 @@ signals:
     SongList touched_songs;
     SubdirectoryList new_subdirs;
     SubdirectoryList touched_subdirs;
+    QStringList embedded_art_files;
 
    private:
     ScanTransaction(const ScanTransaction&) {}
     ScanTransaction& operator=(const ScanTransaction&) { return *this; }
 
+    struct PendingRead {
+      QString file_;
+      QString image_;
+      Song matching_song_;
+      bool is_new_;
+    };
+
+    struct PendingBatch {
+      TagReaderReply* reply_;
+      QList<PendingRead> reads_;
+    };
+
+    void FinishBatch(const PendingBatch& batch);
+    void FinishRead(const PendingRead& read, Song* song);
+    void FinishContentIdBackfill();
+    void UpdateTaskName();
+
     int task_id_;
+    QString task_description_;
     int progress_;
     int progress_max_;
 
+    QList<PendingRead> queued_reads_;
+    QQueue<PendingBatch> pending_batches_;
+    int pending_files_;
+    int files_read_;
+    bool read_tags_only_;
+    QTime files_read_timer_;
+    int last_rate_update_;
+
     int dir_;
     // Incremental scan enters a directory only if it has changed since the
     // last scan.
@@ -133,6 +209,16 @@ signals:
     SongList cached_songs_;
     bool cached_songs_dirty_;
 
+    // Songs that might have been moved, by file size.  Built from
+    // cached_songs_ the first time it's needed.
+    QMultiHash<qint64, Song> move_candidates_;
+    bool move_candidates_dirty_;
+    QSet<int> moved_song_ids_;
+    // Whether each candidate's old file is gone, by song ID.
+    QHash<int, bool> candidate_missing_;
+
+    SongList content_id_backfill_;
+
     SubdirectoryList known_subdirs_;
     bool known_subdirs_dirty_;
   };
@@ -144,6 +230,9 @@ signals:
   void RescanPathsNow();
   void ScanSubdirectory(const QString& path, const Subdirectory& subdir,
                         ScanTransaction* t, bool force_noincremental = false);
+  // Reads the length, bitrate and sample rate of one batch of the songs that
+  // were added with only their tags, and schedules the next batch.
+  void ReadAudioPropertiesNow();
 
  private:
   static bool FindSongByPath(const SongList& list, const QString& path,
@@ -155,7 +244,17 @@ signals:
   QString ImageForSong(const QString& path,
                        QMap<QString, QStringList>& album_art);
   void AddWatch(const Directory& dir, const QString& path);
-  uint GetMtimeForCue(const QString& cue_path);
+  // True if the change journal can be trusted to know about every
+  // subdirectory that changed since the last scan of this directory.
+  bool CanUseChangeJournal(const Directory& dir) const;
+  // These look in the listing for paths inside the directory being scanned,
+  // and only stat paths outside it.
+  uint GetMtimeForCue(const QString& cue_path, const DirectoryListing& listing);
+  static bool FileExists(const QString& path, const DirectoryListing& listing);
+  // ScanSubdirectory for a directory that's already been stat'ed.
+  void ScanSubdirectory(const DirectoryListing::Entry& path_info,
+                        const Subdirectory& subdir, ScanTransaction* t,
+                        bool force_noincremental);
   void PerformScan(bool incremental, bool ignore_mtimes);
 
   // Updates the sections of a cue associated and altered (according to mtime)
@@ -177,15 +276,19 @@ signals:
   // Scans a single media file that's present on the disk but not yet in the
   // library.
   // It may result in a multiple files added to the library when the media file
-  // has many sections (like a CUE related media file).
+  // has many sections (like a CUE related media file).  Normal media files are
+  // read asynchronously and added to the transaction when the read finishes,
+  // so for those this returns an empty list.
   SongList ScanNewFile(const QString& file, const QString& path,
-                       const QString& matching_cue,
-                       QSet<QString>* cues_processed);
+                       const QString& matching_cue, uint matching_cue_mtime,
+                       const QString& image, QSet<QString>* cues_processed,
+                       ScanTransaction* t);
 
  private:
   LibraryBackend* backend_;
   TaskManager* task_manager_;
   QString device_name_;
+  LibraryChangeJournal* change_journal_;
 
   FileSystemWatcherInterface* fs_watcher_;
   QHash<QString, Directory> subdir_mapping_;
@@ -201,6 +304,27 @@ signals:
   bool scan_on_startup_;
   bool monitor_;
 
+  // Whether to keep several tag reads in flight at once, and how many.  With
+  // pipelining disabled every file is read and applied before moving on.
+  bool pipelined_scan_;
+  int read_ahead_;
+
+  // Whether the startup scan may rescan only the subdirectories recorded in
+  // the change journal instead of checking the mtime of every one.
+  bool use_change_journal_;
+
+  // Whether new files are read without their audio properties, so they show
+  // up in the library sooner.  The properties are read afterwards, a batch at
+  // a time, by ReadAudioPropertiesNow().
+  bool defer_audio_properties_;
+  QTimer* audio_properties_timer_;
+  SongList audio_properties_queue_;
+  // Songs whose audio properties couldn't be read because the tagreader
+  // failed, which aren't tried again until the next run.
+  QSet<int> audio_properties_failed_;
+
+  bool extract_embedded_art_;
+
   QMap<int, Directory> watched_dirs_;
   QTimer* rescan_timer_;
   QMap<int, QStringList>
@@ -132,6 +132,8 @@ void NetworkRemote::AcceptConnection() {
             outgoing_data_creator_.get(), SLOT(ActiveChanged(Playlist*)));
     connect(app_->playlist_manager(), SIGNAL(PlaylistChanged(Playlist*)),
             outgoing_data_creator_.get(), SLOT(PlaylistChanged(Playlist*)));
+    connect(app_->playlist_manager(), SIGNAL(PlaylistRestored(int)),
+            outgoing_data_creator_.get(), SLOT(PlaylistRestored(int)));
     connect(app_->playlist_manager(), SIGNAL(PlaylistAdded(int, QString, bool)),
             outgoing_data_creator_.get(),
             SLOT(PlaylistAdded(int, QString, bool)));
@@ -204,8 +204,6 @@ void OutgoingDataCreator::SetEngineState(
 }
 
 void OutgoingDataCreator::SendAllPlaylists() {
-  // Get all Playlists
-  QList<Playlist*> app_playlists = app_->playlist_manager()->GetAllPlaylists();
   int active_playlist = app_->playlist_manager()->active_id();
 
   // Create message
@@ -218,7 +216,9 @@ void OutgoingDataCreator::SendAllPlaylists() {
   for (const PlaylistBackend::Playlist& p :
        app_->playlist_backend()->GetAllPlaylists()) {
     bool playlist_open = app_->playlist_manager()->IsPlaylistOpen(p.id);
-    int item_count = playlist_open ? app_playlists.at(p.id)->rowCount() : 0;
+    int item_count =
+        playlist_open ? app_->playlist_manager()->playlist(p.id)->item_count()
+                      : p.item_count;
 
     // Create a new playlist
     pb::remote::Playlist* playlist = playlists->add_playlist();
@@ -254,7 +254,7 @@ void OutgoingDataCreator::SendAllActivePlaylists() {
     playlist->set_name(DataCommaSizeFromQString(playlist_name));
     playlist->set_id(p->id());
     playlist->set_active((p->id() == active_playlist));
-    playlist->set_item_count(p->rowCount());
+    playlist->set_item_count(p->item_count());
     playlist->set_closed(false);
   }
 
@@ -412,6 +412,14 @@ void OutgoingDataCreator::SendPlaylistSongs(int id) {
     return;
   }
 
+  // The playlist belongs to the GUI thread, so it's restored there and the
+  // songs are sent when PlaylistRestored() says it's done.
+  if (!playlist->is_restored()) {
+    restore_requested_.insert(id);
+    QMetaObject::invokeMethod(playlist, "Restore", Qt::QueuedConnection);
+    return;
+  }
+
   // Create the message and the playlist
   pb::remote::Message msg;
   msg.set_type(pb::remote::PLAYLIST_SONGS);
@@ -444,6 +452,10 @@ void OutgoingDataCreator::PlaylistChanged(Playlist* playlist) {
   SendPlaylistSongs(playlist->id());
 }
 
+void OutgoingDataCreator::PlaylistRestored(int id) {
+  if (restore_requested_.remove(id)) SendPlaylistSongs(id);
+}
+
 void OutgoingDataCreator::StateChanged(Engine::State state) {
   // Send state only if it changed
   // When selecting next song, StateChanged is emitted, but we already know
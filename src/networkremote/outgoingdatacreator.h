@@ -9,6 +9,7 @@
 #include <QTimer>
 #include <QMap>
 #include <QQueue>
+#include <QSet>
 
 #include "core/player.h"
 #include "core/application.h"
@@ -60,6 +61,7 @@ class OutgoingDataCreator : public QObject {
   void SendFirstData(bool send_playlist_songs);
   void SendPlaylistSongs(int id);
   void PlaylistChanged(Playlist*);
+  void PlaylistRestored(int id);
   void VolumeChanged(int volume);
   void PlaylistAdded(int id, const QString& name, bool favorite);
   void PlaylistDeleted(int id);
@@ -105,6 +107,9 @@ class OutgoingDataCreator : public QObject {
 
   QMap<int, GlobalSearchRequest> global_search_result_map_;
 
+  // Playlists whose songs were asked for before they were restored.
+  QSet<int> restore_requested_;
+
   void SendDataToClients(pb::remote::Message* msg);
   void SetEngineState(pb::remote::ResponseClementineInfo* msg);
   void CheckEnabledProviders();
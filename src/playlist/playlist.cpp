@@ -31,6 +31,8 @@
 #include <QMimeData>
 #include <QMutableListIterator>
 #include <QSortFilterProxyModel>
+#include <QThread>
+#include <QTimer>
 #include <QUndoStack>
 #include <QtConcurrentRun>
 #include <QtDebug>
@@ -38,6 +40,7 @@
 #include "playlistbackend.h"
 #include "playlistfilter.h"
 #include "playlistitemmimedata.h"
+#include "playlistsortkey.h"
 #include "playlistundocommands.h"
 #include "playlistview.h"
 #include "queue.h"
@@ -95,14 +98,19 @@ const char* Playlist::kWriteMetadata = "write_metadata";
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
 
+const int Playlist::kSaveDelayMsec = 500;
+
 Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
                    LibraryBackend* library, int id, const QString& special_type,
                    bool favorite, QObject* parent)
     : QAbstractListModel(parent),
       is_loading_(false),
+      restore_state_(RestoreState_None),
+      saved_item_count_(0),
       proxy_(new PlaylistFilter(this)),
       queue_(new Queue(this)),
       backend_(backend),
+      save_timer_(new QTimer(this)),
       task_manager_(task_manager),
       library_(library),
       id_(id),
@@ -119,13 +127,20 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
       special_type_(special_type) {
   undo_stack_->setUndoLimit(kUndoStackSize);
 
+  save_timer_->setSingleShot(true);
+  save_timer_->setInterval(kSaveDelayMsec);
+  connect(save_timer_, SIGNAL(timeout()), SLOT(SaveChanges()));
+  connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()),
+          SLOT(SavePendingChanges()));
+  if (backend_) {
+    connect(backend_, SIGNAL(PlaylistSaveFailed(int)), SLOT(SaveFailed(int)));
+  }
+
   connect(this, SIGNAL(rowsInserted(const QModelIndex&, int, int)),
           SIGNAL(PlaylistChanged()));
   connect(this, SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
           SIGNAL(PlaylistChanged()));
 
-  Restore();
-
   proxy_->setSourceModel(this);
   queue_->setSourceModel(this);
 
@@ -266,7 +281,7 @@ QVariant Playlist::data(const QModelIndex& index, int role) const {
       PlaylistItemPtr item = items_[index.row()];
       Song song = item->Metadata();
 
-      // Don't forget to change Playlist::CompareItems when adding new columns
+      // Don't forget to change PlaylistSortKey when adding new columns
       switch (index.column()) {
         case Column_Title:
           return song.PrettyTitle();
@@ -427,6 +442,9 @@ void Playlist::ItemReloadComplete() {
   watcher->deleteLater();
   const QPersistentModelIndex& index = watcher->index();
   if (index.isValid()) {
+    journal_.ItemChanged(item_at(index.row()));
+    Save();
+
     emit dataChanged(index, index);
     emit EditingFinished(index);
   }
@@ -723,6 +741,7 @@ Qt::DropActions Playlist::supportedDropActions() const {
 bool Playlist::dropMimeData(const QMimeData* data, Qt::DropAction action,
                             int row, int, const QModelIndex&) {
   if (action == Qt::IgnoreAction) return false;
+  RestoreNow();
 
   using smart_playlists::GeneratorMimeData;
 
@@ -974,6 +993,10 @@ void Playlist::InsertItems(const PlaylistItemList& itemsIn, int pos,
                            bool play_now, bool enqueue) {
   if (itemsIn.isEmpty()) return;
 
+  // The saved items have to be in place before anything is added, so the
+  // rows this inserts at, and remembers in the undo stack, are the real ones.
+  if (!is_loading_) RestoreNow();
+
   PlaylistItemList items = itemsIn;
 
   // exercise vetoes
@@ -1222,85 +1245,6 @@ QMimeData* Playlist::mimeData(const QModelIndexList& indexes) const {
   return data;
 }
 
-bool Playlist::CompareItems(int column, Qt::SortOrder order,
-                            shared_ptr<PlaylistItem> _a,
-                            shared_ptr<PlaylistItem> _b) {
-  shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
-
-#define cmp(field) return a->Metadata().field() < b->Metadata().field()
-#define strcmp(field)                                                 \
-  return QString::localeAwareCompare(a->Metadata().field().toLower(), \
-                                     b->Metadata().field().toLower()) < 0;
-
-  switch (column) {
-    case Column_Title:
-      strcmp(title);
-    case Column_Artist:
-      strcmp(artist);
-    case Column_Album:
-      strcmp(album);
-    case Column_Length:
-      cmp(length_nanosec);
-    case Column_Track:
-      cmp(track);
-    case Column_Disc:
-      cmp(disc);
-    case Column_Year:
-      cmp(year);
-    case Column_Genre:
-      strcmp(genre);
-    case Column_AlbumArtist:
-      strcmp(playlist_albumartist);
-    case Column_Composer:
-      strcmp(composer);
-    case Column_Performer:
-      strcmp(performer);
-    case Column_Grouping:
-      strcmp(grouping);
-
-    case Column_Rating:
-      cmp(rating);
-    case Column_PlayCount:
-      cmp(playcount);
-    case Column_SkipCount:
-      cmp(skipcount);
-    case Column_LastPlayed:
-      cmp(lastplayed);
-    case Column_Score:
-      cmp(score);
-
-    case Column_BPM:
-      cmp(bpm);
-    case Column_Bitrate:
-      cmp(bitrate);
-    case Column_Samplerate:
-      cmp(samplerate);
-    case Column_Filename:
-      cmp(url);
-    case Column_BaseFilename:
-      cmp(basefilename);
-    case Column_Filesize:
-      cmp(filesize);
-    case Column_Filetype:
-      cmp(filetype);
-    case Column_DateModified:
-      cmp(mtime);
-    case Column_DateCreated:
-      cmp(ctime);
-
-    case Column_Comment:
-      strcmp(comment);
-    case Column_Source:
-      cmp(url);
-  }
-
-#undef cmp
-#undef strcmp
-
-  return false;
-}
-
 QString Playlist::column_name(Column column) {
   switch (column) {
     case Column_Title:
@@ -1392,8 +1336,7 @@ void Playlist::sort(int column, Qt::SortOrder order) {
   if (dynamic_playlist_ && current_item_index_.isValid())
     begin += current_item_index_.row() + 1;
 
-  qStableSort(begin, new_items.end(),
-              std::bind(&Playlist::CompareItems, column, order, _1, _2));
+  PlaylistSortKey::Sort(column, order, begin, new_items.end());
 
   undo_stack_->push(
       new PlaylistUndoCommands::SortItems(this, column, order, new_items));
@@ -1405,16 +1348,21 @@ void Playlist::ReOrderWithoutUndo(const PlaylistItemList& new_items) {
   PlaylistItemList old_items = items_;
   items_ = new_items;
 
-  QMap<const PlaylistItem*, int> new_rows;
+  QHash<const PlaylistItem*, int> new_rows;
+  new_rows.reserve(new_items.length());
   for (int i = 0; i < new_items.length(); ++i) {
     new_rows[new_items[i].get()] = i;
   }
 
-  for (const QModelIndex& idx : persistentIndexList()) {
+  // Move every persistent index in one go, rather than one at a time.
+  const QModelIndexList from = persistentIndexList();
+  QModelIndexList to;
+  to.reserve(from.count());
+  for (const QModelIndex& idx : from) {
     const PlaylistItem* item = old_items[idx.row()].get();
-    changePersistentIndex(idx,
-                          index(new_rows[item], idx.column(), idx.parent()));
+    to << index(new_rows[item], idx.column(), idx.parent());
   }
+  changePersistentIndexList(from, to);
 
   layoutChanged();
 
@@ -1439,36 +1387,101 @@ void Playlist::SetCurrentIsPaused(bool paused) {
 }
 
 void Playlist::Save() const {
-  if (!backend_ || is_loading_) return;
+  // Playlists are restored before they're changed, so there's nothing to save
+  // until then.
+  if (!backend_ || is_loading_ || !is_restored()) return;
+
+  // Dragging, or removing lots of rows one at a time, can change the playlist
+  // many times a second.
+  save_timer_->start();
+}
 
-  backend_->SavePlaylistAsync(id_, items_, last_played_row(),
-                              dynamic_playlist_);
+void Playlist::SaveChanges() {
+  if (!backend_) return;
+
+  backend_->SavePlaylistChangesAsync(id_, journal_.Update(items_),
+                                     last_played_row(), dynamic_playlist_);
+}
+
+void Playlist::SavePendingChanges() {
+  if (!backend_ || !save_timer_->isActive()) return;
+  save_timer_->stop();
+
+  // Saves that were queued before this one have to be written first, so
+  // this one waits its turn on the backend's thread.
+  QThread* thread = backend_->thread();
+  const Qt::ConnectionType type =
+      thread == QThread::currentThread() || !thread->isRunning()
+          ? Qt::DirectConnection
+          : Qt::BlockingQueuedConnection;
+  QMetaObject::invokeMethod(
+      backend_, "SavePlaylistChanges", type, Q_ARG(int, id_),
+      Q_ARG(PlaylistChanges, journal_.Update(items_)),
+      Q_ARG(int, last_played_row()),
+      Q_ARG(smart_playlists::GeneratorPtr, dynamic_playlist_));
+}
+
+void Playlist::SaveFailed(int id) {
+  if (id != id_) return;
+
+  // The journal thinks the failed changes were written, so the next save
+  // has to write the whole playlist again.
+  journal_.Invalidate();
+}
+
+void Playlist::ItemsReloaded(const PlaylistItemList& items) {
+  for (PlaylistItemPtr item : items) {
+    journal_.ItemChanged(item);
+  }
+  Save();
 }
 
 namespace {
-typedef QFutureWatcher<QList<PlaylistItemPtr>> PlaylistItemFutureWatcher;
+typedef QFutureWatcher<PlaylistBackend::SavedItems> PlaylistItemFutureWatcher;
 }
 
 void Playlist::Restore() {
-  if (!backend_) return;
-
-  items_.clear();
-  virtual_items_.clear();
-  library_items_by_id_.clear();
+  if (restore_state_ != RestoreState_None) return;
+  if (!backend_) {
+    restore_state_ = RestoreState_Done;
+    return;
+  }
+  restore_state_ = RestoreState_Loading;
 
-  QFuture<QList<PlaylistItemPtr>> future =
-      QtConcurrent::run(backend_, &PlaylistBackend::GetPlaylistItems, id_);
+  QFuture<PlaylistBackend::SavedItems> future =
+      QtConcurrent::run(backend_, &PlaylistBackend::GetSavedPlaylistItems, id_);
   PlaylistItemFutureWatcher* watcher = new PlaylistItemFutureWatcher(this);
   watcher->setFuture(future);
   connect(watcher, SIGNAL(finished()), SLOT(ItemsLoaded()));
 }
 
+void Playlist::RestoreNow() {
+  if (restore_state_ == RestoreState_Done) return;
+  if (!backend_) {
+    restore_state_ = RestoreState_Done;
+    return;
+  }
+
+  // If Restore() has already started, ItemsLoaded() ignores its result.
+  restore_state_ = RestoreState_Loading;
+  RestoreItems(backend_->GetSavedPlaylistItems(id_));
+}
+
 void Playlist::ItemsLoaded() {
   PlaylistItemFutureWatcher* watcher =
       static_cast<PlaylistItemFutureWatcher*>(sender());
   watcher->deleteLater();
 
-  PlaylistItemList items = watcher->future().result();
+  // RestoreNow() got there first.
+  if (restore_state_ != RestoreState_Loading) return;
+
+  RestoreItems(watcher->future().result());
+}
+
+void Playlist::RestoreItems(const PlaylistBackend::SavedItems& saved) {
+  journal_.Reset(saved.items, saved.sort_orders);
+
+  PlaylistItemList items = saved.items;
 
   // backend returns empty elements for library items which it couldn't
   // match (because they got deleted); we don't need those
@@ -1485,6 +1498,8 @@ void Playlist::ItemsLoaded() {
   InsertItems(items, 0);
   is_loading_ = false;
 
+  restore_state_ = RestoreState_Done;
+
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
   // the newly loaded list of items might be shorter than it was before so
@@ -1720,6 +1735,8 @@ void Playlist::UpdateScrobblePoint() {
 }
 
 void Playlist::Clear() {
+  // Otherwise the saved items would be added back when it's restored.
+  RestoreNow();
   const int count = items_.count();
 
   if (count > kUndoItemLimit) {
@@ -1794,6 +1811,7 @@ void Playlist::ReloadItems(const QList<int>& rows) {
     PlaylistItemPtr item = item_at(row);
 
     item->Reload();
+    journal_.ItemChanged(item);
 
     if (row == current_row()) {
       InformOfCurrentSongChange();
@@ -2016,6 +2034,8 @@ void Playlist::QueueLayoutChanged() {
 void Playlist::ItemChanged(PlaylistItemPtr item) {
   for (int row = 0; row < items_.count(); ++row) {
     if (items_[row] == item) {
+      // Saved along with the next change.
+      journal_.ItemChanged(item);
       emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
       return;
     }
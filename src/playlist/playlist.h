@@ -21,14 +21,15 @@
 #include <QAbstractItemModel>
 #include <QList>
 
+#include "playlistbackend.h"
 #include "playlistitem.h"
+#include "playlistjournal.h"
 #include "playlistsequence.h"
 #include "core/tagreaderclient.h"
 #include "core/song.h"
 #include "smartplaylists/generator_fwd.h"
 
 class LibraryBackend;
-class PlaylistBackend;
 class PlaylistFilter;
 class Queue;
 class InternetModel;
@@ -36,6 +37,7 @@ class InternetService;
 class TaskManager;
 
 class QSortFilterProxyModel;
+class QTimer;
 class QUndoStack;
 
 namespace PlaylistUndoCommands {
@@ -160,8 +162,8 @@ class Playlist : public QAbstractListModel {
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
 
-  static bool CompareItems(int column, Qt::SortOrder order, PlaylistItemPtr a,
-                           PlaylistItemPtr b);
+  // Edits made this close together are saved together.
+  static const int kSaveDelayMsec;
 
   static QString column_name(Column column);
   static QString abbreviated_column_name(Column column);
@@ -170,9 +172,13 @@ class Playlist : public QAbstractListModel {
   static bool set_column_value(Song& song, Column column,
                                const QVariant& value);
 
-  // Persistence
+  // Persistence.  Save() only schedules a save, which writes the rows that
+  // changed since the last one.
   void Save() const;
-  void Restore();
+  bool is_restoring() const { return restore_state_ == RestoreState_Loading; }
+  bool is_restored() const { return restore_state_ == RestoreState_Done; }
+  // Saves the metadata of items that were reloaded by someone else.
+  void ItemsReloaded(const PlaylistItemList& items);
 
   // Accessors
   QSortFilterProxyModel* proxy() const;
@@ -184,6 +190,13 @@ class Playlist : public QAbstractListModel {
   bool is_favorite() const { return favorite_; }
   void set_favorite(bool favorite) { favorite_ = favorite; }
 
+  // The number of items in the playlist.  Until it's restored this is the
+  // number that were saved.
+  int item_count() const {
+    return is_restored() ? items_.count() : saved_item_count_;
+  }
+  void set_saved_item_count(int count) { saved_item_count_ = count; }
+
   int current_row() const;
   int last_played_row() const;
   int next_row(bool ignore_repeat_track = false) const;
@@ -302,6 +315,10 @@ class Playlist : public QAbstractListModel {
                   const QModelIndex& parent = QModelIndex());
 
  public slots:
+  // Loads the saved items.  Playlists aren't restored until this is called,
+  // and calling it again does nothing.
+  void Restore();
+
   void set_current_row(int index, bool is_stopping = false);
   void Paused();
   void Playing();
@@ -332,6 +349,10 @@ class Playlist : public QAbstractListModel {
   // undoable.
   void RemoveItemsWithoutUndo(const QList<int>& indices);
 
+  // Writes a save that's still waiting for its timer straight away, and
+  // returns once it's in the database.
+  void SavePendingChanges();
+
 signals:
   void RestoreFinished();
   void CurrentSongChanged(const Song& metadata);
@@ -392,15 +413,32 @@ signals:
   void ItemReloadComplete();
   void ItemsLoaded();
   void SongInsertVetoListenerDestroyed();
+  void SaveChanges();
+  void SaveFailed(int id);
 
  private:
+  // Restores the playlist straight away if it isn't already, waiting for the
+  // saved items to be read.  Called before the playlist is changed.
+  void RestoreNow();
+  void RestoreItems(const PlaylistBackend::SavedItems& saved);
+
+  enum RestoreState {
+    RestoreState_None,
+    RestoreState_Loading,
+    RestoreState_Done,
+  };
+
   bool is_loading_;
+  RestoreState restore_state_;
+  int saved_item_count_;
   PlaylistFilter* proxy_;
   Queue* queue_;
 
   QList<QModelIndex> temp_dequeue_change_indexes_;
 
   PlaylistBackend* backend_;
+  PlaylistJournal journal_;
+  QTimer* save_timer_;
   TaskManager* task_manager_;
   LibraryBackend* library_;
   int id_;
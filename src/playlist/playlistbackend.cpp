@@ -61,7 +61,7 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetAllFavoritePlaylists() {
 
 PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(
     GetPlaylistsFlags flags) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   PlaylistList ret;
@@ -81,7 +81,9 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(
   QSqlQuery q(
       "SELECT ROWID, name, last_played, dynamic_playlist_type,"
       "       dynamic_playlist_data, dynamic_playlist_backend,"
-      "       special_type, ui_path, is_favorite"
+      "       special_type, ui_path, is_favorite,"
+      "       (SELECT COUNT(*) FROM playlist_items"
+      "        WHERE playlist = playlists.ROWID)"
       " FROM playlists"
       " " +
           condition + " ORDER BY ui_order",
@@ -100,6 +102,7 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(
     p.special_type = q.value(6).toString();
     p.ui_path = q.value(7).toString();
     p.favorite = q.value(8).toBool();
+    p.item_count = q.value(9).toInt();
     ret << p;
   }
 
@@ -107,7 +110,7 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(
 }
 
 PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(
@@ -138,7 +141,7 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
 }
 
 QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
-  QMutexLocker l(db_->Mutex());
+  Database::ReadLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") +
@@ -152,7 +155,7 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "       p.ROWID, " +
                   Song::JoinSpec("p") +
                   ","
-                  "       p.type, p.radio_service"
+                  "       p.type, p.radio_service, p.sort_order"
                   " FROM playlist_items AS p"
                   " LEFT JOIN songs"
                   "    ON p.library_id = songs.ROWID"
@@ -160,7 +163,8 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "    ON p.library_id = magnatune_songs.ROWID"
                   " LEFT JOIN jamendo.songs AS jamendo_songs"
                   "    ON p.library_id = jamendo_songs.ROWID"
-                  " WHERE p.playlist = :playlist";
+                  " WHERE p.playlist = :playlist"
+                  " ORDER BY p.sort_order";
   QSqlQuery q(db);
   // Forward iterations only may be faster
   q.setForwardOnly(true);
@@ -172,19 +176,31 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
 }
 
 QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
+  return GetSavedPlaylistItems(playlist).items;
+}
+
+PlaylistBackend::SavedItems PlaylistBackend::GetSavedPlaylistItems(
+    int playlist) {
+  SavedItems ret;
+
   QSqlQuery q = GetPlaylistRows(playlist);
   // Note that as this only accesses the query, not the db, we don't need the
   // mutex.
-  if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
+  if (db_->CheckErrors(q)) return ret;
+
+  // p.sort_order comes after p.type and p.radio_service
+  const int sort_order_column =
+      (Song::kColumns.count() + 1) * kSongTableJoins + 2;
 
   // it's probable that we'll have a few songs associated with the
   // same CUE so we're caching results of parsing CUEs
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
-  QList<PlaylistItemPtr> playlistitems;
   while (q.next()) {
-    playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+    SqlRow row(q);
+    ret.items << NewPlaylistItemFromQuery(row, state_ptr);
+    ret.sort_orders << row.value(sort_order_column).toDouble();
   }
-  return playlistitems;
+  return ret;
 }
 
 QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
@@ -212,6 +228,10 @@ PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(
       PlaylistItem::NewFromType(row.value(playlist_row).toString()));
   if (item) {
     item->InitFromQuery(row);
+    {
+      QMutexLocker locker(&state->mutex_);
+      item->ShareStrings(&state->strings_);
+    }
     return RestoreCueData(item, state);
   } else {
     return item;
@@ -277,56 +297,158 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
   return item;
 }
 
-void PlaylistBackend::SavePlaylistAsync(int playlist,
-                                        const PlaylistItemList& items,
-                                        int last_played, GeneratorPtr dynamic) {
+void PlaylistBackend::SavePlaylistChangesAsync(int playlist,
+                                               const PlaylistChanges& changes,
+                                               int last_played,
+                                               GeneratorPtr dynamic) {
   metaObject()->invokeMethod(
-      this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist),
-      Q_ARG(PlaylistItemList, items), Q_ARG(int, last_played),
+      this, "SavePlaylistChanges", Qt::QueuedConnection, Q_ARG(int, playlist),
+      Q_ARG(PlaylistChanges, changes), Q_ARG(int, last_played),
       Q_ARG(smart_playlists::GeneratorPtr, dynamic));
 }
 
-void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
-                                   int last_played, GeneratorPtr dynamic) {
-  QMutexLocker l(db_->Mutex());
+void PlaylistBackend::SavePlaylistChanges(int playlist,
+                                          const PlaylistChanges& changes,
+                                          int last_played,
+                                          GeneratorPtr dynamic) {
+  if (!WritePlaylistChanges(playlist, changes, last_played, dynamic)) {
+    qLog(Warning) << "Failed to save playlist" << playlist;
+    emit PlaylistSaveFailed(playlist);
+  }
+}
+
+bool PlaylistBackend::WritePlaylistChanges(int playlist,
+                                           const PlaylistChanges& changes,
+                                           int last_played,
+                                           GeneratorPtr dynamic) {
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
-  qLog(Debug) << "Saving playlist" << playlist;
+  qLog(Debug) << "Saving playlist" << playlist << "-" << changes.removed_.count()
+              << "removed," << changes.moved_from_.count() << "moved,"
+              << changes.inserted_.count() << "inserted";
 
   QSqlQuery clear("DELETE FROM playlist_items WHERE playlist = :playlist", db);
+  QSqlQuery remove("DELETE FROM playlist_items WHERE ROWID = :id", db);
+  QSqlQuery move("UPDATE playlist_items SET sort_order = :sort_order"
+                 " WHERE ROWID = :id",
+                 db);
   QSqlQuery insert(
       "INSERT INTO playlist_items"
-      " (playlist, type, library_id, radio_service, " +
+      " (playlist, sort_order, type, library_id, radio_service, " +
           Song::kColumnSpec +
           ")"
-          " VALUES (:playlist, :type, :library_id, :radio_service, " +
+          " VALUES (:playlist, :sort_order, :type, :library_id,"
+          " :radio_service, " +
           Song::kBindSpec + ")",
       db);
-  QSqlQuery update(
-      "UPDATE playlists SET "
-      "   last_played=:last_played,"
-      "   dynamic_playlist_type=:dynamic_type,"
-      "   dynamic_playlist_data=:dynamic_data,"
-      "   dynamic_playlist_backend=:dynamic_backend"
-      " WHERE ROWID=:playlist",
-      db);
 
   ScopedTransaction transaction(&db);
 
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
+  if (changes.rewrite_) {
+    clear.bindValue(":playlist", playlist);
+    clear.exec();
+    if (db_->CheckErrors(clear)) return false;
+  }
+
+  if (changes.compact_ && !CompactPlaylist(playlist, db)) return false;
+
+  // Find all the rows before changing any of them, since a moved row can
+  // take another row's old sort_order.
+  const QList<qint64> removed_ids = RowIds(playlist, changes.removed_, db);
+  const QList<qint64> moved_ids = RowIds(playlist, changes.moved_from_, db);
+
+  for (qint64 id : removed_ids) {
+    remove.bindValue(":id", id);
+    remove.exec();
+    if (db_->CheckErrors(remove)) return false;
+  }
 
-  // Save the new ones
-  for (PlaylistItemPtr item : items) {
+  for (int i = 0; i < moved_ids.count(); ++i) {
+    if (moved_ids[i] == -1) continue;
+    move.bindValue(":sort_order", changes.moved_to_[i]);
+    move.bindValue(":id", moved_ids[i]);
+    move.exec();
+    if (db_->CheckErrors(move)) return false;
+  }
+
+  for (int i = 0; i < changes.inserted_.count(); ++i) {
     insert.bindValue(":playlist", playlist);
-    item->BindToQuery(&insert);
+    insert.bindValue(":sort_order", changes.inserted_orders_[i]);
+    changes.inserted_[i]->BindToQuery(&insert);
 
     insert.exec();
-    db_->CheckErrors(insert);
+    if (db_->CheckErrors(insert)) return false;
+  }
+
+  if (!SavePlaylistState(playlist, last_played, dynamic, db)) return false;
+
+  transaction.Commit();
+  return true;
+}
+
+QList<qint64> PlaylistBackend::RowIds(int playlist,
+                                      const QList<double>& sort_orders,
+                                      QSqlDatabase& db) {
+  QList<qint64> ret;
+
+  QSqlQuery q(
+      "SELECT ROWID FROM playlist_items"
+      " WHERE playlist = :playlist AND sort_order = :sort_order",
+      db);
+  for (double sort_order : sort_orders) {
+    q.bindValue(":playlist", playlist);
+    q.bindValue(":sort_order", sort_order);
+    q.exec();
+    if (!db_->CheckErrors(q) && q.next()) {
+      ret << q.value(0).toLongLong();
+    } else {
+      qLog(Warning) << "Playlist" << playlist << "has no row" << sort_order;
+      ret << -1;
+    }
   }
 
+  return ret;
+}
+
+// Renumbers the playlist's rows the same way PlaylistJournal does.
+bool PlaylistBackend::CompactPlaylist(int playlist, QSqlDatabase& db) {
+  QSqlQuery select(
+      "SELECT ROWID FROM playlist_items WHERE playlist = :playlist"
+      " ORDER BY sort_order",
+      db);
+  select.bindValue(":playlist", playlist);
+  select.exec();
+  if (db_->CheckErrors(select)) return false;
+
+  QList<qint64> ids;
+  while (select.next()) ids << select.value(0).toLongLong();
+
+  QSqlQuery update(
+      "UPDATE playlist_items SET sort_order = :sort_order WHERE ROWID = :id",
+      db);
+  for (int i = 0; i < ids.count(); ++i) {
+    update.bindValue(":sort_order", (i + 1) * PlaylistJournal::kOrderSpacing);
+    update.bindValue(":id", ids[i]);
+    update.exec();
+    if (db_->CheckErrors(update)) return false;
+  }
+
+  return true;
+}
+
+bool PlaylistBackend::SavePlaylistState(int playlist, int last_played,
+                                        GeneratorPtr dynamic,
+                                        QSqlDatabase& db) {
+  QSqlQuery update(
+      "UPDATE playlists SET "
+      "   last_played=:last_played,"
+      "   dynamic_playlist_type=:dynamic_type,"
+      "   dynamic_playlist_data=:dynamic_data,"
+      "   dynamic_playlist_backend=:dynamic_backend"
+      " WHERE ROWID=:playlist",
+      db);
+
   // Update the last played track number
   update.bindValue(":last_played", last_played);
   if (dynamic) {
@@ -340,14 +462,12 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
   }
   update.bindValue(":playlist", playlist);
   update.exec();
-  if (db_->CheckErrors(update)) return;
-
-  transaction.Commit();
+  return !db_->CheckErrors(update);
 }
 
 int PlaylistBackend::CreatePlaylist(const QString& name,
                                     const QString& special_type) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(
@@ -363,7 +483,7 @@ int PlaylistBackend::CreatePlaylist(const QString& name,
 }
 
 void PlaylistBackend::RemovePlaylist(int id) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery delete_playlist("DELETE FROM playlists WHERE ROWID=:id", db);
   QSqlQuery delete_items("DELETE FROM playlist_items WHERE playlist=:id", db);
@@ -383,7 +503,7 @@ void PlaylistBackend::RemovePlaylist(int id) {
 }
 
 void PlaylistBackend::RenamePlaylist(int id, const QString& new_name) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery q("UPDATE playlists SET name=:name WHERE ROWID=:id", db);
   q.bindValue(":name", new_name);
@@ -394,7 +514,7 @@ void PlaylistBackend::RenamePlaylist(int id, const QString& new_name) {
 }
 
 void PlaylistBackend::FavoritePlaylist(int id, bool is_favorite) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery q("UPDATE playlists SET is_favorite=:is_favorite WHERE ROWID=:id",
               db);
@@ -406,7 +526,7 @@ void PlaylistBackend::FavoritePlaylist(int id, bool is_favorite) {
 }
 
 void PlaylistBackend::SetPlaylistOrder(const QList<int>& ids) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   ScopedTransaction transaction(&db);
 
@@ -426,7 +546,7 @@ void PlaylistBackend::SetPlaylistOrder(const QList<int>& ids) {
 }
 
 void PlaylistBackend::SetPlaylistUiPath(int id, const QString& path) {
-  QMutexLocker l(db_->Mutex());
+  Database::WriteLocker l(db_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery q("UPDATE playlists SET ui_path=:path WHERE ROWID=:id", db);
 
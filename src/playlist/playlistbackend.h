@@ -24,10 +24,13 @@
 #include <QObject>
 
 #include "playlistitem.h"
+#include "playlistjournal.h"
+#include "core/stringpool.h"
 #include "smartplaylists/generator_fwd.h"
 
 class Application;
 class Database;
+class QSqlDatabase;
 
 class PlaylistBackend : public QObject {
   Q_OBJECT
@@ -36,7 +39,7 @@ class PlaylistBackend : public QObject {
   Q_INVOKABLE PlaylistBackend(Application* app, QObject* parent = nullptr);
 
   struct Playlist {
-    Playlist() : id(-1), favorite(false), last_played(0) {}
+    Playlist() : id(-1), favorite(false), last_played(0), item_count(0) {}
 
     int id;
     QString name;
@@ -47,12 +50,21 @@ class PlaylistBackend : public QObject {
     QString dynamic_backend;
     QByteArray dynamic_data;
 
+    // Only filled in by GetPlaylists().
+    int item_count;
+
     // Special playlists have different behaviour, eg. the "spotify-search"
     // type has a spotify search box at the top, replacing the ordinary filter.
     QString special_type;
   };
   typedef QList<Playlist> PlaylistList;
 
+  // A playlist's saved items in order, with the sort_order of each one's row.
+  struct SavedItems {
+    PlaylistItemList items;
+    QList<double> sort_orders;
+  };
+
   static const int kSongTableJoins;
 
   PlaylistList GetAllPlaylists();
@@ -61,15 +73,16 @@ class PlaylistBackend : public QObject {
   PlaylistBackend::Playlist GetPlaylist(int id);
 
   QList<PlaylistItemPtr> GetPlaylistItems(int playlist);
+  SavedItems GetSavedPlaylistItems(int playlist);
   QList<Song> GetPlaylistSongs(int playlist);
 
   void SetPlaylistOrder(const QList<int>& ids);
   void SetPlaylistUiPath(int id, const QString& path);
 
   int CreatePlaylist(const QString& name, const QString& special_type);
-  void SavePlaylistAsync(int playlist, const PlaylistItemList& items,
-                         int last_played,
-                         smart_playlists::GeneratorPtr dynamic);
+  void SavePlaylistChangesAsync(int playlist, const PlaylistChanges& changes,
+                                int last_played,
+                                smart_playlists::GeneratorPtr dynamic);
   void RenamePlaylist(int id, const QString& new_name);
   void FavoritePlaylist(int id, bool is_favorite);
   void RemovePlaylist(int id);
@@ -77,17 +90,35 @@ class PlaylistBackend : public QObject {
   Application* app() const { return app_; }
 
  public slots:
-  void SavePlaylist(int playlist, const PlaylistItemList& items,
-                    int last_played, smart_playlists::GeneratorPtr dynamic);
+  // Only writes the rows that changed since the playlist was last saved.
+  void SavePlaylistChanges(int playlist, const PlaylistChanges& changes,
+                           int last_played,
+                           smart_playlists::GeneratorPtr dynamic);
+
+signals:
+  // Nothing from the save was written.
+  void PlaylistSaveFailed(int playlist);
 
  private:
   struct NewSongFromQueryState {
     QHash<QString, SongList> cached_cues_;
+    StringPool strings_;
     QMutex mutex_;
   };
 
   QSqlQuery GetPlaylistRows(int playlist);
 
+  // Returns the ROWIDs of the playlist's rows with these sort_orders.
+  QList<qint64> RowIds(int playlist, const QList<double>& sort_orders,
+                       QSqlDatabase& db);
+  bool WritePlaylistChanges(int playlist, const PlaylistChanges& changes,
+                            int last_played,
+                            smart_playlists::GeneratorPtr dynamic);
+  bool CompactPlaylist(int playlist, QSqlDatabase& db);
+  bool SavePlaylistState(int playlist, int last_played,
+                         smart_playlists::GeneratorPtr dynamic,
+                         QSqlDatabase& db);
+
   Song NewSongFromQuery(const SqlRow& row,
                         std::shared_ptr<NewSongFromQueryState> state);
   PlaylistItemPtr NewPlaylistItemFromQuery(
@@ -18,12 +18,28 @@
 #include "playlistfilter.h"
 #include "playlistfilterparser.h"
 
+#include <QFuture>
+#include <QRegExp>
+#include <QThread>
+#include <QtConcurrentRun>
 #include <QtDebug>
 
+const int PlaylistFilter::kThreadedFilterRows = 20000;
+
+namespace {
+
+void TestRowRange(const FilterTree* tree, const PlaylistFilterCache* cache,
+                  qint8* results, int begin, int end) {
+  for (int row = begin; row < end; ++row) {
+    if (results[row] != 0) results[row] = tree->accept(row, *cache) ? 1 : 0;
+  }
+}
+
+}  // namespace
+
 PlaylistFilter::PlaylistFilter(QObject* parent)
     : QSortFilterProxyModel(parent),
-      filter_tree_(new NopFilter),
-      query_hash_(0) {
+      filter_tree_(new NopFilter) {
   setDynamicSortFilter(true);
 
   column_names_["title"] = Playlist::Column_Title;
@@ -54,24 +70,145 @@ PlaylistFilter::PlaylistFilter(QObject* parent)
 
 PlaylistFilter::~PlaylistFilter() {}
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel* source_model) {
+  if (sourceModel()) disconnect(sourceModel(), 0, this, 0);
+
+  // Connect before QSortFilterProxyModel does, so the results are up to date
+  // by the time it asks for them.
+  if (source_model) {
+    connect(source_model, SIGNAL(rowsInserted(QModelIndex, int, int)),
+            SLOT(SourceRowsInserted(QModelIndex, int, int)));
+    connect(source_model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+            SLOT(SourceRowsRemoved(QModelIndex, int, int)));
+    connect(source_model, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+            SLOT(SourceDataChanged(QModelIndex, QModelIndex)));
+    connect(source_model, SIGNAL(layoutChanged()), SLOT(SourceReset()));
+    connect(source_model, SIGNAL(modelReset()), SLOT(SourceReset()));
+  }
+
+  cache_.set_model(source_model);
+  results_.clear();
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+}
+
 void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   // Pass this through to the Playlist, it does sorting itself
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::SourceRowsInserted(const QModelIndex&, int first,
+                                        int last) {
+  cache_.RowsInserted(first, last);
+  if (!results_.isEmpty() && first <= results_.count()) {
+    results_.insert(first, last - first + 1, -1);
+  }
+}
+
+void PlaylistFilter::SourceRowsRemoved(const QModelIndex&, int first,
+                                       int last) {
+  cache_.RowsRemoved(first, last);
+  if (last < results_.count()) {
+    results_.remove(first, last - first + 1);
+  } else {
+    results_.clear();
+  }
+}
+
+void PlaylistFilter::SourceDataChanged(const QModelIndex& top_left,
+                                       const QModelIndex& bottom_right) {
+  cache_.RowsChanged(top_left.row(), bottom_right.row());
+
+  const int end = qMin(bottom_right.row() + 1, results_.count());
+  for (int row = top_left.row(); row < end; ++row) {
+    results_[row] = -1;
+  }
+}
+
+void PlaylistFilter::SourceReset() {
+  cache_.Clear();
+  results_.clear();
+}
+
+bool PlaylistFilter::IsNarrower(const QString& query,
+                                const QString& previous_query) {
+  if (previous_query.isEmpty() || !query.startsWith(previous_query)) {
+    return false;
+  }
+
+  // Only true for plain words, which all have to be found somewhere in the
+  // row: the longer query's words are the same or longer.  Anything with a
+  // column, an operator, a negation or a group could match more rows.
+  static const QRegExp kSpecial("[:\\-()\"<>=!]");
+  static const QRegExp kKeyword("(^|\\s)(AND|OR)(\\s|$)");
+  return !query.contains(kSpecial) && !query.contains(kKeyword);
+}
+
+void PlaylistFilter::SetQuery(const QString& query) const {
+  const bool narrower = IsNarrower(query, query_);
+
+  FilterParser p(query, column_names_, numerical_columns_);
+  filter_tree_.reset(p.parse());
+  query_ = query;
+
+  query_columns_.clear();
+  filter_tree_->used_columns(&query_columns_);
+
+  if (filter_tree_->type() == FilterTree::Nop) {
+    // Don't keep the text around when nothing is being filtered.
+    cache_.Clear();
+    results_.clear();
+    return;
+  }
+
+  if (!narrower) results_.clear();
+  TestRows();
+}
+
+void PlaylistFilter::TestRows() const {
+  const int rows = sourceModel()->rowCount();
+  if (results_.count() != rows) results_.fill(-1, rows);
+
+  cache_.Fill(query_columns_);
+
+  qint8* results = results_.data();
+  const int threads = rows >= kThreadedFilterRows
+                          ? qMax(1, QThread::idealThreadCount())
+                          : 1;
+  if (threads == 1) {
+    TestRowRange(filter_tree_.data(), &cache_, results, 0, rows);
+    return;
+  }
+
+  // The cache is full, so the threads only read it.
+  QList<QFuture<void>> futures;
+  const int rows_per_thread = (rows + threads - 1) / threads;
+  for (int begin = 0; begin < rows; begin += rows_per_thread) {
+    futures << QtConcurrent::run(&TestRowRange, filter_tree_.data(), &cache_,
+                                 results, begin,
+                                 qMin(begin + rows_per_thread, rows));
+  }
+  for (QFuture<void>& future : futures) {
+    future.waitForFinished();
+  }
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row,
                                       const QModelIndex& parent) const {
-  QString filter = filterRegExp().pattern();
+  const QString query = filterRegExp().pattern();
+  if (query != query_) SetQuery(query);
 
-  uint hash = qHash(filter);
-  if (hash != query_hash_) {
-    // Parse the query
-    FilterParser p(filter, column_names_, numerical_columns_);
-    filter_tree_.reset(p.parse());
+  if (filter_tree_->type() == FilterTree::Nop) return true;
 
-    query_hash_ = hash;
-  }
+  // The rows were reordered, so test them all again.
+  if (results_.count() != sourceModel()->rowCount()) TestRows();
 
-  // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+  if (row < 0 || row >= results_.count()) return false;
+
+  qint8& result = results_[row];
+  if (result == -1) {
+    cache_.Fill(row, query_columns_);
+    result = filter_tree_->accept(row, cache_) ? 1 : 0;
+  }
+  return result == 1;
 }
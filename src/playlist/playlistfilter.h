@@ -20,8 +20,10 @@
 
 #include <QScopedPointer>
 #include <QSortFilterProxyModel>
+#include <QVector>
 
 #include "playlist.h"
+#include "playlistfiltercache.h"
 
 #include <QSet>
 
@@ -34,6 +36,12 @@ class PlaylistFilter : public QSortFilterProxyModel {
   PlaylistFilter(QObject* parent = nullptr);
   ~PlaylistFilter();
 
+  // Playlists with at least this many rows are filtered on several threads.
+  static const int kThreadedFilterRows;
+
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel* source_model);
+
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 
@@ -41,10 +49,32 @@ class PlaylistFilter : public QSortFilterProxyModel {
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
 
+ private slots:
+  void SourceRowsInserted(const QModelIndex& parent, int first, int last);
+  void SourceRowsRemoved(const QModelIndex& parent, int first, int last);
+  void SourceDataChanged(const QModelIndex& top_left,
+                         const QModelIndex& bottom_right);
+  void SourceReset();
+
  private:
+  // Returns true if every row that matches query also matches
+  // previous_query, so only the rows that matched that need to be tested.
+  static bool IsNarrower(const QString& query, const QString& previous_query);
+
+  void SetQuery(const QString& query) const;
+  // Tests every row that hasn't been found not to match already.
+  void TestRows() const;
+
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
-  mutable uint query_hash_;
+  mutable QString query_;
+  mutable QSet<int> query_columns_;
+  mutable PlaylistFilterCache cache_;
+
+  // Whether each row matches the query: 1 if it does, 0 if it doesn't and -1
+  // if it has to be tested again.  Empty if there's no query, or if the rows
+  // have been reordered.
+  mutable QVector<qint8> results_;
 
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
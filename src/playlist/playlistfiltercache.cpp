@@ -0,0 +1,109 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playlistfiltercache.h"
+
+#include <QAbstractItemModel>
+
+PlaylistFilterCache::PlaylistFilterCache() : model_(nullptr) {}
+
+void PlaylistFilterCache::set_model(const QAbstractItemModel* model) {
+  model_ = model;
+  Clear();
+}
+
+void PlaylistFilterCache::Clear() {
+  columns_.clear();
+  strings_ = StringPool();
+}
+
+PlaylistFilterCache::Column* PlaylistFilterCache::PrepareColumn(int column,
+                                                                int rows) {
+  if (column >= columns_.count()) columns_.resize(column + 1);
+
+  Column* ret = &columns_[column];
+  if (ret->cached_.count() != rows) {
+    ret->text_.fill(QString(), rows);
+    ret->cached_.fill(false, rows);
+  }
+  return ret;
+}
+
+void PlaylistFilterCache::FillCell(Column* column, int row, int column_index) {
+  QString text = model_->index(row, column_index).data().toString().toLower();
+  strings_.Share(&text);
+
+  column->text_[row] = text;
+  column->cached_[row] = true;
+}
+
+void PlaylistFilterCache::Fill(const QSet<int>& columns) {
+  if (!model_) return;
+  const int rows = model_->rowCount();
+
+  for (int column_index : columns) {
+    Column* column = PrepareColumn(column_index, rows);
+    for (int row = 0; row < rows; ++row) {
+      if (!column->cached_[row]) FillCell(column, row, column_index);
+    }
+  }
+}
+
+void PlaylistFilterCache::Fill(int row, const QSet<int>& columns) {
+  if (!model_) return;
+  const int rows = model_->rowCount();
+  if (row < 0 || row >= rows) return;
+
+  for (int column_index : columns) {
+    Column* column = PrepareColumn(column_index, rows);
+    if (!column->cached_[row]) FillCell(column, row, column_index);
+  }
+}
+
+void PlaylistFilterCache::RowsInserted(int first, int last) {
+  const int count = last - first + 1;
+  for (Column& column : columns_) {
+    if (first > column.cached_.count()) {
+      // We'd lost track of this column already, Fill() will start it again.
+      continue;
+    }
+    column.text_.insert(first, count, QString());
+    column.cached_.insert(first, count, false);
+  }
+}
+
+void PlaylistFilterCache::RowsRemoved(int first, int last) {
+  for (Column& column : columns_) {
+    if (last >= column.cached_.count()) {
+      column.text_.clear();
+      column.cached_.clear();
+      continue;
+    }
+    column.text_.remove(first, last - first + 1);
+    column.cached_.remove(first, last - first + 1);
+  }
+}
+
+void PlaylistFilterCache::RowsChanged(int first, int last) {
+  for (Column& column : columns_) {
+    const int end = qMin(last + 1, column.cached_.count());
+    for (int row = first; row < end; ++row) {
+      column.cached_[row] = false;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLAYLISTFILTERCACHE_H
+#define PLAYLISTFILTERCACHE_H
+
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "core/stringpool.h"
+
+class QAbstractItemModel;
+
+// The lowercased text of a model's cells, which is what the playlist filter
+// matches against.  A column is read from the model the first time a filter
+// needs it, and each row is read again after it changes, so typing in the
+// filter box doesn't fetch and lowercase every cell on every keystroke.
+//
+// Only Fill() and the row notifications change the cache.  Once it's filled,
+// text() can be called from any thread.
+class PlaylistFilterCache {
+ public:
+  PlaylistFilterCache();
+
+  void set_model(const QAbstractItemModel* model);
+
+  // Reads the columns of every row that aren't cached yet.
+  void Fill(const QSet<int>& columns);
+  // Reads the columns of one row if they aren't cached yet.
+  void Fill(int row, const QSet<int>& columns);
+
+  // Only valid for cells that have been filled.
+  const QString& text(int row, int column) const {
+    return columns_[column].text_[row];
+  }
+
+  // Tell the cache how the model changed.
+  void Clear();
+  void RowsInserted(int first, int last);
+  void RowsRemoved(int first, int last);
+  void RowsChanged(int first, int last);
+
+ private:
+  struct Column {
+    QVector<QString> text_;
+    QVector<bool> cached_;
+  };
+
+  // Returns the column, emptied if it doesn't have a row for every row of the
+  // model.
+  Column* PrepareColumn(int column, int rows);
+  void FillCell(Column* column, int row, int column_index);
+
+  const QAbstractItemModel* model_;
+  QVector<Column> columns_;
+  StringPool strings_;
+};
+
+#endif  // PLAYLISTFILTERCACHE_H
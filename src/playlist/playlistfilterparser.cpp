@@ -17,10 +17,9 @@
 
 #include "playlistfilterparser.h"
 #include "playlist.h"
+#include "playlistfiltercache.h"
 #include "core/logging.h"
 
-#include <QAbstractItemModel>
-
 class SearchTermComparator {
  public:
   virtual ~SearchTermComparator() {}
@@ -188,14 +187,15 @@ class FilterTerm : public FilterTree {
                       const QList<int>& columns)
       : cmp_(comparator), columns_(columns) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const {
     for (int i : columns_) {
-      QModelIndex idx(model->index(row, i, parent));
-      if (cmp_->Matches(idx.data().toString().toLower())) return true;
+      if (cmp_->Matches(cache.text(row, i))) return true;
     }
     return false;
   }
+  virtual void used_columns(QSet<int>* columns) const {
+    for (int i : columns_) columns->insert(i);
+  }
   virtual FilterType type() { return Term; }
 
  private:
@@ -210,11 +210,10 @@ class FilterColumnTerm : public FilterTree {
   FilterColumnTerm(int column, SearchTermComparator* comparator)
       : col(column), cmp_(comparator) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    QModelIndex idx(model->index(row, col, parent));
-    return cmp_->Matches(idx.data().toString().toLower());
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const {
+    return cmp_->Matches(cache.text(row, col));
   }
+  virtual void used_columns(QSet<int>* columns) const { columns->insert(col); }
   virtual FilterType type() { return Column; }
 
  private:
@@ -226,9 +225,11 @@ class NotFilter : public FilterTree {
  public:
   explicit NotFilter(const FilterTree* inv) : child_(inv) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    return !child_->accept(row, parent, model);
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const {
+    return !child_->accept(row, cache);
+  }
+  virtual void used_columns(QSet<int>* columns) const {
+    child_->used_columns(columns);
   }
   virtual FilterType type() { return Not; }
 
@@ -240,13 +241,15 @@ class OrFilter : public FilterTree {
  public:
   ~OrFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const {
     for (FilterTree* child : children_) {
-      if (child->accept(row, parent, model)) return true;
+      if (child->accept(row, cache)) return true;
     }
     return false;
   }
+  virtual void used_columns(QSet<int>* columns) const {
+    for (FilterTree* child : children_) child->used_columns(columns);
+  }
   FilterType type() { return Or; }
 
  private:
@@ -257,13 +260,15 @@ class AndFilter : public FilterTree {
  public:
   virtual ~AndFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const {
     for (FilterTree* child : children_) {
-      if (!child->accept(row, parent, model)) return false;
+      if (!child->accept(row, cache)) return false;
     }
     return true;
   }
+  virtual void used_columns(QSet<int>* columns) const {
+    for (FilterTree* child : children_) child->used_columns(columns);
+  }
   FilterType type() { return And; }
 
  private:
@@ -19,18 +19,19 @@
 #define PLAYLISTFILTERPARSER_H
 
 #include <QMap>
-#include <QModelIndex>
 #include <QSet>
 #include <QString>
 
-class QAbstractItemModel;
+class PlaylistFilterCache;
 
 // structure for filter parse tree
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const = 0;
+  // The cache must have been filled with used_columns() for the row.
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const = 0;
+  // Adds the columns accept() looks at.
+  virtual void used_columns(QSet<int>* columns) const = 0;
   enum FilterType { Nop = 0, Or, And, Not, Column, Term };
   virtual FilterType type() = 0;
 };
@@ -38,10 +39,10 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const PlaylistFilterCache& cache) const {
     return true;
   }
+  virtual void used_columns(QSet<int>* columns) const {}
   virtual FilterType type() { return Nop; }
 };
 
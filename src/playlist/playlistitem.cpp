@@ -31,6 +31,20 @@
 #include <QtConcurrentRun>
 #include <QtDebug>
 
+namespace {
+
+// Most items never have temporary metadata, so rather than each one
+// allocating its own empty Song they all share this one.
+const Song& NoTemporaryMetadata() {
+  static const Song song;
+  return song;
+}
+
+}  // namespace
+
+PlaylistItem::PlaylistItem(const QString& type)
+    : should_skip_(false), type_(type), temp_metadata_(NoTemporaryMetadata()) {}
+
 PlaylistItem::~PlaylistItem() {}
 
 PlaylistItem* PlaylistItem::NewFromType(const QString& type) {
@@ -70,7 +84,24 @@ void PlaylistItem::SetTemporaryMetadata(const Song& metadata) {
   temp_metadata_.set_filetype(Song::Type_Stream);
 }
 
-void PlaylistItem::ClearTemporaryMetadata() { temp_metadata_ = Song(); }
+void PlaylistItem::ClearTemporaryMetadata() {
+  temp_metadata_ = NoTemporaryMetadata();
+}
+
+bool PlaylistItem::GetCachedSortKey(const QString& string,
+                                    QByteArray* key) const {
+  // The string is a new lowercase copy each time, so this compares its
+  // characters, which is still much cheaper than collating it again.
+  if (sort_key_.isNull() || string != sort_string_) return false;
+  *key = sort_key_;
+  return true;
+}
+
+void PlaylistItem::SetCachedSortKey(const QString& string,
+                                    const QByteArray& key) {
+  sort_string_ = string;
+  sort_key_ = key;
+}
 
 static void ReloadPlaylistItem(PlaylistItemPtr item) { item->Reload(); }
 
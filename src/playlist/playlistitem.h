@@ -29,10 +29,11 @@
 
 class QAction;
 class SqlRow;
+class StringPool;
 
 class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
  public:
-  PlaylistItem(const QString& type) : should_skip_(false), type_(type) {}
+  PlaylistItem(const QString& type);
   virtual ~PlaylistItem();
 
   static PlaylistItem* NewFromType(const QString& type);
@@ -60,6 +61,9 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   virtual QList<QAction*> actions() { return QList<QAction*>(); }
 
   virtual bool InitFromQuery(const SqlRow& query) = 0;
+  // Shares the item's repeated strings with other items loaded at the same
+  // time.  See Song::ShareStrings().
+  virtual void ShareStrings(StringPool* pool) {}
   void BindToQuery(QSqlQuery* query) const;
   virtual void Reload() {}
   QFuture<void> BackgroundReload();
@@ -71,6 +75,12 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   void ClearTemporaryMetadata();
   bool HasTemporaryMetadata() const { return temp_metadata_.is_valid(); }
 
+  // The collation key PlaylistSortKey last built for one of the item's
+  // strings.  It's only returned for the same string, so it goes stale by
+  // itself when the metadata changes.
+  bool GetCachedSortKey(const QString& string, QByteArray* key) const;
+  void SetCachedSortKey(const QString& string, const QByteArray& key);
+
   // Background colors.
   void SetBackgroundColor(short priority, const QColor& color);
   bool HasBackgroundColor(short priority) const;
@@ -108,6 +118,9 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
 
   Song temp_metadata_;
 
+  QString sort_string_;
+  QByteArray sort_key_;
+
   QMap<short, QColor> background_colors_;
   QMap<short, QColor> foreground_colors_;
 };
@@ -0,0 +1,209 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playlistjournal.h"
+
+#include <QHash>
+
+const double PlaylistJournal::kOrderSpacing = 1024.0;
+const int PlaylistJournal::kCompactAfterSaves = 500;
+
+namespace {
+
+// Marks the longest run of rows, in playlist order, whose saved rows are
+// increasing.  Those rows are already in the right order relative to each
+// other, so they can stay where they are and everything else moves around
+// them.  Rows that weren't saved have a saved row of -1.
+QVector<bool> LongestIncreasingRun(const QVector<int>& saved_rows) {
+  QVector<bool> ret(saved_rows.count(), false);
+
+  // tails[k] is the row ending the best increasing run of length k+1 found so
+  // far.
+  QVector<int> tails;
+  QVector<int> previous(saved_rows.count(), -1);
+
+  for (int i = 0; i < saved_rows.count(); ++i) {
+    const int value = saved_rows[i];
+    if (value == -1) continue;
+
+    int lo = 0;
+    int hi = tails.count();
+    while (lo < hi) {
+      const int mid = (lo + hi) / 2;
+      if (saved_rows[tails[mid]] < value) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    if (lo > 0) previous[i] = tails[lo - 1];
+    if (lo == tails.count()) {
+      tails << i;
+    } else {
+      tails[lo] = i;
+    }
+  }
+
+  for (int i = tails.isEmpty() ? -1 : tails.last(); i != -1; i = previous[i]) {
+    ret[i] = true;
+  }
+  return ret;
+}
+
+}  // namespace
+
+PlaylistJournal::PlaylistJournal()
+    : saves_since_compaction_(0), rewrite_pending_(false) {}
+
+void PlaylistJournal::Reset(const PlaylistItemList& items,
+                            const QList<double>& orders) {
+  Q_ASSERT(items.count() == orders.count());
+
+  saved_items_ = items;
+  saved_orders_ = orders;
+  changed_items_.clear();
+  saves_since_compaction_ = 0;
+  rewrite_pending_ = false;
+}
+
+void PlaylistJournal::ItemChanged(const PlaylistItemPtr& item) {
+  changed_items_.insert(item.get());
+}
+
+void PlaylistJournal::Invalidate() { rewrite_pending_ = true; }
+
+void PlaylistJournal::Compact(PlaylistChanges* changes) {
+  changes->compact_ = true;
+  for (int i = 0; i < saved_orders_.count(); ++i) {
+    saved_orders_[i] = (i + 1) * kOrderSpacing;
+  }
+  saves_since_compaction_ = 0;
+}
+
+PlaylistChanges PlaylistJournal::Update(const PlaylistItemList& items) {
+  PlaylistChanges ret;
+
+  if (rewrite_pending_) {
+    // With nothing saved, every item is inserted with fresh sort_orders.
+    Reset(PlaylistItemList(), QList<double>());
+    ret.rewrite_ = true;
+  }
+
+  if (++saves_since_compaction_ >= kCompactAfterSaves) {
+    Compact(&ret);
+  }
+
+  // Find where each item was saved.  Changed items are saved again as new
+  // rows.
+  QHash<PlaylistItem*, int> saved_row_by_item;
+  for (int i = saved_items_.count() - 1; i >= 0; --i) {
+    PlaylistItem* item = saved_items_[i].get();
+    if (!changed_items_.contains(item)) saved_row_by_item[item] = i;
+  }
+
+  QVector<int> saved_rows(items.count(), -1);
+  for (int i = 0; i < items.count(); ++i) {
+    // An item that's in the playlist twice only keeps one row.
+    QHash<PlaylistItem*, int>::iterator it =
+        saved_row_by_item.find(items[i].get());
+    if (it != saved_row_by_item.end()) {
+      saved_rows[i] = it.value();
+      saved_row_by_item.erase(it);
+    }
+  }
+
+  const QVector<bool> keep = LongestIncreasingRun(saved_rows);
+
+  QList<double> orders;
+  if (!AssignOrders(saved_rows, keep, &orders)) {
+    Compact(&ret);
+    orders.clear();
+    AssignOrders(saved_rows, keep, &orders);
+  }
+
+  // Anything that was saved but isn't used any more is removed.
+  QVector<bool> saved_row_used(saved_items_.count(), false);
+  for (int i = 0; i < items.count(); ++i) {
+    if (keep[i]) {
+      saved_row_used[saved_rows[i]] = true;
+    } else if (saved_rows[i] != -1) {
+      saved_row_used[saved_rows[i]] = true;
+      ret.moved_from_ << saved_orders_[saved_rows[i]];
+      ret.moved_to_ << orders[i];
+    } else {
+      ret.inserted_ << items[i];
+      ret.inserted_orders_ << orders[i];
+    }
+  }
+  for (int i = 0; i < saved_items_.count(); ++i) {
+    if (!saved_row_used[i]) ret.removed_ << saved_orders_[i];
+  }
+
+  saved_items_ = items;
+  saved_orders_ = orders;
+  changed_items_.clear();
+
+  return ret;
+}
+
+bool PlaylistJournal::AssignOrders(const QVector<int>& saved_rows,
+                                   const QVector<bool>& keep,
+                                   QList<double>* orders) const {
+  const int count = saved_rows.count();
+  bool have_previous = false;
+  double previous = 0.0;
+
+  int i = 0;
+  while (i < count) {
+    if (keep[i]) {
+      previous = saved_orders_[saved_rows[i]];
+      have_previous = true;
+      *orders << previous;
+      ++i;
+      continue;
+    }
+
+    // A run of rows that need new sort_orders, and the kept row after it.
+    int end = i;
+    while (end < count && !keep[end]) ++end;
+    const int run = end - i;
+
+    double lo, hi;
+    if (end < count) {
+      hi = saved_orders_[saved_rows[end]];
+      lo = have_previous ? previous : hi - (run + 1) * kOrderSpacing;
+    } else {
+      lo = have_previous ? previous : 0.0;
+      hi = lo + (run + 1) * kOrderSpacing;
+    }
+
+    const double step = (hi - lo) / (run + 1);
+    double last = lo;
+    for (int j = 0; j < run; ++j) {
+      const double order = lo + step * (j + 1);
+      if (!(order > last) || !(order < hi)) return false;
+      *orders << order;
+      last = order;
+    }
+
+    i = end;
+  }
+
+  return true;
+}
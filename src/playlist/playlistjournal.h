@@ -0,0 +1,103 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLAYLISTJOURNAL_H
+#define PLAYLISTJOURNAL_H
+
+#include <QList>
+#include <QMetaType>
+#include <QSet>
+#include <QVector>
+
+#include "playlistitem.h"
+
+// The rows PlaylistBackend has to change to bring a saved playlist up to
+// date.  Rows are identified by their sort_order, which is unique within a
+// playlist.  The backend applies them in this order:
+struct PlaylistChanges {
+  PlaylistChanges() : rewrite_(false), compact_(false) {}
+
+  bool is_empty() const {
+    return !rewrite_ && !compact_ && removed_.isEmpty() &&
+           moved_from_.isEmpty() && inserted_.isEmpty();
+  }
+
+  // Delete every row of the playlist.  All the items are then in inserted_.
+  bool rewrite_;
+
+  // Renumber every row, keeping their order, to kOrderSpacing, twice
+  // kOrderSpacing, and so on.  The other changes use the new numbers.
+  bool compact_;
+
+  // Rows to delete.
+  QList<double> removed_;
+
+  // Rows to give a new sort_order.
+  QList<double> moved_from_;
+  QList<double> moved_to_;
+
+  // Rows to add.
+  PlaylistItemList inserted_;
+  QList<double> inserted_orders_;
+};
+Q_DECLARE_METATYPE(PlaylistChanges);
+
+// Remembers how a playlist was last saved, so the next save only has to write
+// the rows that were added, removed or moved since then, instead of the whole
+// playlist.  Each row is saved with a sort_order, and new rows get one halfway
+// between their neighbours'.  Every so often, or when there's no room left
+// between two rows, the sort_orders are renumbered.
+class PlaylistJournal {
+ public:
+  PlaylistJournal();
+
+  static const double kOrderSpacing;
+  static const int kCompactAfterSaves;
+
+  // Starts again from a playlist that was saved with these rows.
+  void Reset(const PlaylistItemList& items, const QList<double>& orders);
+
+  // The item's metadata has changed, so it has to be saved again.
+  void ItemChanged(const PlaylistItemPtr& item);
+
+  // The last changes might not have been saved, so the next update rewrites
+  // the whole playlist.
+  void Invalidate();
+
+  // Works out what has to be written to save the playlist with these items,
+  // and from then on treats them as saved.
+  PlaylistChanges Update(const PlaylistItemList& items);
+
+  const QList<double>& saved_orders() const { return saved_orders_; }
+
+ private:
+  void Compact(PlaylistChanges* changes);
+
+  // Gives the items that aren't kept sort_orders between the ones that are.
+  // Returns false if there isn't room.
+  bool AssignOrders(const QVector<int>& saved_rows, const QVector<bool>& keep,
+                    QList<double>* orders) const;
+
+  PlaylistItemList saved_items_;
+  QList<double> saved_orders_;
+  QSet<PlaylistItem*> changed_items_;
+  int saves_since_compaction_;
+  bool rewrite_pending_;
+};
+
+#endif  // PLAYLISTJOURNAL_H
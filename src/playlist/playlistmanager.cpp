@@ -49,7 +49,8 @@ PlaylistManager::PlaylistManager(Application* app, QObject* parent)
       parser_(nullptr),
       playlist_container_(nullptr),
       current_(-1),
-      active_(-1) {
+      active_(-1),
+      initialized_(false) {
   connect(app_->player(), SIGNAL(Paused()), SLOT(SetActivePaused()));
   connect(app_->player(), SIGNAL(Playing()), SLOT(SetActivePlaying()));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(SetActiveStopped()));
@@ -57,6 +58,7 @@ PlaylistManager::PlaylistManager(Application* app, QObject* parent)
 
 PlaylistManager::~PlaylistManager() {
   for (const Data& data : playlists_.values()) {
+    data.p->SavePendingChanges();
     delete data.p;
   }
 }
@@ -77,15 +79,26 @@ void PlaylistManager::Init(LibraryBackend* library_backend,
           SLOT(SongsDiscovered(SongList)));
   connect(library_backend_, SIGNAL(SongsRatingChanged(SongList)),
           SLOT(SongsDiscovered(SongList)));
+  connect(library_backend_, SIGNAL(SongsAudioPropertiesChanged(SongList)),
+          SLOT(SongsDiscovered(SongList)));
 
+  // Restoring a big playlist is slow, so don't restore any of them until the
+  // one that's shown has been chosen.
   for (const PlaylistBackend::Playlist& p :
        playlist_backend->GetAllOpenPlaylists()) {
-    AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+    Playlist* playlist =
+        AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+    playlist->set_saved_item_count(p.item_count);
+    restore_queue_ << p.id;
   }
 
   // If no playlist exists then make a new one
   if (playlists_.isEmpty()) New(tr("Playlist"));
 
+  initialized_ = true;
+  current()->Restore();
+  active()->Restore();
+
   emit PlaylistManagerInitialized();
 }
 
@@ -121,11 +134,13 @@ Playlist* PlaylistManager::AddPlaylist(int id, const QString& name,
   connect(ret, SIGNAL(LoadTracksError(QString)), SIGNAL(Error(QString)));
   connect(ret, SIGNAL(PlayRequested(QModelIndex)),
           SIGNAL(PlayRequested(QModelIndex)));
+  connect(ret, SIGNAL(RestoreFinished()), SLOT(OneOfPlaylistsRestored()));
   connect(playlist_container_->view(),
           SIGNAL(ColumnAlignmentChanged(ColumnAlignmentMap)), ret,
           SLOT(SetColumnAlignment(ColumnAlignmentMap)));
 
   playlists_[id] = Data(ret, name);
+  if (initialized_) ret->Restore();
 
   emit PlaylistAdded(id, name, favorite);
 
@@ -300,7 +315,11 @@ bool PlaylistManager::Close(int id) {
   Data data = playlists_.take(id);
   emit PlaylistClosed(id);
 
-  if (!data.p->is_favorite()) {
+  if (data.p->is_favorite()) {
+    // Favorites stay in the database, so edits still waiting to be saved
+    // mustn't be lost with the playlist.
+    data.p->SavePendingChanges();
+  } else {
     playlist_backend_->RemovePlaylist(id);
     emit PlaylistDeleted(id);
   }
@@ -322,9 +341,15 @@ void PlaylistManager::OneOfPlaylistsChanged() {
   emit PlaylistChanged(qobject_cast<Playlist*>(sender()));
 }
 
+void PlaylistManager::OneOfPlaylistsRestored() {
+  emit PlaylistRestored(qobject_cast<Playlist*>(sender())->id());
+  RestoreNextPlaylist();
+}
+
 void PlaylistManager::SetCurrentPlaylist(int id) {
   Q_ASSERT(playlists_.contains(id));
   current_ = id;
+  if (initialized_) current()->Restore();
   emit CurrentChanged(current());
   UpdateSummaryText();
 }
@@ -337,11 +362,27 @@ void PlaylistManager::SetActivePlaylist(int id) {
   if (active_ != -1 && active_ != id) active()->set_current_row(-1);
 
   active_ = id;
+  if (initialized_) active()->Restore();
   emit ActiveChanged(active());
 
   sequence_->SetUsingDynamicPlaylist(active()->is_dynamic());
 }
 
+void PlaylistManager::RestoreNextPlaylist() {
+  // Only load one at a time, so the one that's shown doesn't have to wait.
+  for (const Data& data : playlists_) {
+    if (data.p->is_restoring()) return;
+  }
+
+  while (!restore_queue_.isEmpty()) {
+    const int id = restore_queue_.takeFirst();
+    if (playlists_.contains(id) && !playlists_[id].p->is_restored()) {
+      playlists_[id].p->Restore();
+      return;
+    }
+  }
+}
+
 void PlaylistManager::SetActiveToCurrent() {
   // Check if we need to update the active playlist.
   // By calling SetActiveToCurrent, the playlist manager emits the signal
@@ -129,6 +129,8 @@ signals:
   // Signals that one of manager's playlists has changed (new items, new
   // ordering etc.) - the argument shows which.
   void PlaylistChanged(Playlist* playlist);
+  // A playlist's saved items have been loaded.
+  void PlaylistRestored(int id);
   void EditingFinished(const QModelIndex& index);
   void PlayRequested(const QModelIndex& index);
 };
@@ -230,11 +232,13 @@ class PlaylistManager : public PlaylistManagerInterface {
   void SetActiveStopped();
 
   void OneOfPlaylistsChanged();
+  void OneOfPlaylistsRestored();
   void UpdateSummaryText();
   void SongsDiscovered(const SongList& songs);
   void ItemsLoadedForSavePlaylist(QFutureWatcher<SongList>* watcher,
                                   const QString& filename,
                                   Playlist::Path path_type);
+  void RestoreNextPlaylist();
 
  private:
   Playlist* AddPlaylist(int id, const QString& name,
@@ -262,6 +266,12 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   int current_;
   int active_;
+
+  // Playlists are only restored once Init() has decided which one to show.
+  // After that the others are restored one at a time in this order, unless
+  // they're shown first.
+  bool initialized_;
+  QList<int> restore_queue_;
 };
 
 #endif  // PLAYLISTMANAGER_H
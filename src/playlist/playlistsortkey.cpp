@@ -0,0 +1,316 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "playlistsortkey.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QFuture>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentRun>
+
+#include "playlist.h"
+#include "core/song.h"
+
+// QString::localeAwareCompare() uses strcoll() on these platforms, so the
+// same order can be had by comparing strxfrm() keys.
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+#define HAVE_COLLATION_KEYS
+#endif
+
+const int PlaylistSortKey::kThreadedSortRows = 20000;
+
+namespace {
+
+// Compares rows of a playlist by their keys.
+class RowLessThan {
+ public:
+  RowLessThan(const PlaylistSortKey* keys, Qt::SortOrder order)
+      : keys_(keys), descending_(order == Qt::DescendingOrder) {}
+
+  bool operator()(int a, int b) const {
+    return descending_ ? keys_[b] < keys_[a] : keys_[a] < keys_[b];
+  }
+
+ private:
+  const PlaylistSortKey* keys_;
+  bool descending_;
+};
+
+void CollateKeys(PlaylistSortKey* keys, const int* rows, int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    keys[rows[i]].Collate();
+  }
+}
+
+void SortRows(int* begin, int* end, RowLessThan less_than) {
+  std::stable_sort(begin, end, less_than);
+}
+
+void MergeRows(int* begin, int* middle, int* end, RowLessThan less_than) {
+  std::inplace_merge(begin, middle, end, less_than);
+}
+
+void WaitForAll(QList<QFuture<void>>* futures) {
+  for (QFuture<void>& future : *futures) {
+    future.waitForFinished();
+  }
+  futures->clear();
+}
+
+}  // namespace
+
+PlaylistSortKey::PlaylistSortKey()
+    : type_(Type_None), collated_(false), number_(0) {}
+
+PlaylistSortKey::PlaylistSortKey(int column, const Song& song)
+    : type_(Type_None), collated_(false), number_(0) {
+  switch (column) {
+    case Playlist::Column_Title:
+      SetLocaleText(song.title());
+      break;
+    case Playlist::Column_Artist:
+      SetLocaleText(song.artist());
+      break;
+    case Playlist::Column_Album:
+      SetLocaleText(song.album());
+      break;
+    case Playlist::Column_Length:
+      SetNumber(song.length_nanosec());
+      break;
+    case Playlist::Column_Track:
+      SetNumber(song.track());
+      break;
+    case Playlist::Column_Disc:
+      SetNumber(song.disc());
+      break;
+    case Playlist::Column_Year:
+      SetNumber(song.year());
+      break;
+    case Playlist::Column_Genre:
+      SetLocaleText(song.genre());
+      break;
+    case Playlist::Column_AlbumArtist:
+      SetLocaleText(song.playlist_albumartist());
+      break;
+    case Playlist::Column_Composer:
+      SetLocaleText(song.composer());
+      break;
+    case Playlist::Column_Performer:
+      SetLocaleText(song.performer());
+      break;
+    case Playlist::Column_Grouping:
+      SetLocaleText(song.grouping());
+      break;
+
+    case Playlist::Column_Rating:
+      SetNumber(song.rating());
+      break;
+    case Playlist::Column_PlayCount:
+      SetNumber(song.playcount());
+      break;
+    case Playlist::Column_SkipCount:
+      SetNumber(song.skipcount());
+      break;
+    case Playlist::Column_LastPlayed:
+      SetNumber(song.lastplayed());
+      break;
+    case Playlist::Column_Score:
+      SetNumber(song.score());
+      break;
+
+    case Playlist::Column_BPM:
+      SetNumber(song.bpm());
+      break;
+    case Playlist::Column_Bitrate:
+      SetNumber(song.bitrate());
+      break;
+    case Playlist::Column_Samplerate:
+      SetNumber(song.samplerate());
+      break;
+    case Playlist::Column_BaseFilename:
+      SetText(song.basefilename());
+      break;
+    case Playlist::Column_Filesize:
+      SetNumber(song.filesize());
+      break;
+    case Playlist::Column_Filetype:
+      SetNumber(song.filetype());
+      break;
+    case Playlist::Column_DateModified:
+      SetNumber(song.mtime());
+      break;
+    case Playlist::Column_DateCreated:
+      SetNumber(song.ctime());
+      break;
+
+    case Playlist::Column_Comment:
+      SetLocaleText(song.comment());
+      break;
+    case Playlist::Column_Filename:
+    case Playlist::Column_Source:
+      // QUrl compares its encoded form.
+      type_ = Type_Bytes;
+      bytes_ = song.url().toEncoded();
+      break;
+  }
+}
+
+void PlaylistSortKey::SetNumber(double number) {
+  type_ = Type_Number;
+  number_ = number;
+}
+
+void PlaylistSortKey::SetText(const QString& text) {
+  type_ = Type_Text;
+  text_ = text;
+}
+
+void PlaylistSortKey::SetLocaleText(const QString& text) {
+  type_ = Type_LocaleText;
+  text_ = text.toLower();
+}
+
+bool PlaylistSortKey::needs_collation() const {
+#ifdef HAVE_COLLATION_KEYS
+  // Qt compares empty strings without the locale.
+  return type_ == Type_LocaleText && !collated_ && !text_.isEmpty();
+#else
+  return false;
+#endif
+}
+
+void PlaylistSortKey::Collate() {
+#ifdef HAVE_COLLATION_KEYS
+  if (!needs_collation()) return;
+
+  const QByteArray local = text_.toLocal8Bit();
+  const size_t size = strxfrm(nullptr, local.constData(), 0);
+  bytes_ = QByteArray(size + 1, '\0');
+  strxfrm(bytes_.data(), local.constData(), size + 1);
+  bytes_.resize(size);
+  collated_ = true;
+#endif
+}
+
+bool PlaylistSortKey::operator<(const PlaylistSortKey& other) const {
+  switch (type_) {
+    case Type_None:
+      return false;
+    case Type_Number:
+      return number_ < other.number_;
+    case Type_Text:
+      return text_ < other.text_;
+    case Type_Bytes:
+      return bytes_ < other.bytes_;
+    case Type_LocaleText:
+      if (text_.isEmpty() || other.text_.isEmpty()) return text_ < other.text_;
+#ifdef HAVE_COLLATION_KEYS
+      // Strings the locale thinks are equal are ordered by their code points,
+      // like QString::localeAwareCompare() does.
+      if (bytes_ != other.bytes_) return bytes_ < other.bytes_;
+      return text_ < other.text_;
+#else
+      return QString::localeAwareCompare(text_, other.text_) < 0;
+#endif
+  }
+  return false;
+}
+
+void PlaylistSortKey::Sort(int column, Qt::SortOrder order,
+                           PlaylistItemList::iterator begin,
+                           PlaylistItemList::iterator end) {
+  const int count = end - begin;
+  if (count < 2) return;
+
+  const int threads = count >= kThreadedSortRows
+                          ? qMax(1, QThread::idealThreadCount())
+                          : 1;
+
+  // Items aren't safe to read from other threads, so the keys are built here
+  // and only collated in parallel.
+  QVector<PlaylistSortKey> keys(count);
+  PlaylistSortKey* key = keys.data();
+  QVector<int> uncollated;
+  for (int i = 0; i < count; ++i) {
+    const PlaylistItemPtr& item = *(begin + i);
+    key[i] = PlaylistSortKey(column, item->Metadata());
+    if (!key[i].needs_collation()) continue;
+
+    if (item->GetCachedSortKey(key[i].text_, &key[i].bytes_)) {
+      key[i].collated_ = true;
+    } else {
+      uncollated << i;
+    }
+  }
+
+  QList<QFuture<void>> futures;
+  if (threads == 1 || uncollated.count() < kThreadedSortRows) {
+    CollateKeys(key, uncollated.constData(), 0, uncollated.count());
+  } else {
+    const int keys_per_thread = (uncollated.count() + threads - 1) / threads;
+    for (int i = 0; i < uncollated.count(); i += keys_per_thread) {
+      futures << QtConcurrent::run(
+                     &CollateKeys, key, uncollated.constData(), i,
+                     qMin(i + keys_per_thread, uncollated.count()));
+    }
+    WaitForAll(&futures);
+  }
+  for (int i : uncollated) {
+    (*(begin + i))->SetCachedSortKey(key[i].text_, key[i].bytes_);
+  }
+
+  // Sort the row numbers rather than the items themselves, so moving them
+  // doesn't touch any reference counts.  Each thread sorts a slice, and then
+  // neighbouring slices are merged until there's only one left.  Both steps
+  // keep equal rows in order, so the whole sort does too.
+  QVector<int> rows(count);
+  for (int i = 0; i < count; ++i) rows[i] = i;
+  int* row = rows.data();
+  const RowLessThan less_than(key, order);
+
+  if (threads == 1) {
+    SortRows(row, row + count, less_than);
+  } else {
+    const int rows_per_thread = (count + threads - 1) / threads;
+    for (int i = 0; i < count; i += rows_per_thread) {
+      futures << QtConcurrent::run(&SortRows, row + i,
+                                   row + qMin(i + rows_per_thread, count),
+                                   less_than);
+    }
+    WaitForAll(&futures);
+
+    for (int width = rows_per_thread; width < count; width *= 2) {
+      for (int i = 0; i + width < count; i += 2 * width) {
+        futures << QtConcurrent::run(&MergeRows, row + i, row + i + width,
+                                     row + qMin(i + 2 * width, count),
+                                     less_than);
+      }
+      WaitForAll(&futures);
+    }
+  }
+
+  PlaylistItemList sorted;
+  sorted.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    sorted << *(begin + row[i]);
+  }
+  std::copy(sorted.begin(), sorted.end(), begin);
+}
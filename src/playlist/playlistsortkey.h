@@ -0,0 +1,72 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLAYLISTSORTKEY_H
+#define PLAYLISTSORTKEY_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "playlistitem.h"
+
+class Song;
+
+// A song's value in one playlist column, built so that comparing two of them
+// is cheap.  Text columns are compared like QString::localeAwareCompare()
+// compares their lowercased strings, but where Qt uses strcoll() the work is
+// done up front with strxfrm(), once per song instead of once per comparison.
+class PlaylistSortKey {
+ public:
+  PlaylistSortKey();
+  PlaylistSortKey(int column, const Song& song);
+
+  static const int kThreadedSortRows;
+
+  // Sorts the items by the column, keeping the order of items that compare
+  // equal.  Collation keys are cached on the items, and big playlists are
+  // sorted on several threads.
+  static void Sort(int column, Qt::SortOrder order,
+                   PlaylistItemList::iterator begin,
+                   PlaylistItemList::iterator end);
+
+  bool needs_collation() const;
+  void Collate();
+
+  bool operator<(const PlaylistSortKey& other) const;
+
+ private:
+  enum Type {
+    Type_None,
+    Type_Number,
+    Type_Text,
+    Type_Bytes,
+    Type_LocaleText,
+  };
+
+  void SetNumber(double number);
+  void SetText(const QString& text);
+  void SetLocaleText(const QString& text);
+
+  Type type_;
+  bool collated_;
+  double number_;
+  QString text_;
+  QByteArray bytes_;
+};
+
+#endif  // PLAYLISTSORTKEY_H
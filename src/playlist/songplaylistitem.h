@@ -30,6 +30,7 @@ class SongPlaylistItem : public PlaylistItem {
   // If it's a file related playlist item, this will restore it's CUE
   // attributes (if any) but won't parse the CUE!
   bool InitFromQuery(const SqlRow& query);
+  void ShareStrings(StringPool* pool) { song_.ShareStrings(pool); }
   void Reload();
 
   Song Metadata() const;
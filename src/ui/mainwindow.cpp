@@ -1721,7 +1721,8 @@ void MainWindow::EditTagDialogAccepted() {
   // This is really lame but we don't know what rows have changed
   ui_->playlist->view()->update();
 
-  app_->playlist_manager()->current()->Save();
+  app_->playlist_manager()->current()->ItemsReloaded(
+      edit_tag_dialog_->playlist_items());
 }
 
 void MainWindow::RenumberTracks() {
@@ -77,6 +77,9 @@ NowPlayingWidget::NowPlayingWidget(QWidget* parent)
       aww_(false),
       kittens_(nullptr),
       pending_kitten_(0) {
+  // The size follows the widget's width, and kittens are random anyway.
+  cover_loader_options_.use_thumbnail_cache_ = false;
+
   // Load settings
   QSettings s;
   s.beginGroup(kSettingsGroup);
@@ -0,0 +1,146 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QSignalSpy>
+
+#include "core/song.h"
+#include "core/utilities.h"
+#include "covers/albumcoverexporter.h"
+#include "covers/coverexportrunnable.h"
+
+namespace {
+
+class AlbumCoverExporterTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    root_ = Utilities::MakeTempDir("clementine-test");
+
+    result_.cancelled_ = false;
+    result_.export_downloaded_ = true;
+    result_.export_embedded_ = false;
+    result_.fileName_ = "folder";
+    result_.overwrite_ = AlbumCoverExport::OverwriteMode_All;
+    result_.forceSize_ = false;
+    result_.width_ = 0;
+    result_.height_ = 0;
+  }
+
+  virtual void TearDown() { Utilities::RemoveRecursive(root_); }
+
+  // Writes a PNG cover into a new album directory and returns a song from it.
+  Song MakeAlbum(const QString& name, const QColor& color) {
+    QDir(root_).mkdir(name);
+    const QString dir = root_ + "/" + name;
+
+    QImage image(40, 20, QImage::Format_RGB32);
+    image.fill(color.rgb());
+    image.save(dir + "/cover.png", "PNG");
+
+    Song song;
+    song.Init("Title", "Artist", name, 123);
+    song.set_url(QUrl::fromLocalFile(dir + "/song.mp3"));
+    song.set_art_manual(dir + "/cover.png");
+    return song;
+  }
+
+  // Exports the song's cover in this thread.  Returns true if it was written.
+  bool Export(const Song& song) {
+    CoverExportRunnable runnable(result_, song, &exporter_);
+    QSignalSpy exported(&runnable, SIGNAL(CoverExported()));
+    QSignalSpy skipped(&runnable, SIGNAL(CoverSkipped()));
+    runnable.run();
+    EXPECT_EQ(1, exported.count() + skipped.count());
+    return exported.count() == 1;
+  }
+
+  static QByteArray ReadFile(const QString& filename) {
+    QFile file(filename);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+  }
+
+  QString root_;
+  AlbumCoverExport::DialogResult result_;
+  AlbumCoverExporter exporter_;
+};
+
+TEST_F(AlbumCoverExporterTest, CopiesBytes) {
+  const Song song = MakeAlbum("album", Qt::red);
+
+  ASSERT_TRUE(Export(song));
+  EXPECT_EQ(ReadFile(root_ + "/album/cover.png"),
+            ReadFile(root_ + "/album/folder.png"));
+}
+
+TEST_F(AlbumCoverExporterTest, SkipsUpToDateTargets) {
+  const Song song = MakeAlbum("album", Qt::red);
+
+  ASSERT_TRUE(Export(song));
+  EXPECT_FALSE(Export(song));
+
+  // Resizing gives a different file, so it's written.
+  result_.forceSize_ = true;
+  result_.width_ = 10;
+  result_.height_ = 10;
+  EXPECT_TRUE(Export(song));
+  EXPECT_EQ(QSize(10, 10), QImageReader(root_ + "/album/folder.png").size());
+  EXPECT_FALSE(Export(song));
+}
+
+TEST_F(AlbumCoverExporterTest, DoesntOverwriteByDefault) {
+  const Song song = MakeAlbum("album", Qt::red);
+  QFile::copy(root_ + "/album/cover.png", root_ + "/album/folder.png");
+  result_.overwrite_ = AlbumCoverExport::OverwriteMode_None;
+
+  EXPECT_FALSE(Export(song));
+}
+
+TEST_F(AlbumCoverExporterTest, ResizesSharedArtOnce) {
+  const Song first = MakeAlbum("first", Qt::red);
+  const Song second = MakeAlbum("second", Qt::red);
+  const Song third = MakeAlbum("third", Qt::blue);
+
+  result_.forceSize_ = true;
+  result_.width_ = 10;
+  result_.height_ = 10;
+  ASSERT_TRUE(Export(first));
+
+  // Replace the first export with something else the same size, so we can
+  // tell that the second album copied it instead of resizing its own cover.
+  QImage marker(10, 10, QImage::Format_RGB32);
+  marker.fill(QColor(Qt::green).rgb());
+  ASSERT_TRUE(marker.save(root_ + "/first/folder.png", "PNG"));
+
+  ASSERT_TRUE(Export(second));
+  EXPECT_EQ(ReadFile(root_ + "/first/folder.png"),
+            ReadFile(root_ + "/second/folder.png"));
+
+  // Different art is resized on its own.
+  ASSERT_TRUE(Export(third));
+  EXPECT_EQ(QColor(Qt::blue).rgb(),
+            QImage(root_ + "/third/folder.png").pixel(0, 0));
+}
+
+}  // namespace
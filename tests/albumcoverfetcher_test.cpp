@@ -15,74 +15,201 @@
    along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "core/albumcoverfetcher.h"
-#include "core/networkaccessmanager.h"
-
-#include <lastfm/ws.h>
+#include "gtest/gtest.h"
+#include "test_utils.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QEventLoop>
+#include <QImage>
+#include <QNetworkAccessManager>
 #include <QSignalSpy>
+#include <QTimer>
 
-#include "mock_networkaccessmanager.h"
-#include "gtest/gtest.h"
+#include "core/closure.h"
+#include "covers/albumcoverfetcher.h"
+#include "covers/coverprovider.h"
+#include "covers/coverproviders.h"
+#include "httprangeserver.h"
 
 namespace {
 
-class AlbumCoverFetcherTest : public ::testing::Test {
- protected:
-  static void SetUpTestCase() {
-    lastfm::ws::ApiKey = "foobar";
-
-    // Lastfm takes ownership of this.
-    mock_network_ = new MockNetworkAccessManager;
-    lastfm::setNetworkAccessManager(mock_network_);
+// Answers every search from the event loop with the same results, or fails
+// it, and remembers when each search was started.
+class FakeCoverProvider : public CoverProvider {
+ public:
+  FakeCoverProvider(float rate, int burst, QObject* parent)
+      : CoverProvider("fake", parent),
+        fail_(false),
+        rate_(rate),
+        burst_(burst) {
+    clock_.start();
   }
 
-  void SetUp() {
-    network_ = new NetworkAccessManager(nullptr, mock_network_);
+  bool StartSearch(const QString& artist, const QString& album, int id) {
+    start_msecs_ << clock_.elapsed();
+
+    QTimer* timer = new QTimer(this);
+    timer->setSingleShot(true);
+    NewClosure(timer, SIGNAL(timeout()), [this, timer, id]() {
+      if (fail_) {
+        emit SearchFailed(id);
+      } else {
+        emit SearchFinished(id, results_);
+      }
+      timer->deleteLater();
+    });
+    timer->start(0);
+    return true;
   }
 
-  void TearDown() {
-    delete network_;
+  float requests_per_second() const { return rate_; }
+  int max_burst() const { return burst_; }
+
+  bool fail_;
+  CoverSearchResults results_;
+  QList<qint64> start_msecs_;
+
+ private:
+  float rate_;
+  int burst_;
+  QElapsedTimer clock_;
+};
+
+class AlbumCoverFetcherTest : public ::testing::Test {
+ protected:
+  static QByteArray PngData() {
+    QImage image(16, 16, QImage::Format_RGB32);
+    image.fill(0xff0000);
+
+    QByteArray ret;
+    QBuffer buffer(&ret);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return ret;
   }
 
-  static void TearDownTestCase() {
-    delete mock_network_;
+  // Runs the event loop until the spy has seen count signals.
+  static void WaitFor(QSignalSpy* spy, int count) {
+    QElapsedTimer timer;
+    timer.start();
+    while (spy->count() < count && timer.elapsed() < 5000) {
+      QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    }
   }
 
-  static MockNetworkAccessManager* mock_network_;
-  NetworkAccessManager* network_;
+  QNetworkAccessManager network_;
+  CoverProviders providers_;
 };
 
-MockNetworkAccessManager* AlbumCoverFetcherTest::mock_network_;
+TEST_F(AlbumCoverFetcherTest, SharesIdenticalRequests) {
+  HttpRangeServer server(PngData());
+  FakeCoverProvider* provider = new FakeCoverProvider(5.0, 5, &providers_);
+  CoverSearchResult result;
+  result.description = "Foo - Bar";
+  result.image_url = server.url();
+  provider->results_ << result;
+  providers_.AddProvider(provider);
+
+  AlbumCoverFetcher fetcher(&providers_, nullptr, &network_);
+  QSignalSpy spy(&fetcher, SIGNAL(AlbumCoverFetched(quint64, QImage,
+                                                    CoverSearchStatistics)));
+  ASSERT_TRUE(spy.isValid());
 
+  const quint64 id1 = fetcher.FetchAlbumCover("Foo", "Bar");
+  const quint64 id2 = fetcher.FetchAlbumCover("foo ", "BAR");
+  WaitFor(&spy, 2);
 
-TEST_F(AlbumCoverFetcherTest, FetchesAlbumCover) {
-  QByteArray data("<lfm status=\"ok\"><album><name>Bar</name><artist>Foo</artist>"
-                  "<image size=\"large\">http://example.com/image.jpg</image></album></lfm>");
+  ASSERT_EQ(2, spy.count());
+  EXPECT_EQ(1, provider->start_msecs_.count());
+  EXPECT_EQ(1, server.request_count());
 
-  QMap<QString, QString> params;
-  params["artist"] = "Foo";
-  params["album"] = "Bar";
-  params["api_key"] = "foobar";
-  params["method"] = "album.getInfo";
-  MockNetworkReply* get_info_reply = mock_network_->ExpectGet("audioscrobbler", params, 200, data);
-  params.clear();
-  MockNetworkReply* album_reply = mock_network_->ExpectGet("http://example.com/image.jpg", params, 200, "");
+  EXPECT_EQ(id1, spy[0][0].value<quint64>());
+  EXPECT_EQ(id2, spy[1][0].value<quint64>());
+  EXPECT_FALSE(spy[0][1].value<QImage>().isNull());
+  EXPECT_FALSE(spy[1][1].value<QImage>().isNull());
 
-  AlbumCoverFetcher fetcher(network_, nullptr);
-  QSignalSpy spy(&fetcher, SIGNAL(AlbumCoverFetched(quint64, const QImage&)));
-  ASSERT_TRUE(spy.isValid());
-  fetcher.FetchAlbumCover("Foo", "Bar");
+  const CoverSearchStatistics duplicate =
+      spy[1][2].value<CoverSearchStatistics>();
+  EXPECT_EQ(1u, duplicate.deduplicated_requests_);
+  EXPECT_EQ(0u, duplicate.network_requests_made_);
+}
+
+TEST_F(AlbumCoverFetcherTest, RemembersMisses) {
+  FakeCoverProvider* provider = new FakeCoverProvider(5.0, 5, &providers_);
+  providers_.AddProvider(provider);
+
+  AlbumCoverFetcher fetcher(&providers_, nullptr, &network_);
+  QSignalSpy spy(&fetcher, SIGNAL(AlbumCoverFetched(quint64, QImage,
+                                                    CoverSearchStatistics)));
+
+  // The miss cache is shared by every fetcher, so use an album no other test
+  // does.
+  fetcher.FetchAlbumCover("Nobody", "Missing");
+  WaitFor(&spy, 1);
+  ASSERT_EQ(1, spy.count());
+  EXPECT_TRUE(spy[0][1].value<QImage>().isNull());
+
+  fetcher.FetchAlbumCover("Nobody", "Missing");
+  WaitFor(&spy, 2);
+  ASSERT_EQ(2, spy.count());
+  EXPECT_TRUE(spy[1][1].value<QImage>().isNull());
+  EXPECT_EQ(1, provider->start_msecs_.count());
+  EXPECT_EQ(1u, spy[1][2].value<CoverSearchStatistics>().cached_misses_);
+
+  // Searches always go to the providers.
+  QSignalSpy search_spy(&fetcher,
+                        SIGNAL(SearchFinished(quint64, CoverSearchResults,
+                                              CoverSearchStatistics)));
+  fetcher.SearchForCovers("Nobody", "Missing");
+  WaitFor(&search_spy, 1);
+  EXPECT_EQ(1, search_spy.count());
+  EXPECT_EQ(2, provider->start_msecs_.count());
+}
+
+TEST_F(AlbumCoverFetcherTest, DoesntRememberFailures) {
+  FakeCoverProvider* provider = new FakeCoverProvider(5.0, 5, &providers_);
+  provider->fail_ = true;
+  providers_.AddProvider(provider);
+
+  AlbumCoverFetcher fetcher(&providers_, nullptr, &network_);
+  QSignalSpy spy(&fetcher, SIGNAL(AlbumCoverFetched(quint64, QImage,
+                                                    CoverSearchStatistics)));
+
+  fetcher.FetchAlbumCover("Nobody", "Unreachable");
+  WaitFor(&spy, 1);
+  ASSERT_EQ(1, spy.count());
+  EXPECT_TRUE(spy[0][1].value<QImage>().isNull());
+
+  // The provider is asked again.
+  fetcher.FetchAlbumCover("Nobody", "Unreachable");
+  WaitFor(&spy, 2);
+  ASSERT_EQ(2, spy.count());
+  EXPECT_EQ(2, provider->start_msecs_.count());
+  EXPECT_EQ(0u, spy[1][2].value<CoverSearchStatistics>().cached_misses_);
+}
+
+TEST_F(AlbumCoverFetcherTest, RateLimitsProviders) {
+  FakeCoverProvider* provider = new FakeCoverProvider(10.0, 1, &providers_);
+  providers_.AddProvider(provider);
+
+  AlbumCoverFetcher fetcher(&providers_, nullptr, &network_);
+  QSignalSpy spy(&fetcher,
+                 SIGNAL(SearchFinished(quint64, CoverSearchResults,
+                                       CoverSearchStatistics)));
 
-  get_info_reply->Done();
-  QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+  fetcher.SearchForCovers("Artist", "Album 1");
+  fetcher.SearchForCovers("Artist", "Album 2");
+  fetcher.SearchForCovers("Artist", "Album 3");
+  WaitFor(&spy, 3);
 
-  album_reply->Done();
-  QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+  ASSERT_EQ(3, spy.count());
+  ASSERT_EQ(3, provider->start_msecs_.count());
 
-  EXPECT_EQ(1, spy.count());
+  // One token every 100ms, allowing for the timer firing a little early.
+  EXPECT_GE(provider->start_msecs_[1] - provider->start_msecs_[0], 90);
+  EXPECT_GE(provider->start_msecs_[2] - provider->start_msecs_[1], 90);
 }
 
 }  // namespace
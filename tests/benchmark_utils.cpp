@@ -0,0 +1,78 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark_utils.h"
+
+#include "gtest/gtest.h"
+
+#include <QSignalSpy>
+
+#include "core/timeconstants.h"
+#include "library/directory.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+int SizeFromEnvironment(const char* name, int default_value) {
+  bool ok = false;
+  const int value = qgetenv(name).toInt(&ok);
+  return ok && value > 0 ? value : default_value;
+}
+
+void InitBenchmarkLibrary(Database* database, LibraryBackend* backend,
+                          int* directory_id) {
+  backend->Init(database, Library::kSongsTable, Library::kDirsTable,
+                Library::kSubdirsTable, Library::kFtsTable);
+
+  QSignalSpy spy(backend,
+                 SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)));
+  backend->AddDirectory("/tmp");
+  ASSERT_EQ(1, spy.count());
+  *directory_id = spy[0][0].value<Directory>().id;
+}
+
+Song MakeBenchmarkSong(int i) {
+  const int album = i / kBenchmarkSongsPerAlbum;
+  const int artist = album / kBenchmarkAlbumsPerArtist;
+
+  Song song;
+  song.Init(QString("Title %1").arg(i), QString("Artist %1").arg(artist),
+            QString("Album %1").arg(album), 180 * kNsecPerSec);
+  song.set_albumartist(song.artist());
+  song.set_track(i % kBenchmarkSongsPerAlbum + 1);
+  song.set_year(1960 + album % 50);
+  song.set_genre(QString("Genre %1").arg(artist % 20));
+  return song;
+}
+
+SongList MakeBenchmarkSongs(int count, int directory_id) {
+  SongList ret;
+  for (int i = 0; i < count; ++i) {
+    Song song = MakeBenchmarkSong(i);
+    const QString dir =
+        QString("/tmp/%1/%2").arg(song.artist(), song.album());
+    song.set_directory_id(directory_id);
+    song.set_url(QUrl::fromLocalFile(QString("%1/%2.ogg").arg(dir).arg(i)));
+    song.set_art_automatic(dir + "/cover.jpg");
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    song.set_filetype(Song::Type_OggVorbis);
+    ret << song;
+  }
+  return ret;
+}
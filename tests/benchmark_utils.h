@@ -0,0 +1,48 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_UTILS_H
+#define BENCHMARK_UTILS_H
+
+#include "core/song.h"
+
+class Database;
+class LibraryBackend;
+
+// Synthetic songs have this many tracks on each album and this many albums by
+// each artist.
+const int kBenchmarkSongsPerAlbum = 10;
+const int kBenchmarkAlbumsPerArtist = 4;
+
+// Returns the positive integer in the environment variable name, or
+// default_value if it isn't set.
+int SizeFromEnvironment(const char* name, int default_value);
+
+// Initialises backend with the library tables in database and adds a
+// directory for synthetic songs to live in.  Contains gtest assertions, so
+// call it inside ASSERT_NO_FATAL_FAILURE.
+void InitBenchmarkLibrary(Database* database, LibraryBackend* backend,
+                          int* directory_id);
+
+// Returns the tags of the i'th synthetic song.
+Song MakeBenchmarkSong(int i);
+
+// Returns count synthetic songs as if they were files in the directory.
+SongList MakeBenchmarkSongs(int count, int directory_id);
+
+#endif  // BENCHMARK_UTILS_H
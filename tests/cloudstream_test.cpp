@@ -0,0 +1,179 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QNetworkAccessManager>
+
+#include "cloudstream.h"
+#include "httprangeserver.h"
+
+namespace {
+
+class CloudStreamTest : public ::testing::Test {
+ protected:
+  // Each test starts with nothing learnt from earlier files.
+  virtual void SetUp() { CloudStream::ResetPrefixBytes(); }
+
+  // Some data where every byte depends on its offset.
+  static QByteArray MakeData(int size) {
+    QByteArray ret(size, '\0');
+    for (int i = 0; i < size; ++i) {
+      ret[i] = char((i * 7) % 251);
+    }
+    return ret;
+  }
+
+  static QByteArray Id3v2File(int tag_size, int size) {
+    QByteArray ret = MakeData(size);
+    ret.replace(0, 10, QByteArray("ID3\x04\x00\x00", 6) +
+                           char((tag_size >> 21) & 0x7f) +
+                           char((tag_size >> 14) & 0x7f) +
+                           char((tag_size >> 7) & 0x7f) +
+                           char(tag_size & 0x7f));
+    return ret;
+  }
+
+  static QByteArray Atom(const char* type, int size) {
+    QByteArray ret;
+    ret.append(char(size >> 24));
+    ret.append(char(size >> 16));
+    ret.append(char(size >> 8));
+    ret.append(char(size));
+    ret.append(type, 4);
+    return ret;
+  }
+
+  // Reads some bytes through the stream and checks they match the file.
+  static void ExpectRead(CloudStream* stream, const QByteArray& data,
+                         int offset, int length) {
+    stream->seek(offset, TagLib::IOStream::Beginning);
+    const TagLib::ByteVector bytes = stream->readBlock(length);
+    EXPECT_EQ(data.mid(offset, length),
+              QByteArray(bytes.data(), bytes.size()));
+  }
+
+  QNetworkAccessManager network_;
+};
+
+TEST_F(CloudStreamTest, SmallFileIsOneRequest) {
+  const QByteArray data = MakeData(50 * 1024);
+  HttpRangeServer server(data);
+  CloudStream stream(server.url(), "small.ogg", data.size(), QString(),
+                     &network_);
+
+  stream.Precache();
+  EXPECT_EQ(1, server.request_count());
+
+  ExpectRead(&stream, data, 0, 1024);
+  ExpectRead(&stream, data, data.size() - 4096, 4096);
+  EXPECT_EQ(1, stream.num_requests());
+  EXPECT_EQ(data.size(), stream.cached_bytes());
+}
+
+TEST_F(CloudStreamTest, PrecachesStartAndEnd) {
+  const QByteArray data = MakeData(1024 * 1024);
+  HttpRangeServer server(data);
+  CloudStream stream(server.url(), "song.wma", data.size(), QString(),
+                     &network_);
+
+  stream.Precache();
+  EXPECT_EQ(2, server.request_count());
+
+  ExpectRead(&stream, data, 0, 1024);
+  ExpectRead(&stream, data, 30000, 20000);
+  ExpectRead(&stream, data, data.size() - 128, 128);
+  EXPECT_EQ(2, stream.num_requests());
+}
+
+TEST_F(CloudStreamTest, MissesReadAhead) {
+  const QByteArray data = MakeData(1024 * 1024);
+  HttpRangeServer server(data);
+  CloudStream stream(server.url(), "song.ape", data.size(), QString(),
+                     &network_);
+
+  ExpectRead(&stream, data, 300000, 100);
+  EXPECT_EQ(1, stream.num_requests());
+
+  // The blocks after the miss were fetched with it.
+  ExpectRead(&stream, data, 310000, 30000);
+  EXPECT_EQ(1, stream.num_requests());
+}
+
+TEST_F(CloudStreamTest, FetchesWholeId3v2Tag) {
+  const int kTagSize = 200 * 1024;
+  const QByteArray data = Id3v2File(kTagSize, 2 * 1024 * 1024);
+
+  HttpRangeServer server(data);
+  CloudStream stream(server.url(), "first.mp3", data.size(), QString(),
+                     &network_);
+  stream.Precache();
+  EXPECT_EQ(3, server.request_count());
+
+  ExpectRead(&stream, data, 0, kTagSize + 10);
+  ExpectRead(&stream, data, kTagSize + 10, 4096);
+  EXPECT_EQ(3, stream.num_requests());
+
+  // The next MP3 fetches the whole tag in the first request.
+  HttpRangeServer server2(data);
+  CloudStream stream2(server2.url(), "second.mp3", data.size(), QString(),
+                      &network_);
+  stream2.Precache();
+  EXPECT_EQ(2, server2.request_count());
+
+  ExpectRead(&stream2, data, 0, kTagSize + 10);
+  EXPECT_EQ(2, stream2.num_requests());
+}
+
+TEST_F(CloudStreamTest, FetchesMp4MoovAtEnd) {
+  const int kMdatSize = 1024 * 1024;
+  const int kMoovSize = 100 * 1024;
+  QByteArray data = Atom("ftyp", 24) + MakeData(16);
+  data += Atom("mdat", kMdatSize) + MakeData(kMdatSize - 8);
+  data += Atom("moov", kMoovSize) + MakeData(kMoovSize - 8);
+
+  HttpRangeServer server(data);
+  CloudStream stream(server.url(), "song.m4a", data.size(), QString(),
+                     &network_);
+  stream.Precache();
+  EXPECT_EQ(2, server.request_count());
+  EXPECT_TRUE(server.ranges()[1].endsWith(QString("-%1").arg(data.size() - 1)));
+
+  ExpectRead(&stream, data, 24 + kMdatSize, kMoovSize);
+  EXPECT_EQ(2, stream.num_requests());
+}
+
+TEST_F(CloudStreamTest, FindsMp4MoovAtStart) {
+  const int kMoovSize = 20 * 1024;
+  const int kMdatSize = 1024 * 1024;
+  QByteArray data = Atom("ftyp", 24) + MakeData(16);
+  data += Atom("moov", kMoovSize) + MakeData(kMoovSize - 8);
+  data += Atom("mdat", kMdatSize) + MakeData(kMdatSize - 8);
+
+  HttpRangeServer server(data);
+  CloudStream stream(server.url(), "song.mp4", data.size(), QString(),
+                     &network_);
+  stream.Precache();
+
+  // moov is inside the prefix, and MP4 doesn't need the end of the file.
+  EXPECT_EQ(1, server.request_count());
+  ExpectRead(&stream, data, 24, kMoovSize + 8);
+  EXPECT_EQ(1, stream.num_requests());
+}
+
+}  // namespace
@@ -0,0 +1,126 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/utilities.h"
+#include "library/directorylisting.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+namespace {
+
+class DirectoryListingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    root_ = Utilities::MakeTempDir("clementine-test");
+    QDir(root_).mkdir("subdir");
+    QDir(root_).mkdir(".hidden");
+    WriteFile(root_ + "/song.mp3", "12345");
+    WriteFile(root_ + "/subdir/nested.mp3", "1");
+  }
+
+  virtual void TearDown() { Utilities::RemoveRecursive(root_); }
+
+  static void WriteFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+    file.write(data);
+  }
+
+  static QStringList Names(const DirectoryListing& listing) {
+    QStringList ret;
+    for (const DirectoryListing::Entry& entry : listing.entries()) {
+      ret << entry.name_;
+    }
+    ret.sort();
+    return ret;
+  }
+
+  QString root_;
+};
+
+TEST_F(DirectoryListingTest, ListsImmediateChildren) {
+  DirectoryListing listing(root_);
+  EXPECT_EQ(QStringList() << ".hidden"
+                          << "song.mp3"
+                          << "subdir",
+            Names(listing));
+
+  const DirectoryListing::Entry* song = listing.Find(root_ + "/song.mp3");
+  ASSERT_TRUE(song);
+  EXPECT_TRUE(song->exists_);
+  EXPECT_FALSE(song->is_dir_);
+  EXPECT_EQ(5, song->size_);
+  EXPECT_EQ(root_ + "/song.mp3", song->path_);
+
+  const DirectoryListing::Entry* subdir = listing.Find(root_ + "/subdir");
+  ASSERT_TRUE(subdir);
+  EXPECT_TRUE(subdir->is_dir_);
+  EXPECT_FALSE(subdir->is_hidden());
+}
+
+TEST_F(DirectoryListingTest, OnlyCoversImmediateChildren) {
+  DirectoryListing listing(root_);
+  EXPECT_TRUE(listing.Covers(root_ + "/missing.cue"));
+  EXPECT_FALSE(listing.Contains(root_ + "/missing.cue"));
+
+  EXPECT_FALSE(listing.Covers(root_ + "/subdir/nested.mp3"));
+  EXPECT_FALSE(listing.Contains(root_ + "/subdir/nested.mp3"));
+  EXPECT_FALSE(listing.Covers(root_ + "other/song.mp3"));
+}
+
+TEST_F(DirectoryListingTest, MissingDirectoryIsEmpty) {
+  DirectoryListing listing(root_ + "/missing");
+  EXPECT_TRUE(listing.entries().isEmpty());
+}
+
+TEST_F(DirectoryListingTest, Stat) {
+  const DirectoryListing::Entry song =
+      DirectoryListing::Stat(root_ + "/song.mp3");
+  EXPECT_TRUE(song.exists_);
+  EXPECT_EQ("song.mp3", song.name_);
+  EXPECT_EQ(5, song.size_);
+
+  EXPECT_FALSE(DirectoryListing::Stat(root_ + "/missing").exists_);
+}
+
+#ifdef Q_OS_UNIX
+TEST_F(DirectoryListingTest, FollowsSymlinks) {
+  QFile::link(root_ + "/subdir", root_ + "/link");
+  QFile::link(root_ + "/missing", root_ + "/dangling");
+
+  DirectoryListing listing(root_);
+  const DirectoryListing::Entry* link = listing.Find(root_ + "/link");
+  ASSERT_TRUE(link);
+  EXPECT_TRUE(link->is_dir_);
+  EXPECT_TRUE(link->is_symlink_);
+
+  EXPECT_FALSE(listing.Contains(root_ + "/dangling"));
+  EXPECT_TRUE(DirectoryListing::Stat(root_ + "/link").is_symlink_);
+
+  // RemoveRecursive would follow them.
+  QFile::remove(root_ + "/link");
+  QFile::remove(root_ + "/dangling");
+}
+#endif
+
+}  // namespace
@@ -0,0 +1,112 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "core/foldingtokenizer.h"
+
+#include <QStringList>
+
+namespace {
+
+int AppendToken(void* context, int, const char* token, int bytes, int, int) {
+  reinterpret_cast<QStringList*>(context)
+      ->append(QString::fromUtf8(token, bytes));
+  return SQLITE_OK;
+}
+
+QStringList Tokenize(const QString& text) {
+  const QByteArray utf8 = text.toUtf8();
+  QStringList ret;
+  FoldingTokenizer::Tokenize(utf8.constData(), utf8.size(), &ret,
+                             &AppendToken);
+  return ret;
+}
+
+TEST(FoldingTokenizerTest, SplitsAndLowercases) {
+  EXPECT_EQ(QStringList() << "ace"
+                          << "of"
+                          << "spades",
+            Tokenize("Ace of  Spades!"));
+}
+
+TEST(FoldingTokenizerTest, FoldsDiacritics) {
+  EXPECT_EQ(QStringList() << "motorhead"
+                          << "bjork"
+                          << "strasse",
+            Tokenize(QString::fromUtf8("Motörhead Björk Straße")));
+}
+
+TEST(FoldingTokenizerTest, DropsCombiningMarks) {
+  // "e" followed by a combining acute accent.
+  EXPECT_EQ(QStringList() << "ecole", Tokenize(QString::fromUtf8("e\xcc\x81"
+                                                                 "cole")));
+}
+
+TEST(FoldingTokenizerTest, LowercasesCyrillic) {
+  EXPECT_EQ(QStringList() << QString::fromUtf8("кино"),
+            Tokenize(QString::fromUtf8("КИНО")));
+}
+
+TEST(FoldingTokenizerTest, ReportsByteOffsets) {
+  struct Offsets {
+    static int Append(void* context, int, const char*, int, int start,
+                      int end) {
+      reinterpret_cast<QList<int>*>(context)->append(start);
+      reinterpret_cast<QList<int>*>(context)->append(end);
+      return SQLITE_OK;
+    }
+  };
+
+  const QByteArray utf8 = QString::fromUtf8("ö ab").toUtf8();
+  QList<int> offsets;
+  FoldingTokenizer::Tokenize(utf8.constData(), utf8.size(), &offsets,
+                             &Offsets::Append);
+  EXPECT_EQ(QList<int>() << 0 << 2 << 3 << 5, offsets);
+}
+
+TEST(FoldingTokenizerTest, PrefixSearch) {
+  sqlite3* db = nullptr;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(":memory:", &db));
+  if (!FoldingTokenizer::Register(db)) {
+    sqlite3_close(db);
+    return;  // sqlite was built without FTS5.
+  }
+
+  char* errmsg = nullptr;
+  ASSERT_EQ(SQLITE_OK,
+            sqlite3_exec(db,
+                         "CREATE VIRTUAL TABLE foo USING fts5(title,"
+                         " tokenize = 'clementine', prefix = '2 3');"
+                         "INSERT INTO foo (title) VALUES ('Motörhead');",
+                         nullptr, nullptr, &errmsg))
+      << errmsg;
+
+  sqlite3_stmt* statement = nullptr;
+  ASSERT_EQ(SQLITE_OK,
+            sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM foo WHERE foo MATCH ?",
+                               -1, &statement, nullptr));
+  sqlite3_bind_text(statement, 1, "title:\"MOT\"*", -1, SQLITE_STATIC);
+  ASSERT_EQ(SQLITE_ROW, sqlite3_step(statement));
+  EXPECT_EQ(1, sqlite3_column_int(statement, 0));
+
+  sqlite3_finalize(statement);
+  sqlite3_close(db);
+}
+
+}  // namespace
@@ -0,0 +1,86 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "httprangeserver.h"
+
+#include <QHostAddress>
+#include <QRegExp>
+#include <QTcpSocket>
+
+HttpRangeServer::HttpRangeServer(const QByteArray& data, QObject* parent)
+    : QTcpServer(parent), data_(data) {
+  connect(this, SIGNAL(newConnection()), SLOT(NewConnection()));
+  listen(QHostAddress::LocalHost);
+}
+
+QUrl HttpRangeServer::url() const {
+  return QUrl(QString("http://127.0.0.1:%1/file").arg(serverPort()));
+}
+
+void HttpRangeServer::NewConnection() {
+  while (QTcpSocket* socket = nextPendingConnection()) {
+    buffers_.remove(socket);
+    connect(socket, SIGNAL(readyRead()), SLOT(ReadyRead()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+  }
+}
+
+void HttpRangeServer::ReadyRead() {
+  QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+  QByteArray& buffer = buffers_[socket];
+  buffer.append(socket->readAll());
+
+  // GET requests have no body, so each one ends with a blank line.
+  int end = -1;
+  while ((end = buffer.indexOf("\r\n\r\n")) != -1) {
+    const QByteArray request = buffer.left(end);
+    buffer.remove(0, end + 4);
+    Respond(socket, request);
+  }
+}
+
+void HttpRangeServer::Respond(QTcpSocket* socket, const QByteArray& request) {
+  int start = 0;
+  int end = data_.size() - 1;
+
+  QRegExp range_re("\r\nRange: bytes=(\\d+)-(\\d+)", Qt::CaseInsensitive);
+  const bool has_range = range_re.indexIn(QString::fromAscii(request)) != -1;
+  if (has_range) {
+    start = range_re.cap(1).toInt();
+    end = qMin(range_re.cap(2).toInt(), data_.size() - 1);
+    ranges_ << QString("%1-%2").arg(start).arg(end);
+  } else {
+    ranges_ << QString();
+  }
+
+  QByteArray response;
+  if (has_range) {
+    response = "HTTP/1.1 206 Partial Content\r\n";
+    response += QString("Content-Range: bytes %1-%2/%3\r\n")
+                    .arg(start)
+                    .arg(end)
+                    .arg(data_.size())
+                    .toAscii();
+  } else {
+    response = "HTTP/1.1 200 OK\r\n";
+  }
+  response += QString("Content-Length: %1\r\n").arg(end - start + 1).toAscii();
+  response += "Content-Type: application/octet-stream\r\n\r\n";
+  response += data_.mid(start, end - start + 1);
+  socket->write(response);
+}
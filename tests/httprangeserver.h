@@ -0,0 +1,54 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HTTPRANGESERVER_H
+#define HTTPRANGESERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include <QTcpServer>
+#include <QUrl>
+
+class QTcpSocket;
+
+// Serves one file over HTTP on localhost, honouring single byte ranges like
+// the cloud storage services do.  Every request's Range header is recorded so
+// tests can check how many round trips were made.
+class HttpRangeServer : public QTcpServer {
+  Q_OBJECT
+ public:
+  explicit HttpRangeServer(const QByteArray& data, QObject* parent = nullptr);
+
+  QUrl url() const;
+  int request_count() const { return ranges_.count(); }
+  const QStringList& ranges() const { return ranges_; }
+
+ private slots:
+  void NewConnection();
+  void ReadyRead();
+
+ private:
+  void Respond(QTcpSocket* socket, const QByteArray& request);
+
+  QByteArray data_;
+  QHash<QTcpSocket*, QByteArray> buffers_;
+  QStringList ranges_;
+};
+
+#endif  // HTTPRANGESERVER_H
@@ -0,0 +1,410 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "benchmark_utils.h"
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QSignalSpy>
+#include <QSqlDriver>
+#include <QThread>
+#include <QTime>
+#include <QTimer>
+#include <QtDebug>
+
+#include <sqlite3.h>
+
+#include "tagreader.h"
+#include "core/database.h"
+#include "core/song.h"
+#include "core/tagreaderclient.h"
+#include "core/taskmanager.h"
+#include "core/utilities.h"
+#include "library/librarybackend.h"
+#include "library/librarymodel.h"
+#include "library/libraryquery.h"
+#include "library/librarywatcher.h"
+
+// Measures the library at scale, one stage at a time:
+//   - a full and an incremental LibraryWatcher scan of a generated tree of
+//     tagged files,
+//   - LibraryBackend::AddOrUpdateSongs,
+//   - LibraryModel::Reset, with and without the song index,
+//   - full text searches.
+// Each stage prints its wall time, the number of SQL statements it ran on the
+// test thread and the process's resident memory.  The sizes can be changed
+// with the CLEMENTINE_BENCHMARK_FILES and CLEMENTINE_BENCHMARK_SONGS
+// environment variables.
+namespace {
+
+const int kDefaultFileCount = 2000;
+const int kDefaultSongCount = 50000;
+const int kScanTimeoutMsec = 60000;
+
+const char* kSourceFiles[] = {":/testdata/beep.ogg", ":/testdata/beep.flac",
+                              ":/testdata/beep.mp3"};
+const char* kExtensions[] = {"ogg", "flac", "mp3"};
+
+// Returns a field from /proc/self/status in kB, or 0 on other platforms.
+qint64 ProcessStatus(const QByteArray& field) {
+  QFile status("/proc/self/status");
+  if (!status.open(QIODevice::ReadOnly)) return 0;
+
+  for (const QByteArray& line : status.readAll().split('\n')) {
+    if (line.startsWith(field + ":")) {
+      return line.mid(field.length() + 1).trimmed().split(' ')[0].toLongLong();
+    }
+  }
+  return 0;
+}
+
+// Counts the statements sqlite runs on one connection.  Database gives each
+// thread its own connection, so queries LibraryModel runs in the background
+// aren't counted.
+class StatementCounter {
+ public:
+  explicit StatementCounter(QSqlDatabase db) : count_(0), handle_(nullptr) {
+    QVariant v = db.driver()->handle();
+    if (v.isValid() && qstrcmp(v.typeName(), "sqlite3*") == 0) {
+      handle_ = *static_cast<sqlite3**>(v.data());
+    }
+#if SQLITE_VERSION_NUMBER >= 3014000
+    if (handle_) {
+      sqlite3_trace_v2(handle_, SQLITE_TRACE_STMT, &StatementCounter::Trace,
+                       this);
+    }
+#endif
+  }
+
+  ~StatementCounter() {
+#if SQLITE_VERSION_NUMBER >= 3014000
+    if (handle_) sqlite3_trace_v2(handle_, 0, nullptr, nullptr);
+#endif
+  }
+
+  int count() const { return count_; }
+
+ private:
+  static int Trace(unsigned, void* context, void*, void*) {
+    reinterpret_cast<StatementCounter*>(context)->count_++;
+    return 0;
+  }
+
+  int count_;
+  sqlite3* handle_;
+};
+
+// Prints the cost of everything that happened between its construction and
+// Finish().
+class Stage {
+ public:
+  Stage(const QString& name, const StatementCounter* counter)
+      : name_(name),
+        counter_(counter),
+        statements_(counter->count()),
+        rss_kb_(ProcessStatus("VmRSS")) {
+    time_.start();
+  }
+
+  void Finish(const QString& detail = QString()) {
+    const int msec = time_.elapsed();
+    const qint64 rss_kb = ProcessStatus("VmRSS");
+    qDebug() << qPrintable(name_ + ":") << msec << "ms,"
+             << counter_->count() - statements_ << "statements, RSS"
+             << rss_kb / 1024 << "MB (" << (rss_kb - rss_kb_) / 1024
+             << "MB), peak" << ProcessStatus("VmHWM") / 1024 << "MB"
+             << qPrintable(detail);
+  }
+
+ private:
+  QString name_;
+  const StatementCounter* counter_;
+  int statements_;
+  qint64 rss_kb_;
+  QTime time_;
+};
+
+class LibraryBenchmark : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    file_count_ = SizeFromEnvironment("CLEMENTINE_BENCHMARK_FILES",
+                                      kDefaultFileCount);
+    song_count_ = SizeFromEnvironment("CLEMENTINE_BENCHMARK_SONGS",
+                                      kDefaultSongCount);
+
+#ifdef TAGREADER_BINARY_DIR
+    // So the worker pool can find the clementine-tagreader we just built.
+    qputenv("PATH", TAGREADER_BINARY_DIR ":" + qgetenv("PATH"));
+#endif
+
+    tag_reader_thread_ = new QThread;
+    tag_reader_client_ = new TagReaderClient;
+    tag_reader_client_->moveToThread(tag_reader_thread_);
+    tag_reader_thread_->start();
+    tag_reader_client_->Start();
+
+    root_ = Utilities::MakeTempDir("clementine-benchmark");
+    QTime time;
+    time.start();
+    GenerateTree(root_, file_count_);
+    qDebug() << "Generated" << file_count_ << "files in" << root_ << "in"
+             << time.elapsed() << "ms";
+    qDebug() << "Statement counts only include queries run on the test thread";
+  }
+
+  static void TearDownTestCase() {
+    Utilities::RemoveRecursive(root_);
+
+    tag_reader_thread_->quit();
+    tag_reader_thread_->wait();
+    delete tag_reader_client_;
+    delete tag_reader_thread_;
+  }
+
+  virtual void SetUp() {
+    // Not a MemoryDatabase: LibraryModel queries from other threads, and
+    // each of those would get its own empty in-memory database.
+    database_filename_ = Utilities::GetTemporaryFileName();
+    database_.reset(new Database(nullptr, nullptr, database_filename_));
+    backend_.reset(new LibraryBackend);
+    ASSERT_NO_FATAL_FAILURE(
+        InitBenchmarkLibrary(database_.get(), backend_.get(), &directory_id_));
+    counter_.reset(new StatementCounter(database_->Connect()));
+  }
+
+  virtual void TearDown() {
+    counter_.reset();
+    backend_.reset();
+    database_.reset();
+    QFile::remove(database_filename_);
+  }
+
+  // Writes file_count tagged files, one album per directory, cycling through
+  // Ogg Vorbis, FLAC and MP3.
+  static void GenerateTree(const QString& root, int file_count) {
+    TagReader tag_reader;
+    for (int i = 0; i < file_count; ++i) {
+      const Song song = MakeBenchmarkSong(i);
+      const QString dir =
+          QString("%1/%2/%3").arg(root, song.artist(), song.album());
+      QDir().mkpath(dir);
+
+      const QString filename = QString("%1/%2.%3")
+                                   .arg(dir)
+                                   .arg(song.track())
+                                   .arg(kExtensions[i % 3]);
+      QFile::copy(kSourceFiles[i % 3], filename);
+      // Files copied out of resources are read-only.
+      QFile::setPermissions(filename, QFile::ReadOwner | QFile::WriteOwner);
+
+      ::pb::tagreader::SongMetadata pb_song;
+      song.ToProtobuf(&pb_song);
+      tag_reader.SaveFile(filename, pb_song);
+    }
+  }
+
+  static void Sleep(int msec) {
+    QEventLoop loop;
+    QTimer::singleShot(msec, &loop, SLOT(quit()));
+    loop.exec();
+  }
+
+  static void SetGroupByAndWait(LibraryModel* model,
+                                const LibraryModel::Grouping& grouping) {
+    QEventLoop loop;
+    QObject::connect(model, SIGNAL(modelReset()), &loop, SLOT(quit()));
+    model->SetGroupBy(grouping);
+    loop.exec();
+  }
+
+  static int ExpandAll(LibraryModel* model, const QModelIndex& parent) {
+    if (model->canFetchMore(parent)) model->fetchMore(parent);
+
+    int count = 0;
+    const int rows = model->rowCount(parent);
+    for (int row = 0; row < rows; ++row) {
+      count += 1 + ExpandAll(model, model->index(row, 0, parent));
+    }
+    return count;
+  }
+
+  static QString root_;
+  static int file_count_;
+  static int song_count_;
+  static QThread* tag_reader_thread_;
+  static TagReaderClient* tag_reader_client_;
+
+  QString database_filename_;
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  std::unique_ptr<StatementCounter> counter_;
+  int directory_id_;
+};
+
+QString LibraryBenchmark::root_;
+int LibraryBenchmark::file_count_ = 0;
+int LibraryBenchmark::song_count_ = 0;
+QThread* LibraryBenchmark::tag_reader_thread_ = nullptr;
+TagReaderClient* LibraryBenchmark::tag_reader_client_ = nullptr;
+
+TEST_F(LibraryBenchmark, Scan) {
+  TaskManager task_manager;
+  LibraryWatcher watcher;
+  watcher.set_backend(backend_.get());
+  watcher.set_task_manager(&task_manager);
+
+  // The same connections Library makes, but all on this thread.
+  QObject::connect(backend_.get(),
+                   SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)),
+                   &watcher, SLOT(AddDirectory(Directory, SubdirectoryList)));
+  QObject::connect(&watcher, SIGNAL(NewOrUpdatedSongs(SongList)),
+                   backend_.get(), SLOT(AddOrUpdateSongs(SongList)));
+  QObject::connect(&watcher, SIGNAL(SongsMTimeUpdated(SongList)),
+                   backend_.get(), SLOT(UpdateMTimesOnly(SongList)));
+  QObject::connect(&watcher, SIGNAL(SongsDeleted(SongList)), backend_.get(),
+                   SLOT(MarkSongsUnavailable(SongList)));
+  QObject::connect(&watcher, SIGNAL(SongsReadded(SongList, bool)),
+                   backend_.get(), SLOT(MarkSongsUnavailable(SongList, bool)));
+  QObject::connect(&watcher, SIGNAL(SubdirsDiscovered(SubdirectoryList)),
+                   backend_.get(), SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
+  QObject::connect(&watcher, SIGNAL(SubdirsMTimeUpdated(SubdirectoryList)),
+                   backend_.get(), SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
+  QObject::connect(&watcher, SIGNAL(CompilationsNeedUpdating()),
+                   backend_.get(), SLOT(UpdateCompilations()));
+
+  // Adding the directory scans it straight away.
+  Stage full_scan("LibraryWatcher full scan", counter_.get());
+  backend_->AddDirectory(root_);
+  full_scan.Finish(QString(", %1 files").arg(file_count_));
+  EXPECT_EQ(file_count_, backend_->GetAllSongs().count());
+
+  // Change one album in ten.  Directory mtimes have a resolution of a second.
+  Sleep(1100);
+  TagReader tag_reader;
+  int changed = 0;
+  for (int i = 0; i < file_count_; i += kBenchmarkSongsPerAlbum * 10) {
+    Song song = MakeBenchmarkSong(i);
+    const QString dir =
+        QString("%1/%2/%3").arg(root_, song.artist(), song.album());
+    const QString filename =
+        QString("%1/%2.%3").arg(dir).arg(song.track()).arg(kExtensions[i % 3]);
+    song.set_title(song.title() + " (changed)");
+
+    ::pb::tagreader::SongMetadata pb_song;
+    song.ToProtobuf(&pb_song);
+    tag_reader.SaveFile(filename, pb_song);
+
+    // Touch the directory too, so the scan looks inside it.
+    QFile touch(dir + "/.touch");
+    touch.open(QIODevice::WriteOnly);
+    touch.close();
+    touch.remove();
+    changed++;
+  }
+
+  QSignalSpy finished(&watcher, SIGNAL(ScanFinished()));
+  QEventLoop loop;
+  QObject::connect(&watcher, SIGNAL(ScanFinished()), &loop, SLOT(quit()));
+  QTimer::singleShot(kScanTimeoutMsec, &loop, SLOT(quit()));
+
+  Stage incremental_scan("LibraryWatcher incremental scan", counter_.get());
+  watcher.IncrementalScanAsync();
+  loop.exec();
+  incremental_scan.Finish(QString(", %1 changed directories").arg(changed));
+  ASSERT_EQ(1, finished.count());
+
+  int changed_in_library = 0;
+  for (const Song& song : backend_->GetAllSongs()) {
+    if (song.title().endsWith(" (changed)")) changed_in_library++;
+  }
+  EXPECT_EQ(changed, changed_in_library);
+}
+
+TEST_F(LibraryBenchmark, AddOrUpdateSongs) {
+  const SongList songs = MakeBenchmarkSongs(song_count_, directory_id_);
+
+  Stage insert("LibraryBackend::AddOrUpdateSongs insert", counter_.get());
+  backend_->AddOrUpdateSongs(songs);
+  insert.Finish(QString(", %1 songs").arg(songs.count()));
+
+  SongList updated = backend_->GetAllSongs();
+  ASSERT_EQ(song_count_, updated.count());
+  for (Song& song : updated) {
+    song.set_comment("Updated");
+  }
+
+  Stage update("LibraryBackend::AddOrUpdateSongs update", counter_.get());
+  backend_->AddOrUpdateSongs(updated);
+  update.Finish(QString(", %1 songs").arg(updated.count()));
+}
+
+TEST_F(LibraryBenchmark, ModelReset) {
+  backend_->AddOrUpdateSongs(MakeBenchmarkSongs(song_count_, directory_id_));
+
+  for (int use_index = 0; use_index < 2; ++use_index) {
+    LibraryModel model(backend_.get(), nullptr);
+    model.set_use_song_index(use_index);
+    const QString suffix = use_index ? " (song index)" : " (SQL)";
+
+    Stage reset("LibraryModel::Reset" + suffix, counter_.get());
+    model.Reset();
+    reset.Finish(QString(", %1 top level items").arg(model.rowCount()));
+
+    Stage expand("LibraryModel expand all" + suffix, counter_.get());
+    const int items = ExpandAll(&model, QModelIndex());
+    expand.Finish(QString(", %1 items").arg(items));
+
+    // Changing the grouping resets the model in the background, so time a
+    // second Reset with the new grouping instead.
+    SetGroupByAndWait(&model,
+                      LibraryModel::Grouping(LibraryModel::GroupBy_Genre,
+                                             LibraryModel::GroupBy_YearAlbum));
+    Stage regroup("LibraryModel::Reset by genre" + suffix, counter_.get());
+    model.Reset();
+    regroup.Finish(QString(", %1 top level items").arg(model.rowCount()));
+  }
+}
+
+TEST_F(LibraryBenchmark, Search) {
+  backend_->AddOrUpdateSongs(MakeBenchmarkSongs(song_count_, directory_id_));
+
+  // Typing "artist 12" one letter at a time, as the library filter does.
+  const QString typed = "artist 12";
+  int results = 0;
+
+  Stage search("FTS search", counter_.get());
+  for (int i = 1; i <= typed.length(); ++i) {
+    QueryOptions options;
+    options.set_filter(typed.left(i));
+
+    LibraryQuery q(options);
+    q.SetColumnSpec("%songs_table.ROWID");
+    ASSERT_TRUE(backend_->ExecQuery(&q));
+    while (q.Next()) results++;
+  }
+  search.Finish(QString(", %1 queries, %2 results")
+                    .arg(typed.length())
+                    .arg(results));
+}
+
+}  // namespace
@@ -0,0 +1,116 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "library/librarychangejournal.h"
+
+#include <QTemporaryFile>
+
+namespace {
+
+class LibraryChangeJournalTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    // We only want a unique filename - the journal creates the file itself.
+    ASSERT_TRUE(temp_.open());
+    filename_ = temp_.fileName();
+    temp_.close();
+    QFile::remove(filename_);
+  }
+
+  void TearDown() { QFile::remove(filename_); }
+
+  QTemporaryFile temp_;
+  QString filename_;
+};
+
+TEST_F(LibraryChangeJournalTest, NewJournalIsNotClean) {
+  LibraryChangeJournal journal(filename_);
+  journal.Open();
+  EXPECT_FALSE(journal.was_clean_shutdown());
+  EXPECT_TRUE(journal.dirty_paths().isEmpty());
+}
+
+TEST_F(LibraryChangeJournalTest, CleanShutdown) {
+  {
+    LibraryChangeJournal journal(filename_);
+    journal.Open();
+    journal.MarkDirty("/music/a");
+    journal.MarkDirty("/music/b");
+    journal.MarkClean("/music/a");
+    journal.MarkCleanShutdown();
+  }
+
+  LibraryChangeJournal journal(filename_);
+  journal.Open();
+  EXPECT_TRUE(journal.was_clean_shutdown());
+  EXPECT_FALSE(journal.IsDirty("/music/a"));
+  EXPECT_TRUE(journal.IsDirty("/music/b"));
+}
+
+TEST_F(LibraryChangeJournalTest, CrashIsNotClean) {
+  {
+    LibraryChangeJournal journal(filename_);
+    journal.Open();
+    journal.MarkDirty("/music/a");
+    // No MarkCleanShutdown()
+  }
+
+  LibraryChangeJournal journal(filename_);
+  journal.Open();
+  EXPECT_FALSE(journal.was_clean_shutdown());
+  EXPECT_TRUE(journal.IsDirty("/music/a"));
+}
+
+TEST_F(LibraryChangeJournalTest, MarkerIsClearedOnOpen) {
+  {
+    LibraryChangeJournal journal(filename_);
+    journal.Open();
+    journal.MarkCleanShutdown();
+  }
+  {
+    // Opened and then crashed.
+    LibraryChangeJournal journal(filename_);
+    journal.Open();
+    EXPECT_TRUE(journal.was_clean_shutdown());
+  }
+
+  LibraryChangeJournal journal(filename_);
+  journal.Open();
+  EXPECT_FALSE(journal.was_clean_shutdown());
+}
+
+TEST_F(LibraryChangeJournalTest, PendingFullScan) {
+  {
+    LibraryChangeJournal journal(filename_);
+    journal.Open();
+    journal.SetFullScanPending("/music", true);
+    journal.SetFullScanPending("/other", true);
+    journal.SetFullScanPending("/other", false);
+    journal.MarkCleanShutdown();
+  }
+
+  LibraryChangeJournal journal(filename_);
+  journal.Open();
+  EXPECT_TRUE(journal.IsFullScanPending("/music"));
+  EXPECT_FALSE(journal.IsFullScanPending("/other"));
+}
+
+}  // namespace
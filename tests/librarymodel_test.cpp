@@ -304,4 +304,22 @@ TEST_F(LibraryModelTest, RemoveEmptyArtists) {
   ASSERT_EQ(0, model_->rowCount(QModelIndex()));
 }
 
+TEST_F(LibraryModelTest, RegroupsSongsWhenTheirBitrateIsRead) {
+  Song one = AddSong("Title", "Artist", "Album", 123); one.set_id(1);
+  model_->set_show_dividers(false);
+  model_->SetGroupBy(LibraryModel::Grouping(LibraryModel::GroupBy_Bitrate));
+  model_->Init(false);
+
+  ASSERT_EQ(1, model_->rowCount(QModelIndex()));
+  EXPECT_NE("320", model_->index(0, 0, QModelIndex()).data().toString());
+
+  // The deferred audio properties arrive
+  one.set_bitrate(320);
+  one.set_samplerate(44100);
+  backend_->UpdateAudioProperties(SongList() << one);
+
+  ASSERT_EQ(1, model_->rowCount(QModelIndex()));
+  EXPECT_EQ("320", model_->index(0, 0, QModelIndex()).data().toString());
+}
+
 } // namespace
@@ -0,0 +1,151 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QSignalSpy>
+
+#include "library/librarybackend.h"
+#include "library/library.h"
+#include "library/librarysongindex.h"
+#include "core/song.h"
+#include "core/database.h"
+
+namespace {
+
+class LibrarySongIndexTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+  }
+
+  Song MakeSong(const QString& artist, const QString& album, int year) {
+    Song ret;
+    ret.Init("Title", artist, album, 123);
+    ret.set_year(year);
+    ret.set_directory_id(1);
+    ret.set_url(QUrl::fromLocalFile(
+        QString("/music/%1/%2/%3.mp3").arg(artist, album).arg(next_file_++)));
+    ret.set_mtime(1);
+    ret.set_ctime(1);
+    ret.set_filesize(1);
+    return ret;
+  }
+
+  // Adds the songs to the database and returns them with their IDs.
+  SongList AddSongs(const SongList& songs) {
+    QSignalSpy spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+    backend_->AddOrUpdateSongs(songs);
+    if (spy.isEmpty()) return SongList();
+    return spy[0][0].value<SongList>();
+  }
+
+  static QStringList Values(const QList<QVariantList>& rows) {
+    QStringList ret;
+    for (const QVariantList& row : rows) {
+      QStringList columns;
+      for (const QVariant& value : row) columns << value.toString();
+      ret << columns.join("/");
+    }
+    ret.sort();
+    return ret;
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  LibrarySongIndex index_;
+  int next_file_ = 0;
+};
+
+TEST_F(LibrarySongIndexTest, LoadsFromDatabase) {
+  AddSongs(SongList() << MakeSong("Artist 1", "Album 1", 2001)
+                      << MakeSong("Artist 1", "Album 2", 2002)
+                      << MakeSong("Artist 2", "Album 3", 2001));
+
+  index_.Load(backend_.get());
+  ASSERT_TRUE(index_.is_loaded());
+
+  LibrarySongIndex::Query all;
+  EXPECT_EQ(QStringList() << "Artist 1"
+                          << "Artist 2",
+            Values(index_.Distinct(QStringList() << "artist", all)));
+
+  LibrarySongIndex::Query artist;
+  artist.AddWhere("artist", "Artist 1");
+  EXPECT_EQ(QStringList() << "2001/Album 1"
+                          << "2002/Album 2",
+            Values(index_.Distinct(QStringList() << "year"
+                                                 << "album",
+                                   artist)));
+  EXPECT_EQ(2, index_.SongIds(artist).count());
+}
+
+TEST_F(LibrarySongIndexTest, UnknownValueMatchesNothing) {
+  AddSongs(SongList() << MakeSong("Artist 1", "Album 1", 2001));
+  index_.Load(backend_.get());
+
+  LibrarySongIndex::Query q;
+  q.AddWhere("artist", "Nobody");
+  EXPECT_FALSE(index_.Contains(q));
+  EXPECT_TRUE(index_.SongIds(q).isEmpty());
+}
+
+TEST_F(LibrarySongIndexTest, CompilationRequirement) {
+  Song compilation = MakeSong("Artist 1", "Hits", 2001);
+  compilation.set_compilation(true);
+  AddSongs(SongList() << compilation << MakeSong("Artist 2", "Album", 2001));
+  index_.Load(backend_.get());
+
+  LibrarySongIndex::Query q;
+  q.AddCompilationRequirement(true);
+  EXPECT_EQ(QStringList() << "Hits",
+            Values(index_.Distinct(QStringList() << "album", q)));
+
+  q.AddCompilationRequirement(false);
+  EXPECT_FALSE(index_.Contains(q));
+}
+
+TEST_F(LibrarySongIndexTest, FollowsUpdates) {
+  SongList songs = AddSongs(SongList() << MakeSong("Artist 1", "Album 1", 2001)
+                                       << MakeSong("Artist 2", "Album 2", 2001));
+  ASSERT_EQ(2, songs.count());
+  index_.Load(backend_.get());
+
+  // Remove the first song, and rename the artist of the second.
+  index_.Remove(SongList() << songs[0]);
+  songs[1].set_artist("Artist 3");
+  index_.AddOrUpdate(SongList() << songs[1]);
+
+  LibrarySongIndex::Query all;
+  EXPECT_EQ(QStringList() << "Artist 3",
+            Values(index_.Distinct(QStringList() << "artist", all)));
+  EXPECT_EQ(QList<int>() << songs[1].id(), index_.SongIds(all));
+}
+
+TEST_F(LibrarySongIndexTest, IgnoresUpdatesUntilLoaded) {
+  index_.AddOrUpdate(SongList() << MakeSong("Artist 1", "Album 1", 2001));
+  EXPECT_FALSE(index_.is_loaded());
+}
+
+}  // namespace
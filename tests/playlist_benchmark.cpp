@@ -0,0 +1,126 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "benchmark_utils.h"
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QSqlQuery>
+#include <QTime>
+#include <QtDebug>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/stringpool.h"
+#include "library/librarybackend.h"
+#include "library/sqlrow.h"
+#include "playlist/playlistitem.h"
+
+// Measures how much memory each row of a big playlist of library songs takes,
+// with and without sharing strings between the rows the way PlaylistBackend
+// does when it restores a playlist, and how long it takes to get the metadata
+// of every row.  The size can be changed with the CLEMENTINE_BENCHMARK_ROWS
+// environment variable.
+namespace {
+
+const int kDefaultRowCount = 100000;
+
+// Returns the number of bytes allocated on the heap, or 0 if we can't tell.
+qint64 HeapInUse() {
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+  return static_cast<unsigned int>(mallinfo().uordblks);
+#else
+  return 0;
+#endif
+}
+
+class PlaylistBenchmark : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    row_count_ = SizeFromEnvironment("CLEMENTINE_BENCHMARK_ROWS",
+                                     kDefaultRowCount);
+
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    int directory_id = -1;
+    ASSERT_NO_FATAL_FAILURE(
+        InitBenchmarkLibrary(database_.get(), backend_.get(), &directory_id));
+    backend_->AddOrUpdateSongs(MakeBenchmarkSongs(row_count_, directory_id));
+  }
+
+  // Loads every song as a library playlist item, the way PlaylistBackend
+  // restores a playlist, and prints what it cost.
+  PlaylistItemList Load(const QString& name, StringPool* pool) {
+    const qint64 heap_before = HeapInUse();
+    QTime time;
+    time.start();
+
+    PlaylistItemList ret;
+    QSqlQuery q("SELECT ROWID, " + Song::kColumnSpec + " FROM songs",
+                database_->Connect());
+    q.setForwardOnly(true);
+    q.exec();
+    while (q.next()) {
+      PlaylistItemPtr item(PlaylistItem::NewFromType("Library"));
+      item->InitFromQuery(SqlRow(q));
+      if (pool) item->ShareStrings(pool);
+      ret << item;
+    }
+
+    const int msec = time.elapsed();
+    const qint64 heap_bytes = HeapInUse() - heap_before;
+    qDebug() << qPrintable(name + ":") << ret.count() << "rows in" << msec
+             << "ms," << heap_bytes / qMax(1, ret.count()) << "bytes per row";
+    return ret;
+  }
+
+  int row_count_;
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+};
+
+TEST_F(PlaylistBenchmark, MemoryPerRow) {
+  {
+    const PlaylistItemList items = Load("Separate strings", nullptr);
+    ASSERT_EQ(row_count_, items.count());
+  }
+
+  StringPool pool;
+  const PlaylistItemList items = Load("Shared strings", &pool);
+  ASSERT_EQ(row_count_, items.count());
+  qDebug() << pool.count() << "distinct shared strings";
+
+  QTime time;
+  time.start();
+  SongList songs;
+  for (PlaylistItemPtr item : items) {
+    songs << item->Metadata();
+  }
+  qDebug() << "Metadata of every row:" << time.elapsed() << "ms";
+}
+
+}  // namespace
@@ -0,0 +1,147 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QStandardItemModel>
+
+#include "playlist/playlist.h"
+#include "playlist/playlistfilter.h"
+
+namespace {
+
+class PlaylistFilterTest : public ::testing::Test {
+ protected:
+  PlaylistFilterTest() : model_(0, Playlist::ColumnCount) {}
+
+  virtual void SetUp() { filter_.setSourceModel(&model_); }
+
+  void AddRow(const QString& title, const QString& artist, int year = 0) {
+    QList<QStandardItem*> row;
+    for (int i = 0; i < Playlist::ColumnCount; ++i) {
+      row << new QStandardItem;
+    }
+    row[Playlist::Column_Title]->setText(title);
+    row[Playlist::Column_Artist]->setText(artist);
+    if (year) row[Playlist::Column_Year]->setText(QString::number(year));
+    model_.appendRow(row);
+  }
+
+  // Returns the titles of the rows the filter lets through.
+  QStringList Filter(const QString& query) {
+    filter_.setFilterFixedString(query);
+
+    QStringList ret;
+    for (int i = 0; i < filter_.rowCount(); ++i) {
+      ret << filter_.index(i, Playlist::Column_Title).data().toString();
+    }
+    return ret;
+  }
+
+  QStandardItemModel model_;
+  PlaylistFilter filter_;
+};
+
+TEST_F(PlaylistFilterTest, MatchesAnyColumn) {
+  AddRow("Help", "The Beatles");
+  AddRow("Beat It", "Michael Jackson");
+  AddRow("Roxanne", "The Police");
+
+  EXPECT_EQ(QStringList() << "Help"
+                          << "Beat It",
+            Filter("BEAT"));
+  EXPECT_EQ(QStringList() << "Help", Filter("artist:beatles"));
+  EXPECT_EQ(QStringList() << "Roxanne", Filter("-beat"));
+  EXPECT_EQ(QStringList() << "Beat It"
+                          << "Roxanne",
+            Filter("jackson OR police"));
+  EXPECT_EQ(3, Filter("").count());
+}
+
+TEST_F(PlaylistFilterTest, NarrowsAndWidens) {
+  AddRow("Help", "The Beatles");
+  AddRow("Beat It", "Michael Jackson");
+  AddRow("Roxanne", "The Police");
+
+  EXPECT_EQ(3, Filter("e").count());
+  EXPECT_EQ(2, Filter("be").count());
+  EXPECT_EQ(1, Filter("beatl").count());
+  EXPECT_EQ(1, Filter("beatl the").count());
+  EXPECT_EQ(0, Filter("beatl the x").count());
+
+  // Getting shorter, or adding anything but words, isn't narrower.
+  EXPECT_EQ(2, Filter("be").count());
+  EXPECT_EQ(3, Filter("be OR police").count());
+  EXPECT_EQ(1, Filter("be -jackson").count());
+}
+
+TEST_F(PlaylistFilterTest, NumericalColumns) {
+  AddRow("Old", "Someone", 1965);
+  AddRow("New", "Someone", 2010);
+
+  EXPECT_EQ(QStringList() << "New", Filter("year:>2000"));
+  EXPECT_EQ(QStringList() << "Old", Filter("year:<2000"));
+}
+
+TEST_F(PlaylistFilterTest, FollowsModelChanges) {
+  AddRow("Help", "The Beatles");
+  AddRow("Roxanne", "The Police");
+  EXPECT_EQ(QStringList() << "Help", Filter("beatles"));
+
+  // Changed rows are tested again.
+  model_.item(1, Playlist::Column_Artist)->setText("Beatles tribute band");
+  EXPECT_EQ(QStringList() << "Help"
+                          << "Roxanne",
+            Filter("beatles"));
+
+  // So are inserted ones, without losing the others.
+  AddRow("Yesterday", "The Beatles");
+  model_.insertRow(0, QList<QStandardItem*>() << new QStandardItem("Beatles"));
+  EXPECT_EQ(4, filter_.rowCount());
+
+  model_.removeRow(0);
+  model_.removeRow(0);
+  EXPECT_EQ(QStringList() << "Roxanne"
+                          << "Yesterday",
+            Filter("beatles"));
+
+  // And reordered ones.
+  model_.sort(Playlist::Column_Title, Qt::DescendingOrder);
+  EXPECT_EQ(QStringList() << "Yesterday"
+                          << "Roxanne",
+            Filter("beatles"));
+}
+
+TEST_F(PlaylistFilterTest, FiltersLargePlaylistsOnThreads) {
+  const int rows = PlaylistFilter::kThreadedFilterRows + 100;
+  for (int i = 0; i < rows; ++i) {
+    model_.appendRow(new QStandardItem(QString("Title %1").arg(i)));
+  }
+
+  int expected = 0;
+  int expected_narrower = 0;
+  for (int i = 0; i < rows; ++i) {
+    if (QString::number(i).contains("7")) expected++;
+    if (QString::number(i).contains("7777")) expected_narrower++;
+  }
+  EXPECT_EQ(expected, Filter("title 7").count());
+  EXPECT_EQ(expected_narrower, Filter("title 7777").count());
+}
+
+}  // namespace
@@ -0,0 +1,214 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QMap>
+
+#include "core/song.h"
+#include "playlist/playlistjournal.h"
+#include "playlist/songplaylistitem.h"
+
+namespace {
+
+class PlaylistJournalTest : public ::testing::Test {
+ protected:
+  static PlaylistItemPtr MakeItem() {
+    return PlaylistItemPtr(new SongPlaylistItem(Song()));
+  }
+
+  static PlaylistItemList MakeItems(int count) {
+    PlaylistItemList ret;
+    for (int i = 0; i < count; ++i) ret << MakeItem();
+    return ret;
+  }
+
+  // Saves the items, and applies the changes to rows_ the way PlaylistBackend
+  // applies them to the database.
+  PlaylistChanges Save(const PlaylistItemList& items) {
+    const PlaylistChanges changes = journal_.Update(items);
+
+    if (changes.rewrite_) rows_.clear();
+
+    if (changes.compact_) {
+      QMap<double, PlaylistItem*> compacted;
+      int i = 0;
+      for (PlaylistItem* item : rows_.values()) {
+        compacted[++i * PlaylistJournal::kOrderSpacing] = item;
+      }
+      rows_ = compacted;
+    }
+
+    QList<PlaylistItem*> moved;
+    for (double order : changes.removed_) {
+      EXPECT_TRUE(rows_.contains(order));
+      rows_.remove(order);
+    }
+    for (double order : changes.moved_from_) {
+      EXPECT_TRUE(rows_.contains(order));
+      moved << rows_.take(order);
+    }
+    for (int i = 0; i < moved.count(); ++i) {
+      EXPECT_FALSE(rows_.contains(changes.moved_to_[i]));
+      rows_[changes.moved_to_[i]] = moved[i];
+    }
+    for (int i = 0; i < changes.inserted_.count(); ++i) {
+      EXPECT_FALSE(rows_.contains(changes.inserted_orders_[i]));
+      rows_[changes.inserted_orders_[i]] = changes.inserted_[i].get();
+    }
+
+    // The saved rows, in order, should be the playlist.
+    QList<PlaylistItem*> expected;
+    for (PlaylistItemPtr item : items) expected << item.get();
+    EXPECT_EQ(expected, rows_.values());
+    EXPECT_EQ(rows_.keys(), journal_.saved_orders());
+
+    return changes;
+  }
+
+  PlaylistJournal journal_;
+  QMap<double, PlaylistItem*> rows_;
+};
+
+TEST_F(PlaylistJournalTest, InsertsNewRows) {
+  const PlaylistChanges changes = Save(MakeItems(10));
+  EXPECT_EQ(10, changes.inserted_.count());
+  EXPECT_TRUE(changes.removed_.isEmpty());
+  EXPECT_TRUE(changes.moved_from_.isEmpty());
+
+  // Clearing the playlist removes them all.
+  EXPECT_EQ(10, Save(PlaylistItemList()).removed_.count());
+}
+
+TEST_F(PlaylistJournalTest, MovesOnlyMovedRows) {
+  PlaylistItemList items = MakeItems(100);
+  Save(items);
+
+  items.move(50, 10);
+  PlaylistChanges changes = Save(items);
+  EXPECT_EQ(1, changes.moved_from_.count());
+  EXPECT_TRUE(changes.inserted_.isEmpty());
+  EXPECT_TRUE(changes.removed_.isEmpty());
+
+  items.move(0, 99);
+  changes = Save(items);
+  EXPECT_EQ(1, changes.moved_from_.count());
+
+  // Nothing changed.
+  EXPECT_TRUE(Save(items).is_empty());
+}
+
+TEST_F(PlaylistJournalTest, InsertsAndRemovesOnlyThoseRows) {
+  PlaylistItemList items = MakeItems(100);
+  Save(items);
+
+  items.insert(20, MakeItem());
+  items.insert(20, MakeItem());
+  items.removeAt(70);
+  items.prepend(MakeItem());
+  items.append(MakeItem());
+
+  const PlaylistChanges changes = Save(items);
+  EXPECT_EQ(4, changes.inserted_.count());
+  EXPECT_EQ(1, changes.removed_.count());
+  EXPECT_TRUE(changes.moved_from_.isEmpty());
+}
+
+TEST_F(PlaylistJournalTest, RewritesChangedItems) {
+  PlaylistItemList items = MakeItems(10);
+  Save(items);
+
+  journal_.ItemChanged(items[3]);
+  const PlaylistChanges changes = Save(items);
+  EXPECT_EQ(1, changes.removed_.count());
+  EXPECT_EQ(1, changes.inserted_.count());
+  EXPECT_EQ(items[3], changes.inserted_[0]);
+}
+
+TEST_F(PlaylistJournalTest, RewritesEverythingAfterAFailedSave) {
+  PlaylistItemList items = MakeItems(10);
+  Save(items);
+
+  journal_.Invalidate();
+  items.move(2, 7);
+  const PlaylistChanges changes = Save(items);
+  EXPECT_TRUE(changes.rewrite_);
+  EXPECT_EQ(10, changes.inserted_.count());
+  EXPECT_TRUE(changes.removed_.isEmpty());
+  EXPECT_TRUE(changes.moved_from_.isEmpty());
+
+  // Only once.
+  EXPECT_TRUE(Save(items).is_empty());
+}
+
+TEST_F(PlaylistJournalTest, RemovesRowsDroppedOnRestore) {
+  PlaylistItemList items = MakeItems(3);
+  journal_.Reset(items, QList<double>() << 1.0 << 2.0 << 3.0);
+  rows_[1.0] = items[0].get();
+  rows_[2.0] = items[1].get();
+  rows_[3.0] = items[2].get();
+
+  items.removeAt(1);
+  const PlaylistChanges changes = Save(items);
+  EXPECT_EQ(QList<double>() << 2.0, changes.removed_);
+  EXPECT_TRUE(changes.inserted_.isEmpty());
+}
+
+TEST_F(PlaylistJournalTest, CompactsWhenThereIsNoRoom) {
+  PlaylistItemList items = MakeItems(2);
+  Save(items);
+
+  // Each insert halves the gap after the first row.
+  bool compacted = false;
+  for (int i = 0; i < 100; ++i) {
+    items.insert(1, MakeItem());
+    compacted |= Save(items).compact_;
+  }
+  EXPECT_TRUE(compacted);
+}
+
+TEST_F(PlaylistJournalTest, RandomEdits) {
+  qsrand(1234);
+  PlaylistItemList items = MakeItems(50);
+  Save(items);
+
+  for (int i = 0; i < 2000; ++i) {
+    switch (qrand() % 4) {
+      case 0:
+        items.insert(qrand() % (items.count() + 1), MakeItem());
+        break;
+      case 1:
+        if (!items.isEmpty()) items.removeAt(qrand() % items.count());
+        break;
+      case 2:
+        if (!items.isEmpty()) {
+          items.move(qrand() % items.count(), qrand() % items.count());
+        }
+        break;
+      case 3:
+        if (!items.isEmpty()) {
+          journal_.ItemChanged(items[qrand() % items.count()]);
+        }
+        break;
+    }
+    Save(items);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,142 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/song.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistsortkey.h"
+#include "playlist/songplaylistitem.h"
+
+namespace {
+
+class PlaylistSortKeyTest : public ::testing::Test {
+ protected:
+  void AddItem(const QString& title, const QString& artist, int track = 0) {
+    Song song;
+    song.Init(title, artist, "Album", 123);
+    song.set_track(track);
+    items_ << PlaylistItemPtr(new SongPlaylistItem(song));
+  }
+
+  // Sorts the items and returns their titles.
+  QStringList Sort(int column, Qt::SortOrder order = Qt::AscendingOrder) {
+    PlaylistSortKey::Sort(column, order, items_.begin(), items_.end());
+
+    QStringList ret;
+    for (PlaylistItemPtr item : items_) {
+      ret << item->Metadata().title();
+    }
+    return ret;
+  }
+
+  PlaylistItemList items_;
+};
+
+TEST_F(PlaylistSortKeyTest, SortsTextIgnoringCase) {
+  AddItem("1", "beta");
+  AddItem("2", "Alpha");
+  AddItem("3", "");
+  AddItem("4", "gamma");
+
+  EXPECT_EQ(QStringList() << "3"
+                          << "2"
+                          << "1"
+                          << "4",
+            Sort(Playlist::Column_Artist));
+  EXPECT_EQ(QStringList() << "4"
+                          << "1"
+                          << "2"
+                          << "3",
+            Sort(Playlist::Column_Artist, Qt::DescendingOrder));
+}
+
+TEST_F(PlaylistSortKeyTest, SortsNumbers) {
+  AddItem("1", "Artist", 10);
+  AddItem("2", "Artist", 9);
+  AddItem("3", "Artist", 100);
+
+  EXPECT_EQ(QStringList() << "2"
+                          << "1"
+                          << "3",
+            Sort(Playlist::Column_Track));
+}
+
+TEST_F(PlaylistSortKeyTest, KeepsEqualItemsInOrder) {
+  AddItem("1", "b");
+  AddItem("2", "a");
+  AddItem("3", "B");
+  AddItem("4", "a");
+
+  EXPECT_EQ(QStringList() << "2"
+                          << "4"
+                          << "1"
+                          << "3",
+            Sort(Playlist::Column_Artist));
+  EXPECT_EQ(QStringList() << "1"
+                          << "3"
+                          << "2"
+                          << "4",
+            Sort(Playlist::Column_Artist, Qt::DescendingOrder));
+}
+
+TEST_F(PlaylistSortKeyTest, NoticesChangedMetadata) {
+  AddItem("1", "a");
+  AddItem("2", "b");
+  EXPECT_EQ(QStringList() << "1"
+                          << "2",
+            Sort(Playlist::Column_Artist));
+
+  // The key cached by the last sort mustn't be used for the new artist.
+  Song song;
+  song.Init("1", "c", "Album", 123);
+  items_[0]->SetTemporaryMetadata(song);
+  EXPECT_EQ(QStringList() << "2"
+                          << "1",
+            Sort(Playlist::Column_Artist));
+}
+
+TEST_F(PlaylistSortKeyTest, SortsLargePlaylistsOnThreads) {
+  qsrand(1234);
+  const int count = PlaylistSortKey::kThreadedSortRows + 100;
+  for (int i = 0; i < count; ++i) {
+    AddItem(QString::number(i), QString("Artist %1").arg(qrand() % 1000));
+  }
+
+  // The second time round the keys cached by the first sort are used.
+  for (int pass = 0; pass < 2; ++pass) {
+    std::reverse(items_.begin(), items_.end());
+
+    // It should give the order qStableSort gives comparing the strings.
+    PlaylistItemList expected = items_;
+    qStableSort(expected.begin(), expected.end(),
+                [](PlaylistItemPtr a, PlaylistItemPtr b) {
+                  return QString::localeAwareCompare(
+                             a->Metadata().artist().toLower(),
+                             b->Metadata().artist().toLower()) < 0;
+                });
+
+    Sort(Playlist::Column_Artist);
+    EXPECT_TRUE(expected == items_);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,72 @@
+/* This file is part of Clementine.
+   Copyright 2015, Cultural Commons Collecting Society SCE mit
+                   beschränkter Haftung (C3S SCE)
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "core/sharedmemoryblob.h"
+
+#include <QByteArray>
+
+#ifdef Q_OS_UNIX
+
+TEST(SharedMemoryBlobTest, RoundTrip) {
+  QByteArray data(SharedMemoryBlob::kMinimumSize, 'x');
+  data[1] = 'y';
+
+  const std::string name =
+      SharedMemoryBlob::Create(data.constData(), data.size());
+  ASSERT_FALSE(name.empty());
+
+  SharedMemoryBlob blob(name, data.size());
+  ASSERT_TRUE(blob.is_valid());
+  EXPECT_EQ(data.size(), blob.size());
+  EXPECT_EQ(data, QByteArray(reinterpret_cast<const char*>(blob.data()),
+                             blob.size()));
+}
+
+TEST(SharedMemoryBlobTest, OpeningUnlinks) {
+  const std::string name = SharedMemoryBlob::Create("abc", 3);
+  ASSERT_FALSE(name.empty());
+
+  {
+    SharedMemoryBlob blob(name, 3);
+    EXPECT_TRUE(blob.is_valid());
+  }
+
+  SharedMemoryBlob again(name, 3);
+  EXPECT_FALSE(again.is_valid());
+}
+
+TEST(SharedMemoryBlobTest, RemoveBeforeOpening) {
+  const std::string name = SharedMemoryBlob::Create("abc", 3);
+  ASSERT_FALSE(name.empty());
+  SharedMemoryBlob::Remove(name);
+
+  SharedMemoryBlob blob(name, 3);
+  EXPECT_FALSE(blob.is_valid());
+}
+
+TEST(SharedMemoryBlobTest, RejectsShortSegment) {
+  const std::string name = SharedMemoryBlob::Create("abc", 3);
+  ASSERT_FALSE(name.empty());
+
+  SharedMemoryBlob blob(name, 100);
+  EXPECT_FALSE(blob.is_valid());
+}
+
+#endif  // Q_OS_UNIX
@@ -18,6 +18,7 @@
 #include "config.h"
 #include "tagreader.h"
 #include "core/song.h"
+#include "core/stringpool.h"
 #ifdef HAVE_LIBLASTFM
 #include "internet/lastfm/lastfmcompat.h"
 #endif
@@ -394,4 +395,22 @@ TEST_F(SongTest, StatisticsMP4) {
   EXPECT_EQ(87, new_song.score());
 }
 
+TEST_F(SongTest, SharesStrings) {
+  Song a;
+  a.Init("Title", "Artist", "Album", 123);
+  a.set_genre("Genre");
+  Song b;
+  b.Init("Title", QString("Art") + "ist", QString("Al") + "bum", 123);
+  b.set_genre("Other genre");
+  ASSERT_NE(a.artist().constData(), b.artist().constData());
+
+  StringPool pool;
+  a.ShareStrings(&pool);
+  b.ShareStrings(&pool);
+  EXPECT_EQ(a.artist().constData(), b.artist().constData());
+  EXPECT_EQ(a.album().constData(), b.album().constData());
+  EXPECT_EQ("Other genre", b.genre());
+  EXPECT_TRUE(b.composer().isNull());
+}
+
 }  // namespace